@@ -0,0 +1,381 @@
+/**
+ * Mesure du coût des connexions inactives sur le serveur Freescord.
+ *
+ * Lance bin/srv dans le mode demandé, ouvre N connexions sur la boucle locale,
+ * mène la séquence de pseudo pour chacune puis relève la mémoire résidente
+ * (VmRSS) et le temps CPU consommés par le processus serveur. Les résultats
+ * sont ramenés à 10 000 connexions pour comparer les modes :
+ *
+ *   bench_conn -m thread -n 10000
+ *   bench_conn -m epoll -n 10000
+ *
+ * Avec -R N, mesure plutôt une tempête de reconnexions : N clients v2
+ * successifs se connectent, choisissent leur pseudo et envoient un premier
+ * message, que reçoit un témoin connecté depuis le début, puis se
+ * déconnectent. Chaque étape de la connexion classique attend la réponse du
+ * serveur (PROTO_ACK, puis la réponse au pseudo) ; avec -z, le pseudo suit
+ * PROTO_HELLO et le premier message part dans le même envoi (voir frame.h).
+ * On relève le délai entre l'appel à connect et la réception du premier
+ * message par le témoin (p50, p99) et la durée de la tempête :
+ *
+ *   bench_conn -m epoll -R 2000
+ *   bench_conn -m epoll -R 2000 -z
+ *
+ * Avec -r R, les N connexions arrivent en rafale au rythme de R par seconde,
+ * chacune envoyant son pseudo sans attendre. On relève pour chacune le délai
+ * entre l'appel à connect et la réception du message d'accueil, puis de la
+ * réponse au pseudo (p50, p99, max), ainsi que les threads et la mémoire du
+ * serveur une fois tous connectés. Les options du serveur peuvent être
+ * complétées avec -x :
+ *
+ *   bench_conn -m thread -n 5000 -r 5000
+ *   bench_conn -m pool -x "-t 4 -s 64" -n 5000 -r 5000
+ */
+
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench_utils.h"
+#include "frame.h"
+
+#define DEFAULT_CONNECTIONS 1000
+#define FIRST_MESSAGE "bonjour ~"
+
+/* Envoie text dans une trame de type type */
+static int send_frame(int sock, enum frame_type type, const char *text) {
+    char frame[FRAME_MAX_SIZE];
+    struct frame f = {.type = type, .body = text, .bodyLen = strlen(text)};
+
+    size_t size = frame_encode(&f, frame);
+    return send(sock, frame, size, 0) == (ssize_t)size ? 0 : -1;
+}
+
+/* Attend la réponse du serveur au pseudo, retourne son status ou -1 */
+static int wait_status(int sock) {
+    char frame[FRAME_MAX_SIZE];
+    struct frame f;
+
+    do {
+        if (recv(sock, frame, 4, MSG_WAITALL) != 4) return -1;
+        size_t size = (uint32_t)(unsigned char)frame[0] << 24 |
+                      (uint32_t)(unsigned char)frame[1] << 16 |
+                      (uint32_t)(unsigned char)frame[2] << 8 |
+                      (unsigned char)frame[3];
+        if (size < FRAME_HEADER_SIZE || size > sizeof(frame)) return -1;
+        if (recv(sock, frame + 4, size - 4, MSG_WAITALL) != (ssize_t)size - 4)
+            return -1;
+        if (frame_decode(frame, size, &f) <= 0) return -1;
+    } while (f.type != FRAME_NICK);
+
+    return f.seq;
+}
+
+/* Connexion d'un client de la tempête jusqu'à l'envoi de son premier
+ * message, retourne sa socket ou -1 */
+static int storm_login(uint16_t port, int id, int zeroRtt) {
+    char buf[FRAME_MAX_SIZE];
+    int sock = bench_connect(port);
+    if (sock < 0) return -1;
+
+    if (zeroRtt) {
+        // Pseudo et premier message dans le même envoi
+        int len = snprintf(buf, sizeof(buf), "%s r%d\r\n", PROTO_HELLO, id);
+        struct frame f = {.type = FRAME_MSG,
+                          .body = FIRST_MESSAGE,
+                          .bodyLen = strlen(FIRST_MESSAGE)};
+        len += frame_encode(&f, buf + len);
+        if (send(sock, buf, len, 0) == len) return sock;
+    } else {
+        // Une étape par réponse du serveur
+        int len = snprintf(buf, sizeof(buf), "r%d", id);
+        if (send(sock, PROTO_HELLO "\r\n", strlen(PROTO_HELLO "\r\n"), 0) > 0 &&
+            bench_wait_for(sock, PROTO_ACK "\r\n") == 0 && len > 0 &&
+            send_frame(sock, FRAME_NICK, buf) == 0 && wait_status(sock) == 0 &&
+            send_frame(sock, FRAME_MSG, FIRST_MESSAGE) == 0)
+            return sock;
+    }
+
+    close(sock);
+    return -1;
+}
+
+/* Nombre de threads du processus pid, -1 en cas d'erreur */
+static long server_threads(pid_t pid) {
+    char path[64], line[256];
+    long threads = -1;
+
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    while (fgets(line, sizeof(line), f))
+        if (sscanf(line, "Threads: %ld", &threads) == 1) break;
+
+    fclose(f);
+    return threads;
+}
+
+/* Rafale de connexions au rythme rate : voir l'en-tête */
+static int connect_storm(pid_t pid, uint16_t port, int nbConn, double rate) {
+    struct bench_histo welcome, login;
+    memset(&welcome, 0, sizeof(welcome));
+    memset(&login, 0, sizeof(login));
+
+    struct pollfd *fds = malloc(nbConn * sizeof(struct pollfd));
+    uint64_t *t0 = malloc(nbConn * sizeof(uint64_t));
+    int *step = calloc(nbConn, sizeof(int)); // 0 accueil, 1 pseudo, 2 prêt
+    if (!fds || !t0 || !step) {
+        perror("malloc");
+        free(fds);
+        free(t0);
+        free(step);
+        return -1;
+    }
+
+    long rssBefore = bench_rss_kb(pid);
+    uint64_t start = bench_now_ns();
+    int opened = 0, ready = 0, failed = 0;
+
+    while (ready + failed < nbConn) {
+        // Connexions dues à cet instant selon le rythme
+        uint64_t now = bench_now_ns();
+        while (opened < nbConn && now - start >= opened * 1e9 / rate) {
+            char nick[16];
+            int len = snprintf(nick, sizeof(nick), "s%d\r\n", opened);
+
+            t0[opened] = bench_now_ns();
+            fds[opened].fd = bench_connect(port);
+            fds[opened].events = POLLIN;
+            if (fds[opened].fd < 0 ||
+                send(fds[opened].fd, nick, len, 0) != len) {
+                perror("connect");
+                fds[opened].fd = -1;
+                failed++;
+            }
+            opened++;
+        }
+
+        // Attente d'une réponse ou de la prochaine connexion
+        int timeoutMs = 1;
+        if (opened == nbConn) timeoutMs = 5000;
+        int pollRes = poll(fds, opened, timeoutMs);
+        if (pollRes == 0 && opened == nbConn) break;
+
+        now = bench_now_ns();
+        for (int i = 0; pollRes > 0 && i < opened; i++) {
+            if (!fds[i].revents) continue;
+
+            char buf[512];
+            int r = recv(fds[i].fd, buf, sizeof(buf) - 1, 0);
+            if (r <= 0) {
+                fds[i].fd = -1;
+                failed++;
+                continue;
+            }
+            buf[r] = '\0';
+
+            if (step[i] == 0) {
+                bench_histo_add(&welcome, now - t0[i]);
+                step[i] = 1;
+            }
+            if (step[i] == 1 && strstr(buf, "0 | ")) {
+                bench_histo_add(&login, now - t0[i]);
+                step[i] = 2;
+                ready++;
+
+                // Plus rien à attendre de cette connexion
+                fds[i].fd = -fds[i].fd - 1;
+            }
+        }
+    }
+
+    double stormTime = (bench_now_ns() - start) / 1e9;
+    long threads = server_threads(pid);
+    long rssAfter = bench_rss_kb(pid);
+    int alive = waitpid(pid, NULL, WNOHANG) == 0;
+
+    printf("connexions=%d rythme=%.0f/s prêtes=%d serveur=%s\n", nbConn, rate,
+           ready, alive ? "vivant" : "arrêté");
+    printf("durée de la rafale : %.3f s\n", stormTime);
+    printf("connect -> accueil : p50 %.1f µs, p99 %.1f µs, max %.1f µs\n",
+           bench_histo_percentile(&welcome, 50) / 1e3,
+           bench_histo_percentile(&welcome, 99) / 1e3, welcome.max / 1e3);
+    printf("connect -> pseudo : p50 %.1f µs, p99 %.1f µs, max %.1f µs\n",
+           bench_histo_percentile(&login, 50) / 1e3,
+           bench_histo_percentile(&login, 99) / 1e3, login.max / 1e3);
+    printf("serveur : %ld threads, RSS %ld kio -> %ld kio\n", threads,
+           rssBefore, rssAfter);
+
+    for (int i = 0; i < opened; i++) {
+        int fd = fds[i].fd < -1 ? -fds[i].fd - 1 : fds[i].fd;
+        if (fd >= 0) close(fd);
+    }
+    free(fds);
+    free(t0);
+    free(step);
+
+    return ready == nbConn ? 0 : -1;
+}
+
+/* Tempête de reconnexions : voir l'en-tête */
+static int reconnect_storm(pid_t pid, uint16_t port, int nbConn, int zeroRtt) {
+    struct bench_histo latency;
+    memset(&latency, 0, sizeof(latency));
+
+    int witness = bench_login(port, "temoin");
+    if (witness < 0) {
+        fprintf(stderr, "Connexion du témoin impossible\n");
+        return -1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int done = 0;
+    for (; done < nbConn; done++) {
+        uint64_t t0 = bench_now_ns();
+        int sock = storm_login(port, done, zeroRtt);
+        if (sock < 0) break;
+
+        int waitRes = bench_wait_for(witness, "~");
+        bench_histo_add(&latency, bench_now_ns() - t0);
+
+        // Les réponses non lues feraient fermer la connexion par un RST
+        char buf[512];
+        while (recv(sock, buf, sizeof(buf), MSG_DONTWAIT) > 0) continue;
+        close(sock);
+        if (waitRes < 0) break;
+    }
+
+    double stormTime = bench_elapsed(&start);
+    int alive = waitpid(pid, NULL, WNOHANG) == 0;
+
+    printf("connexion=%s reconnexions=%d réussies=%d serveur=%s\n",
+           zeroRtt ? "0-RTT" : "classique", nbConn, done,
+           alive ? "vivant" : "arrêté");
+    printf("durée de la tempête : %.3f s (%.0f connexions/s)\n", stormTime,
+           done / stormTime);
+    printf("connect -> premier message : p50 %.1f µs, p99 %.1f µs\n",
+           bench_histo_percentile(&latency, 50) / 1e3,
+           bench_histo_percentile(&latency, 99) / 1e3);
+
+    close(witness);
+    return done == nbConn ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *srv = DEFAULT_SRV;
+    const char *mode = "thread";
+    const char *extraArgs = "";
+    int nbConn = DEFAULT_CONNECTIONS;
+    int nbStorm = 0;
+    int zeroRtt = 0;
+    double rate = 0;
+    uint16_t port = DEFAULT_BENCH_PORT;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:m:x:n:p:R:zr:")) != -1) {
+        switch (opt) {
+            case 's': srv = optarg; break;
+            case 'm': mode = optarg; break;
+            case 'x': extraArgs = optarg; break;
+            case 'n': nbConn = atoi(optarg); break;
+            case 'p': port = atoi(optarg); break;
+            case 'R': nbStorm = atoi(optarg); break;
+            case 'z': zeroRtt = 1; break;
+            case 'r': rate = atof(optarg); break;
+            default:
+                fprintf(stderr,
+                        "Usage : %s [-s srv] [-m mode] [-x options] "
+                        "[-n connexions] [-p port] [-R reconnexions [-z]] "
+                        "[-r connexions/s]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    bench_raise_fd_limit();
+
+    char srvArgs[256];
+    snprintf(srvArgs, sizeof(srvArgs), "-m %s %s", mode, extraArgs);
+
+    pid_t pid = bench_start_server(srv, srvArgs, port);
+    if (pid < 0) return EXIT_FAILURE;
+
+    if (nbStorm > 0) {
+        int stormRes = reconnect_storm(pid, port, nbStorm, zeroRtt);
+        bench_stop_server(pid);
+        return stormRes < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (rate > 0) {
+        int stormRes = connect_storm(pid, port, nbConn, rate);
+        bench_stop_server(pid);
+        return stormRes < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    long rssBefore = bench_rss_kb(pid);
+    double cpuBefore = bench_cpu_ms(pid);
+
+    int *socks = malloc(nbConn * sizeof(int));
+    if (!socks) {
+        perror("malloc");
+        bench_stop_server(pid);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Connexions et envoi du pseudo sans attendre l'invite
+    int opened = 0;
+    for (; opened < nbConn; opened++) {
+        socks[opened] = bench_connect(port);
+        if (socks[opened] < 0) {
+            perror("connect");
+            break;
+        }
+
+        char nick[16];
+        int len = snprintf(nick, sizeof(nick), "b%d\r\n", opened);
+        send(socks[opened], nick, len, 0);
+    }
+
+    // Fin de la séquence de pseudo pour chaque connexion
+    int ready = 0;
+    for (int i = 0; i < opened; i++)
+        if (bench_wait_for(socks[i], "0 | ") == 0) ready++;
+
+    double connectTime = bench_elapsed(&start);
+
+    // Laisser le serveur se stabiliser avant la mesure
+    sleep(1);
+
+    long rssAfter = bench_rss_kb(pid);
+    double cpuAfter = bench_cpu_ms(pid);
+    int alive = waitpid(pid, NULL, WNOHANG) == 0;
+
+    double scale = ready ? 10000.0 / ready : 0;
+    printf("mode=%s connexions=%d prêtes=%d serveur=%s\n", mode, nbConn, ready,
+           alive ? "vivant" : "arrêté");
+    printf("temps de connexion : %.3f s\n", connectTime);
+    printf("RSS serveur : %ld kio -> %ld kio (%.1f Mio / 10k connexions)\n",
+           rssBefore, rssAfter, (rssAfter - rssBefore) * scale / 1024.0);
+    printf("CPU serveur : %.0f ms (%.0f ms / 10k connexions)\n",
+           cpuAfter - cpuBefore, (cpuAfter - cpuBefore) * scale);
+
+    for (int i = 0; i < opened; i++) close(socks[i]);
+    free(socks);
+
+    bench_stop_server(pid);
+
+    return ready == nbConn ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,179 @@
+/**
+ * Coût par destinataire de la boucle de diffusion : table en colonnes des
+ * ensembles d'utilisateurs (voir userset.h) contre le parcours d'une liste
+ * chaînée NODE -> elt -> struct user -> sock.
+ *
+ * N membres (10 000 puis 100 000 par défaut) rejoignent un ensemble et une
+ * liste dans un ordre mélangé, comme des arrivées au fil de l'eau ; chaque
+ * nouveau noeud est inséré après un noeud pris au hasard, l'ordre de la
+ * liste n'a donc rien à voir avec celui des noeuds en mémoire, comme après
+ * des arrivées et des départs. Chaque
+ * passe diffuse un message d'un membre à tous les autres : le membre est
+ * écarté s'il est l'émetteur ou s'il dépend d'un autre réacteur (-r), sinon
+ * sa file est touchée comme le ferait repeat_message(), sans envoi. Le coût
+ * retenu est la médiane des passes, en cycles (compteur de cycles du
+ * processeur) ou en nanosecondes s'il n'y en a pas. Ce programme est
+ * compilé avec -O2 pour mesurer l'accès à la mémoire plutôt que le code :
+ *
+ *   bench_fanout
+ *   bench_fanout -n 100000 -r 4 -p 50
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench_utils.h"
+#include "list/list.h"
+#include "user.h"
+#include "userset.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define UNIT "cycles"
+static uint64_t ticks(void) { return __builtin_ia32_rdtsc(); }
+#else
+#define UNIT "ns"
+static uint64_t ticks(void) { return bench_now_ns(); }
+#endif
+
+static int nbReactors = 1;
+static int nbPasses;
+
+/* La diffusion lit et écrit la première ligne d'un destinataire ; seul le
+ * compte d'octets change, la file reste vide */
+static void touch(struct user *u, size_t len) {
+    if (u->state == USER_CLOSING || u->proto != PROTO_V1) return;
+    u->outq.bytes += len;
+}
+
+static uint64_t pass_list(const struct list *l, int sender) {
+    uint64_t start = ticks();
+    for (struct node *n = l->first; n != NULL; n = n->next) {
+        struct user *u = n->elt;
+        if (u->owner != 0 || u->sock == sender) continue;
+        touch(u, 64);
+    }
+    return ticks() - start;
+}
+
+static uint64_t pass_table(struct userset *s, int sender) {
+    uint64_t start = ticks();
+    const struct user_set *set = userset_read_begin(s);
+    for (size_t i = userset_count(set); i-- > 0;) {
+        unsigned gen = __atomic_load_n(&set->gens[i], __ATOMIC_ACQUIRE);
+        int sock = __atomic_load_n(&set->socks[i], __ATOMIC_RELAXED);
+        int owner = __atomic_load_n(&set->owners[i], __ATOMIC_RELAXED);
+        struct user *u = __atomic_load_n(&set->users[i], __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (gen & 1 ||
+            gen != __atomic_load_n(&set->gens[i], __ATOMIC_RELAXED) ||
+            owner != 0 || sock == sender)
+            continue;
+        touch(u, 64);
+    }
+    userset_read_end();
+    return ticks() - start;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void run(size_t nbMembers) {
+    // Des membres sans socket réelle, arrivés dans le désordre
+    struct user **users = malloc(nbMembers * sizeof(*users));
+    struct node **nodes = malloc(nbMembers * sizeof(*nodes));
+    uint64_t *costs = malloc(2 * nbPasses * sizeof(*costs));
+    if (!users || !nodes || !costs) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < nbMembers; i++) {
+        users[i] = user_create(1000 + i);
+        users[i]->owner = i % nbReactors;
+    }
+    for (size_t i = nbMembers - 1; i > 0; i--) {
+        size_t j = rand() % (i + 1);
+        struct user *tmp = users[i];
+        users[i] = users[j];
+        users[j] = tmp;
+    }
+
+    struct list *l = list_create();
+    struct userset s;
+    userset_init(&s);
+    list_add(l, users[0]);
+    nodes[0] = l->first;
+    userset_add(&s, users[0], 0);
+    for (size_t i = 1; i < nbMembers; i++) {
+        struct node *after = nodes[rand() % i];
+        list_insert_after_node(l, users[i], after);
+        nodes[i] = after->next;
+        userset_add(&s, users[i], 0);
+    }
+
+    // Passes alternées, après un premier tour pour chauffer les caches
+    pass_list(l, -1);
+    pass_table(&s, -1);
+    for (int p = 0; p < nbPasses; p++) {
+        int sender = 1000 + rand() % nbMembers;
+        costs[p] = pass_list(l, sender);
+        costs[nbPasses + p] = pass_table(&s, sender);
+    }
+
+    qsort(costs, nbPasses, sizeof(*costs), compare_u64);
+    qsort(costs + nbPasses, nbPasses, sizeof(*costs), compare_u64);
+    double perList = (double)costs[nbPasses / 2] / nbMembers;
+    double perTable = (double)costs[nbPasses + nbPasses / 2] / nbMembers;
+
+    printf("membres : %zu, réacteurs : %d, passes : %d\n", nbMembers,
+           nbReactors, nbPasses);
+    printf("liste chaînée : %.2f %s par membre\n", perList, UNIT);
+    printf("table en colonnes : %.2f %s par membre (x%.1f)\n", perTable, UNIT,
+           perList / perTable);
+
+    // Les sockets sont factices : rien à fermer
+    list_free(l, NULL);
+    for (size_t i = 0; i < nbMembers; i++) {
+        users[i]->sock = -1;
+        user_free(users[i]);
+    }
+    free(users);
+    free(nodes);
+    free(costs);
+}
+
+int main(int argc, char *argv[]) {
+    size_t nbMembers = 0;
+    int passes = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:r:p:")) != -1) {
+        switch (opt) {
+            case 'n': nbMembers = strtoul(optarg, NULL, 10); break;
+            case 'r': nbReactors = atoi(optarg); break;
+            case 'p': passes = atoi(optarg); break;
+            default:
+                fprintf(stderr,
+                        "Usage : %s [-n membres] [-r réacteurs] [-p passes]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (nbReactors < 1) nbReactors = 1;
+
+    userset_setup();
+    srand(42);
+
+    size_t sizes[] = {10000, 100000};
+    for (int i = 0; i < 2; i++) {
+        size_t n = nbMembers ? nbMembers : sizes[i];
+        nbPasses = passes > 0 ? passes : n > 50000 ? 20 : 100;
+        run(n);
+        if (nbMembers) break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+/**
+ * Débit du journal des messages, avec et sans durabilité.
+ *
+ * P threads producteurs ajoutent chacun N messages de L octets, numérotés
+ * sous un même verrou comme le fait room_message() sur le chemin de
+ * diffusion, et mesurent la durée de chaque ajout. Le débit compte jusqu'à
+ * ce que tous les messages soient sur disque (journal_sync), ce qui inclut
+ * le dernier fdatasync :
+ *
+ *   bench_journal -f -1      # sans fdatasync
+ *   bench_journal -f 0       # fdatasync après chaque écriture groupée
+ *   bench_journal -f 10000   # un fdatasync toutes les 10 ms au plus
+ *
+ * Le journal est écrit dans un dossier temporaire (-d pour en choisir le
+ * parent), supprimé à la fin.
+ */
+
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench_utils.h"
+#include "journal/journal.h"
+
+static Journal *journal;
+static int nbProducers = 4;
+static long nbPerProducer = 100000;
+static size_t msgLen = 100;
+static struct bench_histo latencies;
+static pthread_mutex_t mutexLatencies = PTHREAD_MUTEX_INITIALIZER;
+static long refused;
+static uint64_t lastSeq;
+static pthread_mutex_t mutexSeq = PTHREAD_MUTEX_INITIALIZER;
+
+static void *producer(void *arg) {
+    char *msg = malloc(msgLen);
+    memset(msg, 'x', msgLen);
+    struct bench_histo *h = calloc(1, sizeof(*h));
+    long nbRefused = 0;
+
+    for (long i = 0; i < nbPerProducer; i++) {
+        uint64_t start = bench_now_ns();
+        pthread_mutex_lock(&mutexSeq);
+        if (journal_append(journal, ++lastSeq, msg, msgLen) < 0) nbRefused++;
+        pthread_mutex_unlock(&mutexSeq);
+        bench_histo_add(h, bench_now_ns() - start);
+    }
+
+    pthread_mutex_lock(&mutexLatencies);
+    bench_histo_merge(&latencies, h);
+    refused += nbRefused;
+    pthread_mutex_unlock(&mutexLatencies);
+
+    free(h);
+    free(msg);
+    return NULL;
+}
+
+static void remove_dir(const char *dir) {
+    char path[PATH_MAX];
+    DIR *d = opendir(dir);
+    struct dirent *ent;
+    while (d && (ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        unlink(path);
+    }
+    if (d) closedir(d);
+    rmdir(dir);
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    const char *parent = "/tmp";
+    struct journal_options opts = {.syncInterval = 10000};
+
+    while ((opt = getopt(argc, argv, "d:f:p:n:l:")) != -1) {
+        switch (opt) {
+            case 'd': parent = optarg; break;
+            case 'f': opts.syncInterval = atol(optarg); break;
+            case 'p': nbProducers = atoi(optarg); break;
+            case 'n': nbPerProducer = atol(optarg); break;
+            case 'l': msgLen = strtoul(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "Usage : %s [-d dossier] [-f fsync_us] "
+                                "[-p producteurs] [-n messages] "
+                                "[-l octets]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s/bench_journal.XXXXXX", parent);
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    journal = journal_open(dir, &opts);
+    if (!journal) {
+        perror("journal_open");
+        return EXIT_FAILURE;
+    }
+
+    pthread_t *threads = malloc(nbProducers * sizeof(pthread_t));
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int i = 0; i < nbProducers; i++)
+        pthread_create(&threads[i], NULL, producer, NULL);
+    for (int i = 0; i < nbProducers; i++) pthread_join(threads[i], NULL);
+    double appended = bench_elapsed(&start);
+
+    // Tout est écrit, et synchronisé si le journal l'est
+    journal_sync(journal);
+    double duration = bench_elapsed(&start);
+
+    long total = nbProducers * nbPerProducer - refused;
+    if (opts.syncInterval < 0)
+        printf("sans fdatasync : ");
+    else
+        printf("fdatasync toutes les %ld us : ", opts.syncInterval);
+    printf("%d producteurs x %ld messages de %zu octets\n", nbProducers,
+           nbPerProducer, msgLen);
+    printf("débit : %.0f messages/s sur disque (%.0f messages/s ajoutés), "
+           "%ld refusés\n",
+           total / duration, total / appended, refused);
+    printf("durée d'un ajout : p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           bench_histo_percentile(&latencies, 50) / 1e3,
+           bench_histo_percentile(&latencies, 99) / 1e3, latencies.max / 1e3);
+    journal_print(journal, stdout);
+
+    journal_close(journal);
+    remove_dir(dir);
+    free(threads);
+    return EXIT_SUCCESS;
+}
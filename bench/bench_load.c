@@ -0,0 +1,507 @@
+/**
+ * Test de charge du serveur Freescord sur la boucle locale.
+ *
+ * Lance bin/srv avec les options données, connecte C clients répartis sur
+ * T threads, chacun attendant ses clients avec epoll, puis chaque client
+ * envoie M messages de L octets, aussi vite que possible ou au débit total
+ * de R messages/s (répartis à tour de rôle entre les clients). Chaque
+ * message est diffusé aux C - 1 autres clients : on compte les messages
+ * reçus (repérés par le caractère '~') et on en déduit le débit du serveur
+ * en messages diffusés par seconde.
+ *
+ * Chaque message porte l'instant de son envoi ("T<ns>") : le délai jusqu'à
+ * sa réception par chaque destinataire donne la latence de diffusion
+ * (p50, p99, p99.9). Le nombre d'appels à sendmsg relevé dans les compteurs
+ * du serveur donne les appels système d'envoi par message ; avec les
+ * lectures et les attentes d'événements, ils donnent les appels système
+ * d'E/S par seconde. En mode uring, les envois et réceptions passent par
+ * l'anneau : seuls restent les io_uring_enter, comptés comme attentes.
+ *
+ * Avec -g G, les clients sont répartis dans des salons de G membres
+ * (/join #rK) et chaque message n'est diffusé qu'aux G - 1 autres membres
+ * de son salon : le coût par message ne doit dépendre que de G, pas du
+ * nombre total de connectés (temps CPU du serveur par message).
+ *
+ * Avec -j J, un thread supplémentaire connecte puis déconnecte J clients par
+ * seconde pendant la mesure, pour observer l'effet des arrivées et départs
+ * sur la diffusion.
+ *
+ * Avec -P P, chaque client envoie ses messages par paquets de P lignes en un
+ * seul send, comme un client qui enchaîne ses messages sans attendre : le
+ * serveur doit les découper et les diffuser tous.
+ *
+ * La durée de chaque connexion, jusqu'au pseudo accepté, est relevée elle
+ * aussi (p50, p99). Avec -J, le résultat est écrit en une ligne JSON, à
+ * comparer entre modes du serveur ou entre versions (make bench).
+ *
+ *   bench_load -x "-m epoll -r 1" -c 64 -n 200
+ *   bench_load -x "-m thread -b 500" -c 1000 -R 1000 -n 3
+ *   bench_load -x "-m thread" -c 200 -R 2000 -n 20 -j 500
+ *   bench_load -x "-m epoll" -c 2048 -g 8 -n 20
+ *   bench_load -x "-m epoll" -c 16 -n 2000 -P 16
+ *   bench_load -x "-m uring" -c 64 -n 200
+ *   bench_load -x "-m pool" -c 64 -n 200 -R 20000 -J
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench_utils.h"
+
+#define MARKER '~'
+#define STAMP 'T'
+#define IDLE_TIMEOUT_MS 5000
+
+struct load_client {
+    int sock;
+    int allowed;      // messages dont l'envoi est autorisé par le rythme
+    int sent;         // messages entièrement envoyés
+    size_t offset;    // octets déjà envoyés du paquet courant
+    int nbPacked;     // messages du paquet courant
+    char *msg;        // paquet courant, horodaté au début de son envoi
+    long received;    // messages reçus
+
+    // Horodatage en cours de lecture, il peut être coupé entre deux recv
+    uint64_t stamp;
+    int inStamp;
+};
+
+struct load_worker {
+    pthread_t thread;
+    struct load_client *clients;
+    int nbClients;
+    double rate;          // messages/s pour l'ensemble de ses clients
+    struct bench_histo latency;
+};
+
+/* Mesures d'un essai, -1 pour un compteur que le serveur n'expose pas */
+struct load_result {
+    const char *srvArgs;
+    int nbClients, roomSize;
+    double rate;
+    double connectTime;   // s
+    double duration;      // s
+    double cpu;           // ms
+    long nbSent;
+    long sendCalls, recvCalls, waitCalls, ringOps;
+    struct bench_histo *connectLatency, *latency;
+};
+
+static int nbMessages = 100;
+static int msgSize = 32;
+static int pipelineDepth = 1;
+static long expected;
+static long totalReceived;
+static pthread_mutex_t mutexTotal = PTHREAD_MUTEX_INITIALIZER;
+static uint16_t port = DEFAULT_BENCH_PORT;
+static double churnRate;
+static int churnDone;
+static long nbChurned;
+
+/* Prépare un message dans msg : "T<ns>xxx~\r\n" */
+static void stamp_message(char *msg) {
+    memset(msg, 'x', msgSize);
+    int len = snprintf(msg, msgSize, "%c%" PRIu64, STAMP, bench_now_ns());
+    msg[len] = 'x';
+    msg[msgSize - 3] = MARKER;
+    msg[msgSize - 2] = '\r';
+    msg[msgSize - 1] = '\n';
+}
+
+/* Envoie ce qui peut l'être sans bloquer pour le client c */
+static void pump_send(struct load_client *c) {
+    while (c->sent < c->allowed) {
+        // Jusqu'à pipelineDepth messages autorisés par paquet
+        if (c->offset == 0) {
+            c->nbPacked = c->allowed - c->sent;
+            if (c->nbPacked > pipelineDepth) c->nbPacked = pipelineDepth;
+            for (int k = 0; k < c->nbPacked; k++)
+                stamp_message(c->msg + k * msgSize);
+        }
+
+        size_t size = (size_t)c->nbPacked * msgSize;
+        int r = send(c->sock, c->msg + c->offset, size - c->offset,
+                     MSG_DONTWAIT);
+        if (r < 0) return;
+        c->offset += r;
+        if (c->offset < size) return;
+        c->offset = 0;
+        c->sent += c->nbPacked;
+    }
+}
+
+/* Compte les messages reçus dans buf et leur latence */
+static long parse_received(struct load_worker *w, struct load_client *c,
+                           const char *buf, int len, uint64_t now) {
+    long n = 0;
+
+    for (int k = 0; k < len; k++) {
+        char ch = buf[k];
+        if (ch == STAMP) {
+            c->inStamp = 1;
+            c->stamp = 0;
+        } else if (c->inStamp && ch >= '0' && ch <= '9') {
+            c->stamp = c->stamp * 10 + (ch - '0');
+        } else {
+            c->inStamp = 0;
+            if (ch == MARKER) {
+                if (c->stamp && c->stamp <= now)
+                    bench_histo_add(&w->latency, now - c->stamp);
+                c->stamp = 0;
+                n++;
+            }
+        }
+    }
+
+    return n;
+}
+
+static void *load_worker_run(void *arg) {
+    struct load_worker *w = arg;
+    struct epoll_event *events = malloc(w->nbClients * sizeof(*events));
+    char buf[16384];
+    int idleMs = 0;
+
+    long total = (long)w->nbClients * nbMessages;
+    long released = 0;
+    int next = 0;
+    uint64_t start = bench_now_ns();
+
+    // Seuls les clients qui ont reçu quelque chose sont lus
+    int epollFD = epoll_create1(0);
+    for (int i = 0; i < w->nbClients; i++) {
+        struct epoll_event ev = {.events = EPOLLIN, .data.u32 = i};
+        if (epoll_ctl(epollFD, EPOLL_CTL_ADD, w->clients[i].sock, &ev) < 0)
+            perror("epoll_ctl");
+        w->clients[i].allowed = w->rate > 0 ? 0 : nbMessages;
+    }
+    if (w->rate <= 0) released = total;
+
+    while (idleMs < IDLE_TIMEOUT_MS) {
+        // Au rythme demandé, un message de plus par client à tour de rôle
+        if (released < total) {
+            double due = (bench_now_ns() - start) / 1e9 * w->rate;
+            while (released < total && released < (long)due) {
+                w->clients[next].allowed++;
+                next = (next + 1) % w->nbClients;
+                released++;
+            }
+        }
+
+        int pending = 0;
+        for (int i = 0; i < w->nbClients; i++) {
+            pump_send(&w->clients[i]);
+            if (w->clients[i].sent < w->clients[i].allowed) pending = 1;
+        }
+
+        pthread_mutex_lock(&mutexTotal);
+        int done = totalReceived >= expected;
+        pthread_mutex_unlock(&mutexTotal);
+        if (done && !pending && released == total) break;
+
+        // Attente du prochain message à envoyer, au plus 10 ms
+        int timeout = 10;
+        if (pending) {
+            timeout = 0;
+        } else if (released < total) {
+            double nextNs = (released + 1) / w->rate * 1e9;
+            double waitMs = (nextNs - (bench_now_ns() - start)) / 1e6;
+            timeout = waitMs < 0 ? 0 : waitMs < 10 ? (int)waitMs + 1 : 10;
+        }
+
+        int nb = epoll_wait(epollFD, events, w->nbClients, timeout);
+        if (nb <= 0) {
+            if (!pending && released == total) idleMs += 10;
+            continue;
+        }
+        idleMs = 0;
+
+        long got = 0;
+        uint64_t now = bench_now_ns();
+        for (int k = 0; k < nb; k++) {
+            int i = events[k].data.u32;
+            int r = recv(w->clients[i].sock, buf, sizeof(buf), MSG_DONTWAIT);
+
+            // Connexion fermée par le serveur : plus rien à attendre
+            if (r == 0)
+                epoll_ctl(epollFD, EPOLL_CTL_DEL, w->clients[i].sock, NULL);
+            long n = parse_received(w, &w->clients[i], buf, r, now);
+            w->clients[i].received += n;
+            got += n;
+        }
+
+        pthread_mutex_lock(&mutexTotal);
+        totalReceived += got;
+        pthread_mutex_unlock(&mutexTotal);
+    }
+
+    close(epollFD);
+    free(events);
+    return NULL;
+}
+
+/* Connecte et déconnecte churnRate clients par seconde jusqu'à la fin */
+static void *churn_run(void *arg) {
+    uint64_t start = bench_now_ns();
+
+    while (!__atomic_load_n(&churnDone, __ATOMIC_ACQUIRE)) {
+        double due = (bench_now_ns() - start) / 1e9 * churnRate;
+        if (nbChurned >= (long)due) {
+            bench_sleep_ms(1);
+            continue;
+        }
+
+        char nick[16];
+        snprintf(nick, sizeof(nick), "j%ld", nbChurned);
+        int sock = bench_login(port, nick);
+        if (sock >= 0) close(sock);
+        nbChurned++;
+    }
+
+    return NULL;
+}
+
+/* Écrit le résultat r, une mesure par ligne */
+static void print_text(const struct load_result *r) {
+    printf("serveur : %s\n", r->srvArgs);
+    printf("clients=%d messages/client=%d taille=%d", r->nbClients, nbMessages,
+           msgSize);
+    if (r->rate > 0) printf(" rythme=%.0f messages/s", r->rate);
+    if (r->roomSize > 0) printf(" salons de %d", r->roomSize);
+    if (churnRate > 0) printf(" arrivées/départs=%ld", nbChurned);
+    if (pipelineDepth > 1) printf(" paquets de %d", pipelineDepth);
+    printf("\nconnexion : %.3f s (p50 %.0f µs  p99 %.0f µs  max %.0f µs)\n",
+           r->connectTime, bench_histo_percentile(r->connectLatency, 50) / 1e3,
+           bench_histo_percentile(r->connectLatency, 99) / 1e3,
+           r->connectLatency->max / 1e3);
+    printf("reçus : %ld / %ld en %.3f s\n", totalReceived, expected,
+           r->duration);
+    printf("débit : %.0f messages/s entrants, %.0f messages/s diffusés\n",
+           r->nbSent / r->duration, totalReceived / r->duration);
+    printf("latence (µs) : p50 %.0f  p99 %.0f  p99.9 %.0f  max %.0f\n",
+           bench_histo_percentile(r->latency, 50) / 1e3,
+           bench_histo_percentile(r->latency, 99) / 1e3,
+           bench_histo_percentile(r->latency, 99.9) / 1e3,
+           r->latency->max / 1e3);
+    printf("CPU serveur : %.0f ms, %.2f µs par message\n", r->cpu,
+           r->cpu * 1e3 / r->nbSent);
+    if (r->sendCalls >= 0)
+        printf("appels sendmsg : %ld, %.2f par message, %.4f par réception\n",
+               r->sendCalls, (double)r->sendCalls / r->nbSent,
+               totalReceived ? (double)r->sendCalls / totalReceived : 0.0);
+    if (r->ringOps >= 0) {
+        long syscalls = r->sendCalls + r->recvCalls + r->waitCalls;
+        printf("appels système E/S : %ld/s (envoi %ld, réception %ld, "
+               "attente %ld), %.2f par message\n",
+               (long)(syscalls / r->duration), r->sendCalls, r->recvCalls,
+               r->waitCalls, (double)syscalls / r->nbSent);
+        if (r->ringOps > 0)
+            printf("opérations io_uring : %ld/s, %.2f par message\n",
+                   (long)(r->ringOps / r->duration),
+                   (double)r->ringOps / r->nbSent);
+    }
+}
+
+/* Écrit le résultat r en une ligne JSON, latences en µs */
+static void print_json(const struct load_result *r) {
+    // Les options du serveur sont la seule chaîne libre
+    printf("{\"server\": \"");
+    for (const char *c = r->srvArgs; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            printf("\\%c", *c);
+        else if ((unsigned char)*c < 0x20)
+            printf("\\u%04x", *c);
+        else
+            putchar(*c);
+    }
+    printf("\", \"clients\": %d, \"messages_per_client\": %d, "
+           "\"size\": %d, \"rate\": %.0f, \"room_size\": %d, "
+           "\"pipeline\": %d, \"churned\": %ld, ",
+           r->nbClients, nbMessages, msgSize, r->rate, r->roomSize,
+           pipelineDepth, nbChurned);
+    printf("\"connect_s\": %.6f, \"connect_p50_us\": %.1f, "
+           "\"connect_p99_us\": %.1f, \"connect_max_us\": %.1f, ",
+           r->connectTime, bench_histo_percentile(r->connectLatency, 50) / 1e3,
+           bench_histo_percentile(r->connectLatency, 99) / 1e3,
+           r->connectLatency->max / 1e3);
+    printf("\"duration_s\": %.6f, \"sent\": %ld, \"received\": %ld, "
+           "\"expected\": %ld, \"in_per_s\": %.0f, \"out_per_s\": %.0f, ",
+           r->duration, r->nbSent, totalReceived, expected,
+           r->nbSent / r->duration, totalReceived / r->duration);
+    printf("\"p50_us\": %.1f, \"p99_us\": %.1f, \"p999_us\": %.1f, "
+           "\"max_us\": %.1f, \"cpu_ms\": %.0f, ",
+           bench_histo_percentile(r->latency, 50) / 1e3,
+           bench_histo_percentile(r->latency, 99) / 1e3,
+           bench_histo_percentile(r->latency, 99.9) / 1e3,
+           r->latency->max / 1e3, r->cpu);
+    printf("\"send_calls\": %ld, \"recv_calls\": %ld, "
+           "\"wait_calls\": %ld, \"ring_ops\": %ld}\n",
+           r->sendCalls, r->recvCalls, r->waitCalls, r->ringOps);
+}
+
+int main(int argc, char *argv[]) {
+    const char *srv = DEFAULT_SRV;
+    const char *srvArgs = "-m thread";
+    int nbClients = 32, nbThreads = 4;
+    double rate = 0;
+    int roomSize = 0, json = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:x:c:n:t:l:R:g:j:P:p:J")) != -1) {
+        switch (opt) {
+            case 's': srv = optarg; break;
+            case 'x': srvArgs = optarg; break;
+            case 'c': nbClients = atoi(optarg); break;
+            case 'n': nbMessages = atoi(optarg); break;
+            case 't': nbThreads = atoi(optarg); break;
+            case 'l': msgSize = atoi(optarg); break;
+            case 'R': rate = atof(optarg); break;
+            case 'g': roomSize = atoi(optarg); break;
+            case 'j': churnRate = atof(optarg); break;
+            case 'P': pipelineDepth = atoi(optarg); break;
+            case 'p': port = atoi(optarg); break;
+            case 'J': json = 1; break;
+            default:
+                fprintf(stderr,
+                        "Usage : %s [-s srv] [-x \"options srv\"] [-c clients] "
+                        "[-n messages] [-t threads] [-l taille] "
+                        "[-R messages/s] [-g taille salon] [-j connexions/s] "
+                        "[-P messages/envoi] [-p port] [-J]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    // Place pour "T", 20 chiffres et "~\r\n"
+    if (msgSize < 32) msgSize = 32;
+    if (nbThreads > nbClients) nbThreads = nbClients;
+    if (pipelineDepth < 1) pipelineDepth = 1;
+
+    signal(SIGPIPE, SIG_IGN);
+    bench_raise_fd_limit();
+
+    pid_t pid = bench_start_server(srv, srvArgs, port);
+    if (pid < 0) return EXIT_FAILURE;
+
+    struct load_client *clients = calloc(nbClients, sizeof(*clients));
+    struct bench_histo *connectLatency = calloc(1, sizeof(*connectLatency));
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int i = 0; i < nbClients; i++) {
+        char nick[16];
+        snprintf(nick, sizeof(nick), "l%d", i);
+        clients[i].msg = malloc((size_t)msgSize * pipelineDepth);
+        uint64_t loginStart = bench_now_ns();
+        clients[i].sock = bench_login(port, nick);
+        bench_histo_add(connectLatency, bench_now_ns() - loginStart);
+        if (clients[i].sock < 0) {
+            fprintf(stderr, "Connexion du client %d impossible\n", i);
+            bench_stop_server(pid);
+            return EXIT_FAILURE;
+        }
+
+        // Salon de roomSize clients consécutifs
+        if (roomSize > 0) {
+            char join[32];
+            int len = snprintf(join, sizeof(join), "/join #r%d\r\n",
+                               i / roomSize);
+            if (send(clients[i].sock, join, len, 0) != len ||
+                bench_wait_for(clients[i].sock, "***") < 0) {
+                fprintf(stderr, "Client %d : /join impossible\n", i);
+                bench_stop_server(pid);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    double connectTime = bench_elapsed(&start);
+
+    // Chaque message atteint les autres membres de son salon
+    if (roomSize > 0) {
+        expected = 0;
+        for (int first = 0; first < nbClients; first += roomSize) {
+            long members = nbClients - first;
+            if (members > roomSize) members = roomSize;
+            expected += members * nbMessages * (members - 1);
+        }
+    } else {
+        expected = (long)nbClients * nbMessages * (nbClients - 1);
+    }
+    long sendCallsBefore = bench_server_stat(pid, "send_calls");
+    long recvCallsBefore = bench_server_stat(pid, "recv_calls");
+    long waitCallsBefore = bench_server_stat(pid, "wait_calls");
+    long ringOpsBefore = bench_server_stat(pid, "ring_ops");
+    double cpuBefore = bench_cpu_ms(pid);
+
+    struct load_worker *workers = calloc(nbThreads, sizeof(*workers));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t churnThread;
+    if (churnRate > 0) pthread_create(&churnThread, NULL, churn_run, NULL);
+
+    for (int t = 0, first = 0; t < nbThreads; t++) {
+        int count = nbClients / nbThreads + (t < nbClients % nbThreads);
+        workers[t].clients = clients + first;
+        workers[t].nbClients = count;
+        workers[t].rate = rate * count / nbClients;
+        first += count;
+        pthread_create(&workers[t].thread, NULL, load_worker_run, &workers[t]);
+    }
+    for (int t = 0; t < nbThreads; t++) pthread_join(workers[t].thread, NULL);
+
+    double duration = bench_elapsed(&start);
+    if (churnRate > 0) {
+        __atomic_store_n(&churnDone, 1, __ATOMIC_RELEASE);
+        pthread_join(churnThread, NULL);
+    }
+    struct load_result r = {
+        .srvArgs = srvArgs,
+        .nbClients = nbClients,
+        .roomSize = roomSize,
+        .rate = rate,
+        .connectTime = connectTime,
+        .duration = duration,
+        .cpu = bench_cpu_ms(pid) - cpuBefore,
+        .nbSent = (long)nbClients * nbMessages,
+        .sendCalls = -1,
+        .recvCalls = -1,
+        .waitCalls = -1,
+        .ringOps = -1,
+        .connectLatency = connectLatency,
+        .latency = calloc(1, sizeof(struct bench_histo)),
+    };
+    if (sendCallsBefore >= 0)
+        r.sendCalls = bench_server_stat(pid, "send_calls") - sendCallsBefore;
+    if (ringOpsBefore >= 0) {
+        r.recvCalls = bench_server_stat(pid, "recv_calls") - recvCallsBefore;
+        r.waitCalls = bench_server_stat(pid, "wait_calls") - waitCallsBefore;
+        r.ringOps = bench_server_stat(pid, "ring_ops") - ringOpsBefore;
+    }
+    for (int t = 0; t < nbThreads; t++)
+        bench_histo_merge(r.latency, &workers[t].latency);
+
+    if (json)
+        print_json(&r);
+    else
+        print_text(&r);
+
+    for (int i = 0; i < nbClients; i++) {
+        close(clients[i].sock);
+        free(clients[i].msg);
+    }
+    free(clients);
+    free(workers);
+    free(r.latency);
+    free(connectLatency);
+
+    bench_stop_server(pid);
+
+    return totalReceived == expected ? EXIT_SUCCESS : EXIT_FAILURE;
+}
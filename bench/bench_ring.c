@@ -0,0 +1,139 @@
+/**
+ * Comparaison du tube et de la file sans verrou entre les threads clients et
+ * le répéteur du serveur.
+ *
+ * P threads producteurs déposent chacun N struct message_info horodatées,
+ * un thread consommateur les retire comme le fait read_tupe() et mesure le
+ * délai entre dépôt et retrait :
+ *
+ *   bench_ring -b pipe -p 4 -n 200000
+ *   bench_ring -b ring -p 4 -n 200000
+ */
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench_utils.h"
+#include "serveur.h"
+
+enum backend { BACKEND_PIPE, BACKEND_RING };
+
+static enum backend backend = BACKEND_RING;
+static int nbProducers = 4;
+static long nbPerProducer = 200000;
+static int tube[2];
+static Ring *ring;
+
+static void *producer(void *arg) {
+    struct message_info msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = MSG_BROADCAST;
+
+    for (long i = 0; i < nbPerProducer; i++) {
+        // Comme build_message() : un contenu partagé par message
+        uint64_t now = bench_now_ns();
+        msg.payload = payload_create((char *)&now, sizeof(now));
+
+        if (backend == BACKEND_PIPE) {
+            if (write(tube[1], &msg, sizeof(msg)) != sizeof(msg)) {
+                perror("write");
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            ring_push_wait(ring, &msg);
+        }
+    }
+    return NULL;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:p:n:")) != -1) {
+        switch (opt) {
+            case 'b':
+                backend = strcmp(optarg, "pipe") == 0 ? BACKEND_PIPE
+                                                      : BACKEND_RING;
+                break;
+            case 'p': nbProducers = atoi(optarg); break;
+            case 'n': nbPerProducer = atol(optarg); break;
+            default:
+                fprintf(stderr, "Usage : %s [-b pipe|ring] [-p producteurs] "
+                                "[-n messages]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (backend == BACKEND_PIPE) {
+        if (pipe(tube) < 0) {
+            perror("pipe");
+            return EXIT_FAILURE;
+        }
+    } else {
+        ring = ring_create(REPEATER_RING_SIZE, sizeof(struct message_info));
+    }
+
+    long total = nbProducers * nbPerProducer;
+    uint64_t *latencies = malloc(total * sizeof(uint64_t));
+    pthread_t *threads = malloc(nbProducers * sizeof(pthread_t));
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int i = 0; i < nbProducers; i++)
+        pthread_create(&threads[i], NULL, producer, NULL);
+
+    // Consommateur : même schéma que read_tupe()
+    struct message_info msg;
+    struct pollfd pfd = {backend == BACKEND_RING ? ring_fd(ring) : 0, POLLIN,
+                         0};
+    long received = 0;
+
+    while (received < total) {
+        if (backend == BACKEND_PIPE) {
+            if (read(tube[0], &msg, sizeof(msg)) != sizeof(msg)) {
+                perror("read");
+                return EXIT_FAILURE;
+            }
+        } else if (ring_pop(ring, &msg) < 0) {
+            if (ring_sleep(ring)) {
+                poll(&pfd, 1, -1);
+                ring_wake(ring);
+            }
+            continue;
+        }
+
+        uint64_t sent;
+        memcpy(&sent, msg.payload->data, sizeof(sent));
+        latencies[received++] = bench_now_ns() - sent;
+        payload_unref(msg.payload);
+    }
+
+    double duration = bench_elapsed(&start);
+    for (int i = 0; i < nbProducers; i++) pthread_join(threads[i], NULL);
+
+    qsort(latencies, total, sizeof(uint64_t), compare_u64);
+
+    printf("%s : %d producteurs x %ld messages de %zu octets\n",
+           backend == BACKEND_PIPE ? "tube" : "file", nbProducers,
+           nbPerProducer, sizeof(struct message_info));
+    printf("débit : %.0f messages/s\n", total / duration);
+    printf("latence dépôt -> retrait : p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           latencies[total / 2] / 1e3, latencies[total * 99 / 100] / 1e3,
+           latencies[total - 1] / 1e3);
+
+    free(latencies);
+    free(threads);
+    if (ring) ring_free(ring);
+    return EXIT_SUCCESS;
+}
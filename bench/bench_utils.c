@@ -0,0 +1,255 @@
+#include "bench_utils.h"
+
+#include <arpa/inet.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define MAX_SRV_ARGS 32
+
+/* Sortie du dernier serveur lancé, où il écrit ses compteurs */
+static char srvOutput[64];
+
+pid_t bench_start_server(const char *srv, const char *srvArgs, uint16_t port) {
+    char portStr[8];
+    snprintf(portStr, sizeof(portStr), "%u", port);
+
+    // Découpage des options supplémentaires
+    char *argsCopy = strdup(srvArgs ? srvArgs : "");
+    char *args[MAX_SRV_ARGS + 3];
+    int nbArgs = 0;
+
+    args[nbArgs++] = (char *)srv;
+    for (char *tok = strtok(argsCopy, " "); tok && nbArgs < MAX_SRV_ARGS;
+         tok = strtok(NULL, " "))
+        args[nbArgs++] = tok;
+    args[nbArgs++] = portStr;
+    args[nbArgs] = NULL;
+
+    snprintf(srvOutput, sizeof(srvOutput), "/tmp/freescord_bench_%u.out",
+             port);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        free(argsCopy);
+        return -1;
+    }
+    if (pid == 0) {
+        // La sortie standard du serveur est gardée pour relire ses compteurs
+        if (!freopen(srvOutput, "w", stdout)) perror("freopen");
+        execv(srv, args);
+        perror("execv");
+        _exit(EXIT_FAILURE);
+    }
+    free(argsCopy);
+
+    // Attendre que le serveur écoute
+    int probe = -1;
+    for (int i = 0; i < 100 && probe < 0; i++) {
+        bench_sleep_ms(20);
+        probe = bench_connect(port);
+    }
+    if (probe < 0) {
+        fprintf(stderr, "Le serveur ne répond pas sur le port %u\n", port);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+    close(probe);
+    bench_sleep_ms(100);
+
+    return pid;
+}
+
+void bench_stop_server(pid_t pid) {
+    kill(pid, SIGINT);
+    waitpid(pid, NULL, 0);
+    unlink(srvOutput);
+}
+
+long bench_server_stat(pid_t pid, const char *name) {
+    char line[256], key[64];
+    long value, found = -1;
+
+    kill(pid, SIGUSR1);
+    bench_sleep_ms(200);
+
+    FILE *f = fopen(srvOutput, "r");
+    if (!f) return -1;
+
+    // Le dernier affichage est le plus récent
+    while (fgets(line, sizeof(line), f))
+        if (sscanf(line, "%63s %ld", key, &value) == 2 &&
+            strcmp(key, name) == 0)
+            found = value;
+
+    fclose(f);
+    return found;
+}
+
+int bench_connect(uint16_t port) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) return -1;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int bench_wait_for(int sock, const char *expected) {
+    char buf[512];
+    size_t len = 0;
+
+    while (1) {
+        int r = recv(sock, buf + len, sizeof(buf) - 1 - len, 0);
+        if (r <= 0) return -1;
+        len += r;
+        buf[len] = '\0';
+        if (strstr(buf, expected)) return 0;
+
+        // Garder la fin du tampon au cas où le texte serait coupé
+        if (len > sizeof(buf) / 2) {
+            size_t keep = strlen(expected);
+            memmove(buf, buf + len - keep, keep);
+            len = keep;
+        }
+    }
+}
+
+int bench_login(uint16_t port, const char *nick) {
+    int sock = bench_connect(port);
+    if (sock < 0) return -1;
+
+    // Le pseudo est envoyé sans attendre l'invite
+    char line[32];
+    int len = snprintf(line, sizeof(line), "%s\r\n", nick);
+    if (send(sock, line, len, 0) < 0 || bench_wait_for(sock, "0 | ") < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+double bench_elapsed(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+uint64_t bench_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void bench_sleep_ms(long ms) {
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+long bench_rss_kb(pid_t pid) {
+    char path[64], line[256];
+    long rss = -1;
+
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    while (fgets(line, sizeof(line), f))
+        if (sscanf(line, "VmRSS: %ld kB", &rss) == 1) break;
+
+    fclose(f);
+    return rss;
+}
+
+double bench_cpu_ms(pid_t pid) {
+    char path[64], buf[1024];
+    unsigned long utime, stime;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+
+    // Les champs 14 et 15 suivent le nom du programme entre parenthèses
+    char *p = strrchr(buf, ')');
+    if (!p ||
+        sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+               &utime, &stime) != 2)
+        return -1;
+
+    return (utime + stime) * 1000.0 / sysconf(_SC_CLK_TCK);
+}
+
+/* Case de v : exacte en dessous de HISTO_SUB, puis HISTO_SUB cases par
+ * puissance de deux */
+static int histo_index(uint64_t v) {
+    if (v < HISTO_SUB) return v;
+
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - HISTO_SUB_BITS;
+    return HISTO_SUB + shift * HISTO_SUB + (int)((v >> shift) - HISTO_SUB);
+}
+
+/* Plus petite valeur de la case idx */
+static uint64_t histo_value(int idx) {
+    if (idx < HISTO_SUB) return idx;
+
+    int shift = (idx - HISTO_SUB) / HISTO_SUB;
+    uint64_t sub = (idx - HISTO_SUB) % HISTO_SUB;
+    return (HISTO_SUB + sub) << shift;
+}
+
+void bench_histo_add(struct bench_histo *h, uint64_t v) {
+    h->counts[histo_index(v)]++;
+    h->total++;
+    if (v > h->max) h->max = v;
+}
+
+void bench_histo_merge(struct bench_histo *dst, const struct bench_histo *src) {
+    for (int i = 0; i < HISTO_BUCKETS; i++) dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+uint64_t bench_histo_percentile(const struct bench_histo *h, double pct) {
+    if (h->total == 0) return 0;
+
+    uint64_t rank = (uint64_t)(pct / 100.0 * h->total + 0.5);
+    if (rank < 1) rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTO_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t v = histo_value(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+void bench_raise_fd_limit(void) {
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+}
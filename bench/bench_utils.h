@@ -0,0 +1,75 @@
+#ifndef BENCH_UTILS_H
+#define BENCH_UTILS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define DEFAULT_SRV "bin/srv"
+#define DEFAULT_BENCH_PORT 4400
+
+/* Histogramme log-linéaire : 2^HISTO_SUB_BITS cases par puissance de deux,
+ * soit une précision relative d'environ 3 % sur toute l'étendue */
+#define HISTO_SUB_BITS 5
+#define HISTO_SUB (1 << HISTO_SUB_BITS)
+#define HISTO_BUCKETS (HISTO_SUB + (64 - HISTO_SUB_BITS) * HISTO_SUB)
+
+struct bench_histo {
+    uint64_t counts[HISTO_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+};
+
+/** Outils communs aux programmes de mesure : lancement du serveur,
+ * connexions sur la boucle locale et relevés dans /proc. */
+
+/** Lancer le serveur srv sur le port donné avec les options supplémentaires
+ * srvArgs (séparées par des espaces, peut être NULL), attendre qu'il écoute et
+ * retourner son pid, ou -1 en cas d'échec */
+pid_t bench_start_server(const char *srv, const char *srvArgs, uint16_t port);
+
+/** Arrêter proprement le serveur lancé par bench_start_server */
+void bench_stop_server(pid_t pid);
+
+/** Faire afficher ses compteurs au serveur (SIGUSR1) et retourner la valeur
+ * du compteur name, ou -1 s'il est introuvable */
+long bench_server_stat(pid_t pid, const char *name);
+
+/** Ouvrir une connexion TCP sur 127.0.0.1:port, -1 en cas d'erreur */
+int bench_connect(uint16_t port);
+
+/** Lire sur sock jusqu'à recevoir le texte attendu
+ * retourne 0, ou -1 si la connexion est fermée avant */
+int bench_wait_for(int sock, const char *expected);
+
+/** Se connecter et mener la séquence de pseudo avec le pseudo nick
+ * retourne la socket prête à discuter, ou -1 */
+int bench_login(uint16_t port, const char *nick);
+
+/** Durée écoulée en secondes depuis start (horloge monotone) */
+double bench_elapsed(const struct timespec *start);
+
+/** Instant présent en nanosecondes (horloge monotone) */
+uint64_t bench_now_ns(void);
+
+void bench_sleep_ms(long ms);
+
+/** Mémoire résidente du processus pid en kio, -1 en cas d'erreur */
+long bench_rss_kb(pid_t pid);
+
+/** Temps CPU (utilisateur + système) du processus pid en millisecondes */
+double bench_cpu_ms(pid_t pid);
+
+/** Enregistrer la valeur v dans l'histogramme h (initialisé à zéro) */
+void bench_histo_add(struct bench_histo *h, uint64_t v);
+
+/** Ajouter les valeurs de src à dst */
+void bench_histo_merge(struct bench_histo *dst, const struct bench_histo *src);
+
+/** Valeur en dessous de laquelle se trouvent pct % des valeurs de h */
+uint64_t bench_histo_percentile(const struct bench_histo *h, double pct);
+
+/** Relever la limite du nombre de descripteurs ouverts à la limite dure */
+void bench_raise_fd_limit(void);
+
+#endif  // BENCH_UTILS_H
@@ -1,5 +1,7 @@
 #include "buffer.h"
 
+#include <errno.h>
+
 struct buffer {
     int FD;
     char *memBuf;
@@ -7,6 +9,7 @@ struct buffer {
     size_t bufSize;
     size_t readPos;
     size_t dataEnd;
+    size_t scanPos; /* début de la recherche de fin de ligne */
 
     int eof;
     int saved; /* Caractère remis (ungetc) */
@@ -17,7 +20,8 @@ Buffer *buff_create(int fd, size_t buffsz) {
     Buffer *new = malloc(sizeof(Buffer));
     if (!new) return NULL;
 
-    new->memBuf = malloc(buffsz);
+    /* Un octet de plus pour terminer une ligne qui remplit le tampon */
+    new->memBuf = malloc(buffsz + 1);
     if (!new->memBuf) {
         free(new);
         return NULL;
@@ -27,6 +31,7 @@ Buffer *buff_create(int fd, size_t buffsz) {
     new->bufSize = buffsz;
     new->readPos = 0;
     new->dataEnd = 0;
+    new->scanPos = 0;
     new->eof = 0;
     new->saved = EOF;
 
@@ -53,6 +58,7 @@ int buff_fill(Buffer *buf) {
 
     buf->readPos = 0;
     buf->dataEnd = bytesRead;
+    buf->scanPos = 0;
     return 0;
 }
 
@@ -138,4 +144,98 @@ char *buff_fgets_crlf(Buffer *buf, char *dest, size_t maxLen) {
 
     dest[charCount] = '\0';
     return dest;
-}
\ No newline at end of file
+}
+
+/* Ramène les octets non consommés au début du tampon ; retourne -1 (errno
+ * ENOBUFS) s'il ne reste aucune place à la suite */
+static int buff_compact(Buffer *buf) {
+    /* Seule la ligne incomplète est déplacée */
+    if (buf->readPos > 0) {
+        size_t remaining = buf->dataEnd - buf->readPos;
+        memmove(buf->memBuf, buf->memBuf + buf->readPos, remaining);
+        buf->scanPos -= buf->readPos;
+        buf->dataEnd = remaining;
+        buf->readPos = 0;
+    }
+
+    if (buf->dataEnd == buf->bufSize) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    return 0;
+}
+
+ssize_t buff_read_more(Buffer *buf) {
+    if (buff_compact(buf) < 0) return -1;
+
+    ssize_t bytesRead = read(buf->FD, buf->memBuf + buf->dataEnd,
+                             buf->bufSize - buf->dataEnd);
+    if (bytesRead == 0) buf->eof = 1;
+    if (bytesRead > 0) buf->dataEnd += bytesRead;
+
+    return bytesRead;
+}
+
+ssize_t buff_append(Buffer *buf, const char *data, size_t len) {
+    if (buff_compact(buf) < 0) return -1;
+
+    size_t room = buf->bufSize - buf->dataEnd;
+    if (len > room) len = room;
+    memcpy(buf->memBuf + buf->dataEnd, data, len);
+    buf->dataEnd += len;
+
+    return len;
+}
+
+/* Extraire une ligne complète sans copie */
+ssize_t buff_next_line(Buffer *buf, char **line) {
+    char *start = buf->memBuf + buf->readPos;
+    char *scan = buf->memBuf + buf->scanPos;
+    char *lf = memchr(scan, '\n', buf->dataEnd - buf->scanPos);
+    size_t len;
+
+    if (lf) {
+        len = lf - start;
+        buf->readPos += len + 1;
+    } else if (buf->readPos == 0 && buf->dataEnd == buf->bufSize) {
+        /* Ligne plus longue que le tampon : coupée */
+        len = buf->dataEnd;
+        buf->readPos = buf->dataEnd;
+    } else {
+        buf->scanPos = buf->dataEnd;
+        return -1;
+    }
+    buf->scanPos = buf->readPos;
+
+    if (len > 0 && start[len - 1] == '\r' && lf) len--;
+    start[len] = '\0';
+
+    *line = start;
+    return len;
+}
+
+/* Octets non consommés, sans copie */
+size_t buff_peek(Buffer *buf, char **data) {
+    *data = buf->memBuf + buf->readPos;
+    return buf->dataEnd - buf->readPos;
+}
+
+/* Consommer le début des octets non consommés */
+void buff_consume(Buffer *buf, size_t n) {
+    if (n > buf->dataEnd - buf->readPos) n = buf->dataEnd - buf->readPos;
+    buf->readPos += n;
+    if (buf->scanPos < buf->readPos) buf->scanPos = buf->readPos;
+}
+
+/* Agrandir le tampon, les positions restent valables */
+int buff_grow(Buffer *buf, size_t buffsz) {
+    if (buffsz <= buf->bufSize) return 0;
+
+    char *memBuf = realloc(buf->memBuf, buffsz + 1);
+    if (!memBuf) return -1;
+
+    buf->memBuf = memBuf;
+    buf->bufSize = buffsz;
+    return 0;
+}
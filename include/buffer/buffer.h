@@ -36,6 +36,23 @@
  * - buff_fgets pour une ligne terminée par '\n' (LF, line feed)
  * - buff_fgets_crlf pour une ligne terminée par '\r\n' (CRLF, carriage return
  *   and line feed)
+ *
+ * Enfin, pour découper un flux en lignes au fil des lectures (une socket
+ * non bloquante par exemple), sans copie ni appel à read caché :
+ * - buff_read_more lit une fois à la suite des octets non consommés
+ * - buff_next_line extrait la prochaine ligne complète, directement dans le
+ *   tampon ; une ligne incomplète reste en attente de la lecture suivante
+ * - buff_append remplace buff_read_more lorsque les octets ont été reçus
+ *   par ailleurs (io_uring par exemple)
+ *
+ *   while (buff_read_more(b) > 0)
+ *       while (buff_next_line(b, &line) >= 0) traiter(line);
+ *
+ * Pour un flux qui n'est pas découpé en lignes (des trames préfixées par
+ * leur taille par exemple), buff_peek donne accès aux octets non consommés
+ * et buff_consume en retire le début, toujours sans copie.
+ *
+ * Ces fonctions ne se mélangent pas avec buff_getc et buff_ungetc.
  */
 
 typedef struct buffer Buffer;
@@ -84,4 +101,38 @@ char *buff_fgets_crlf(Buffer *b, char *dest, size_t size);
 
 int buff_fill(Buffer *b);
 
+/** Lire une fois dans le fichier à la suite des octets non consommés, qui
+ * sont d'abord ramenés au début du tampon s'il le faut.
+ * Retourne le nombre d'octets lus, 0 en fin de fichier, -1 en cas d'erreur
+ * (errno est celui de read, EAGAIN pour un fichier non bloquant sans
+ * données, ENOBUFS si le tampon est plein). */
+ssize_t buff_read_more(Buffer *b);
+
+/** Ajouter à la suite des octets non consommés, comme buff_read_more, au
+ * plus len octets de data reçus par ailleurs (sans lire le fichier)
+ * Retourne le nombre d'octets copiés, -1 si le tampon est plein (errno
+ * ENOBUFS) : il faut consommer puis rappeler avec le reste. */
+ssize_t buff_append(Buffer *b, const char *data, size_t len);
+
+/** Extraire la prochaine ligne complète du tampon, sans lire le fichier ni
+ * copier : *line pointe sur la ligne dans le tampon, sans sa fin de ligne
+ * ("\n" ou "\r\n") et terminée par '\0'. Elle reste valable jusqu'au
+ * prochain appel à buff_read_more. Une ligne plus longue que le tampon est
+ * coupée à la taille du tampon.
+ * Retourne la longueur de la ligne, ou -1 s'il n'y a pas de ligne complète. */
+ssize_t buff_next_line(Buffer *b, char **line);
+
+/** Faire pointer *data sur les octets non consommés du tampon, valables
+ * jusqu'au prochain appel à buff_read_more
+ * retourne leur nombre */
+size_t buff_peek(Buffer *b, char **data);
+
+/** Consommer les n premiers octets non consommés (au plus buff_peek) */
+void buff_consume(Buffer *b, size_t n);
+
+/** Agrandir le tampon de b à buffsz octets, en gardant les octets non
+ * consommés (un tampon plus grand est laissé tel quel)
+ * retourne 0, ou -1 si l'allocation échoue (b est alors inchangé) */
+int buff_grow(Buffer *b, size_t buffsz);
+
 #endif
@@ -0,0 +1,95 @@
+#include "buffer.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* writes s in the pipe */
+void put(int fd, const char *s);
+
+int main(void)
+{
+	int fds[2];
+	assert(pipe(fds) == 0);
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+	Buffer *b = buff_create(fds[0], 16);
+	assert(b != NULL);
+	char *line;
+
+	/* nothing to read yet */
+	assert(buff_next_line(b, &line) == -1);
+	assert(buff_read_more(b) == -1 && errno == EAGAIN);
+
+	/* several lines in one read, LF or CRLF */
+	put(fds[1], "ab\ncd\r\n\nef");
+	assert(buff_read_more(b) == 10);
+	assert(buff_next_line(b, &line) == 2 && strcmp(line, "ab") == 0);
+	assert(buff_next_line(b, &line) == 2 && strcmp(line, "cd") == 0);
+	assert(buff_next_line(b, &line) == 0 && strcmp(line, "") == 0);
+	assert(buff_next_line(b, &line) == -1);
+
+	/* a partial line is kept across reads */
+	put(fds[1], "gh\r");
+	assert(buff_read_more(b) == 3);
+	assert(buff_next_line(b, &line) == -1);
+	put(fds[1], "\nij");
+	assert(buff_read_more(b) == 3);
+	assert(buff_next_line(b, &line) == 4 && strcmp(line, "efgh") == 0);
+	assert(buff_next_line(b, &line) == -1);
+
+	/* a line longer than the buffer is cut at the buffer size */
+	put(fds[1], "0123456789abcdefXY\n");
+	assert(buff_read_more(b) == 14);
+	assert(buff_next_line(b, &line) == 16);
+	assert(strcmp(line, "ij0123456789abcd") == 0);
+	assert(buff_read_more(b) == 5);
+	assert(buff_next_line(b, &line) == 4 && strcmp(line, "efXY") == 0);
+
+	/* raw access for non line based streams, mixed with lines */
+	put(fds[1], "12345kl\n");
+	assert(buff_read_more(b) == 8);
+	assert(buff_peek(b, &line) == 8 && memcmp(line, "12345", 5) == 0);
+	buff_consume(b, 5);
+	assert(buff_peek(b, &line) == 3);
+	assert(buff_next_line(b, &line) == 2 && strcmp(line, "kl") == 0);
+	assert(buff_peek(b, &line) == 0);
+
+	/* a full buffer can grow, keeping its partial line */
+	put(fds[1], "0123456789abcdefgh\n");
+	assert(buff_read_more(b) == 16);
+	assert(buff_read_more(b) == -1 && errno == ENOBUFS);
+	assert(buff_grow(b, 32) == 0);
+	assert(buff_read_more(b) == 3);
+	assert(buff_next_line(b, &line) == 18);
+	assert(strcmp(line, "0123456789abcdefgh") == 0);
+
+	/* bytes received elsewhere, copied as far as they fit */
+	assert(buff_append(b, "mn\nop", 5) == 5);
+	assert(buff_next_line(b, &line) == 2 && strcmp(line, "mn") == 0);
+	const char *more = "qr\n0123456789abcdef0123456789ABCD\n";
+	assert(buff_append(b, more, 34) == 30);
+	assert(buff_append(b, more + 30, 4) == -1 && errno == ENOBUFS);
+	assert(buff_next_line(b, &line) == 4 && strcmp(line, "opqr") == 0);
+	assert(buff_append(b, more + 30, 4) == 4);
+	assert(buff_next_line(b, &line) == 30);
+	assert(strcmp(line, "0123456789abcdef0123456789ABCD") == 0);
+
+
+	close(fds[1]);
+	assert(buff_read_more(b) == 0);
+	assert(buff_eof(b));
+
+	buff_free(b);
+	close(fds[0]);
+	printf("line framer: ok\n");
+
+	return 0;
+}
+
+void put(int fd, const char *s)
+{
+	assert(write(fd, s, strlen(s)) == (ssize_t) strlen(s));
+}
@@ -12,12 +12,15 @@
 #include <unistd.h>
 
 #include "buffer/buffer.h"
+#include "frame/frame.h"
 #include "utils.h"
 
 #define PROMPT "Moi : "
+#define NICKNAME_PROMPT "Entrez votre pseudo : "
 #define BUFFER_SIZE 1024
 #define PORT_FREESCORD 4321
 #define CONNECTION_HOST "127.0.0.1"
+#define RECONNECT_TRIES 5 /* tentatives de reprise après une coupure */
 
 #define CHECK_ERR(x, msg)                              \
     if (x < 0) {                                       \
@@ -25,22 +28,67 @@
         exit(EXIT_FAILURE);                            \
     }
 
+/* Session en cours, pour la reprendre après une coupure : pseudo accepté,
+ * jeton reçu du serveur et numéro du dernier message reçu */
+struct client_session {
+    char nick[BUFFER_SIZE];
+    char token[BUFFER_SIZE];
+    uint64_t lastSeq;
+};
+
 /** se connecter au serveur TCP d'adresse donnée en argument sous forme de
  * chaîne de caractère et au port donné en argument
  * retourne le descripteur de fichier de la socket obtenue ou -1 en cas
  * d'erreur. */
 int connect_serveur_tcp(char *adresse, uint16_t port);
 
-/** Reçoit un message de bienvenue de la part du server */
-void welcome_sequence(int sock);
+/** Reçoit un message de bienvenue de la part du server, négocie le
+ * protocole v2 puis choisit le pseudo. Un pseudo nick non NULL est proposé
+ * dès la négociation, sans attendre le serveur ; s'il est refusé, les
+ * suivants sont lus sur stdin. Le pseudo accepté est gardé dans session */
+void welcome_sequence(int sock, Buffer *socketBuf, const char *nick,
+                      struct client_session *session);
+
+/** Lit l'accueil du serveur jusqu'à PROTO_ACK, affiché sauf si quiet ; la
+ * fin de la ligne de PROTO_ACK (demande du pseudo) n'est affichée que si
+ * prompt est non nul
+ * retourne 0, ou -1 en cas d'erreur */
+int wait_ack(Buffer *socketBuf, bool quiet, bool prompt);
+
+/** Reprend la session après une coupure : quelques tentatives espacées de
+ * connexion à host:port, avec le pseudo, le jeton et le dernier numéro de
+ * session. *socketBuf est remplacé par le tampon de la nouvelle socket
+ * retourne la nouvelle socket, ou -1 si la session n'a pas pu être
+ * reprise */
+int resume_session(char *host, uint16_t port, struct client_session *session,
+                   Buffer **socketBuf);
 
 /** Gère l'entrée standard (stdin) et envoie le message au serveur
  * en utilisant un buffer pour la lecture */
 int handle_stdin(int sock, Buffer *stdinBuf);
 
-/** Gère la socket du serveur et affiche le message reçu
- * en utilisant un buffer pour la lecture */
-int handle_socket(int sock, Buffer *socketBuf);
+/** Gère la socket du serveur et affiche les messages reçus
+ * en utilisant un buffer pour la lecture ; le jeton et le dernier numéro
+ * reçus sont gardés dans session */
+int handle_socket(int sock, Buffer *socketBuf,
+                  struct client_session *session);
+
+/** Affiche les trames complètes déjà dans le tampon, sans lire la socket ;
+ * le jeton et le dernier numéro reçus sont gardés dans session
+ * retourne 0, ou -1 si une trame est invalide */
+int show_frames(Buffer *socketBuf, struct client_session *session);
+
+/** Envoie text dans une trame de type type
+ * retourne 0, ou -1 en cas d'erreur */
+int send_frame(int sock, enum frame_type type, const char *text);
+
+/** Extrait du buffer la prochaine trame complète, sans lire la socket
+ * retourne sa taille, 0 si elle est incomplète, -1 si elle est invalide */
+ssize_t next_frame(Buffer *b, struct frame *f);
+
+/** Attend la prochaine trame, en lisant la socket si besoin
+ * retourne 0, ou -1 en cas d'erreur */
+int wait_frame(Buffer *b, struct frame *f);
 
 /** Vérifie si la commande est une commande de déconnexion */
 int is_exit_command(char *buffer);
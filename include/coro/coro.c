@@ -0,0 +1,308 @@
+#define _DEFAULT_SOURCE
+#include "coro.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#define MAX_EVENTS 64
+
+struct coro {
+    ucontext_t ctx;
+    char *stack; /* page de garde comprise */
+    void (*fn)(void *);
+    void *arg;
+    struct coro *next; /* file des prêtes, ou piles libres */
+
+    int done;
+    int waiting;       /* dans coro_wait_fd */
+    int fd;            /* socket attendue */
+    int result;        /* valeur de retour de coro_wait_fd */
+    unsigned waitSeq;  /* numéro de l'attente, pour périmer les échéances */
+};
+
+/* Échéance d'une attente, valable tant que la coroutine n'a pas été
+ * réveillée par sa socket (même numéro d'attente) */
+struct coro_timer {
+    uint64_t deadline;
+    struct coro *c;
+    unsigned waitSeq;
+};
+
+struct coro_sched {
+    int epollFD;
+    size_t stackSize;
+    size_t pageSize;
+    ucontext_t main;
+    struct coro *current;
+
+    struct coro *readyFirst;
+    struct coro *readyLast;
+    struct coro *free; /* coroutines terminées, pile comprise */
+    size_t count;
+
+    /* Tas des échéances, la plus proche en tête */
+    struct coro_timer *timers;
+    size_t nbTimers;
+    size_t sizeTimers;
+};
+
+/* Ordonnanceur qui tourne dans ce thread */
+static __thread CoroSched *running;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+CoroSched *coro_sched_create(size_t stackSize) {
+    CoroSched *s = calloc(1, sizeof(CoroSched));
+    if (!s) return NULL;
+
+    s->epollFD = epoll_create1(0);
+    if (s->epollFD < 0) {
+        free(s);
+        return NULL;
+    }
+
+    s->pageSize = sysconf(_SC_PAGESIZE);
+    s->stackSize = (stackSize + s->pageSize - 1) / s->pageSize * s->pageSize;
+    return s;
+}
+
+void coro_sched_free(CoroSched *s) {
+    if (!s) return;
+
+    while (s->free) {
+        struct coro *c = s->free;
+        s->free = c->next;
+        munmap(c->stack, s->stackSize + s->pageSize);
+        free(c);
+    }
+
+    close(s->epollFD);
+    free(s->timers);
+    free(s);
+}
+
+static void ready_push(CoroSched *s, struct coro *c) {
+    c->next = NULL;
+    if (s->readyLast)
+        s->readyLast->next = c;
+    else
+        s->readyFirst = c;
+    s->readyLast = c;
+}
+
+/* Point d'entrée de chaque coroutine, qui revient ensuite à l'ordonnanceur
+ * (uc_link) */
+static void trampoline(void) {
+    struct coro *c = running->current;
+    c->fn(c->arg);
+    c->done = 1;
+}
+
+int coro_spawn(CoroSched *s, void (*fn)(void *), void *arg) {
+    // Une coroutine terminée prête sa pile, déjà en mémoire
+    struct coro *c = s->free;
+    if (c) {
+        s->free = c->next;
+    } else {
+        c = malloc(sizeof(struct coro));
+        if (!c) return -1;
+
+        c->stack = mmap(NULL, s->stackSize + s->pageSize,
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (c->stack == MAP_FAILED) {
+            free(c);
+            return -1;
+        }
+
+        // Page de garde : un débordement de pile s'arrête net
+        mprotect(c->stack, s->pageSize, PROT_NONE);
+    }
+
+    getcontext(&c->ctx);
+    c->ctx.uc_stack.ss_sp = c->stack + s->pageSize;
+    c->ctx.uc_stack.ss_size = s->stackSize;
+    c->ctx.uc_link = &s->main;
+    makecontext(&c->ctx, trampoline, 0);
+
+    c->fn = fn;
+    c->arg = arg;
+    c->done = 0;
+    c->waiting = 0;
+    c->waitSeq = 0;
+    s->count++;
+    ready_push(s, c);
+    return 0;
+}
+
+/*================== Échéances ==================*/
+static int timer_push(CoroSched *s, uint64_t deadline, struct coro *c) {
+    if (s->nbTimers == s->sizeTimers) {
+        size_t size = s->sizeTimers ? s->sizeTimers * 2 : 64;
+        struct coro_timer *timers =
+            realloc(s->timers, size * sizeof(struct coro_timer));
+        if (!timers) return -1;
+        s->timers = timers;
+        s->sizeTimers = size;
+    }
+
+    // Remontée dans le tas
+    size_t i = s->nbTimers++;
+    while (i > 0 && s->timers[(i - 1) / 2].deadline > deadline) {
+        s->timers[i] = s->timers[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    s->timers[i].deadline = deadline;
+    s->timers[i].c = c;
+    s->timers[i].waitSeq = c->waitSeq;
+    return 0;
+}
+
+static void timer_pop(CoroSched *s) {
+    struct coro_timer last = s->timers[--s->nbTimers];
+
+    // Descente du dernier élément depuis la racine
+    size_t i = 0;
+    while (2 * i + 1 < s->nbTimers) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < s->nbTimers &&
+            s->timers[child + 1].deadline < s->timers[child].deadline)
+            child++;
+        if (last.deadline <= s->timers[child].deadline) break;
+
+        s->timers[i] = s->timers[child];
+        i = child;
+    }
+    if (s->nbTimers > 0) s->timers[i] = last;
+}
+
+/* Réveille les coroutines dont l'échéance est passée */
+static void timers_fire(CoroSched *s) {
+    uint64_t now = now_us();
+
+    while (s->nbTimers > 0 && s->timers[0].deadline <= now) {
+        struct coro_timer t = s->timers[0];
+        timer_pop(s);
+
+        // Échéance périmée : la socket l'a réveillée avant
+        struct coro *c = t.c;
+        if (!c->waiting || c->waitSeq != t.waitSeq) continue;
+
+        epoll_ctl(s->epollFD, EPOLL_CTL_DEL, c->fd, NULL);
+        c->waiting = 0;
+        c->waitSeq++;
+        c->result = -1;
+        ready_push(s, c);
+    }
+}
+
+/* Délai d'epoll_wait en ms : 0 s'il y a des coroutines prêtes, sinon
+ * jusqu'à la prochaine échéance, -1 s'il n'y en a pas */
+static int next_timeout(CoroSched *s) {
+    if (s->readyFirst) return 0;
+    if (s->nbTimers == 0) return -1;
+
+    uint64_t now = now_us();
+    if (s->timers[0].deadline <= now) return 0;
+    return (s->timers[0].deadline - now + 999) / 1000;
+}
+
+/*================== Boucle ==================*/
+int coro_sched_run(CoroSched *s) {
+    struct epoll_event events[MAX_EVENTS];
+    CoroSched *outer = running;
+    running = s;
+
+    while (s->count > 0) {
+        // Seulement les coroutines prêtes à cet instant : celles qui cèdent
+        // la main repassent après la surveillance des sockets
+        struct coro *c = s->readyFirst;
+        s->readyFirst = s->readyLast = NULL;
+
+        while (c) {
+            struct coro *next = c->next;
+
+            s->current = c;
+            swapcontext(&s->main, &c->ctx);
+            s->current = NULL;
+
+            if (c->done) {
+                c->next = s->free;
+                s->free = c;
+                s->count--;
+            }
+            c = next;
+        }
+        if (s->count == 0) break;
+
+        int nbEvents =
+            epoll_wait(s->epollFD, events, MAX_EVENTS, next_timeout(s));
+        if (nbEvents < 0) {
+            if (errno == EINTR) continue;
+            running = outer;
+            return -1;
+        }
+
+        // Inscription EPOLLONESHOT : désactivée jusqu'à la prochaine attente
+        for (int i = 0; i < nbEvents; i++) {
+            c = events[i].data.ptr;
+            if (!c->waiting) continue;
+
+            c->waiting = 0;
+            c->waitSeq++;
+            c->result = 0;
+            ready_push(s, c);
+        }
+
+        timers_fire(s);
+    }
+
+    running = outer;
+    return 0;
+}
+
+int coro_wait_fd(int fd, int events, uint64_t deadline) {
+    CoroSched *s = running;
+    if (!s || !s->current) return -1;
+    struct coro *c = s->current;
+
+    struct epoll_event ev = {.events = EPOLLONESHOT, .data.ptr = c};
+    if (events & CORO_READ) ev.events |= EPOLLIN;
+    if (events & CORO_WRITE) ev.events |= EPOLLOUT;
+
+    // La socket reste inscrite d'une attente à la suivante
+    if (epoll_ctl(s->epollFD, EPOLL_CTL_MOD, fd, &ev) < 0 &&
+        (errno != ENOENT || epoll_ctl(s->epollFD, EPOLL_CTL_ADD, fd, &ev) < 0))
+        return -1;
+
+    if (deadline && timer_push(s, deadline, c) < 0) {
+        epoll_ctl(s->epollFD, EPOLL_CTL_DEL, fd, NULL);
+        return -1;
+    }
+
+    c->waiting = 1;
+    c->fd = fd;
+    swapcontext(&c->ctx, &s->main);
+    return c->result;
+}
+
+int coro_yield(void) {
+    CoroSched *s = running;
+    if (!s || !s->current) return -1;
+    struct coro *c = s->current;
+
+    ready_push(s, c);
+    swapcontext(&c->ctx, &s->main);
+    return 0;
+}
+
+size_t coro_count(const CoroSched *s) { return s->count; }
@@ -0,0 +1,70 @@
+#ifndef CORO_H
+#define CORO_H
+#include <stddef.h>
+#include <stdint.h>
+
+/** Coroutines à pile propre, ordonnancées par une boucle epoll
+ *
+ * CoroSched est un type opaque : un ordonnanceur, propre au thread qui le
+ * fait tourner. Chaque coroutine exécute une fonction ordinaire, écrite comme
+ * pour un thread, sur sa propre pile. Lorsqu'elle doit attendre une socket,
+ * elle appelle coro_wait_fd au lieu de bloquer : l'ordonnanceur reprend la
+ * main, surveille la socket avec epoll et fait tourner les autres coroutines
+ * en attendant.
+ *
+ * Les piles sont allouées avec une page de garde et recyclées d'une
+ * coroutine à la suivante : une coroutine ne coûte que les pages de pile
+ * qu'elle a réellement touchées. Les changements de contexte utilisent
+ * ucontext.
+ *
+ * Toutes les fonctions de cette bibliothèque commencent par le préfixe
+ * "coro_". Un ordonnanceur n'est pas protégé : seul son thread le manipule.
+ *
+ *   void session(void *arg) {
+ *       while (recv(fd, ...) < 0 && errno == EAGAIN)
+ *           coro_wait_fd(fd, CORO_READ, 0);
+ *       ...
+ *   }
+ *
+ *   CoroSched *s = coro_sched_create(64 * 1024);
+ *   coro_spawn(s, session, arg);
+ *   coro_sched_run(s);  // jusqu'à la fin de toutes les coroutines
+ */
+
+typedef struct coro_sched CoroSched;
+
+/* Événements attendus par coro_wait_fd */
+#define CORO_READ 1
+#define CORO_WRITE 2
+
+/** Créer un ordonnanceur dont les coroutines ont des piles de stackSize
+ * octets (arrondi aux pages)
+ * retourne NULL en cas d'erreur */
+CoroSched *coro_sched_create(size_t stackSize);
+
+/** Libérer l'ordonnanceur, qui ne doit plus avoir de coroutine, et ses
+ * piles */
+void coro_sched_free(CoroSched *s);
+
+/** Créer une coroutine qui exécutera fn(arg) au prochain tour de s
+ * retourne 0, ou -1 en cas d'erreur */
+int coro_spawn(CoroSched *s, void (*fn)(void *), void *arg);
+
+/** Faire tourner les coroutines de s jusqu'à ce qu'il n'en reste aucune
+ * retourne 0, ou -1 si epoll échoue */
+int coro_sched_run(CoroSched *s);
+
+/** Depuis une coroutine, attendre que fd soit prêt pour events (CORO_READ
+ * et/ou CORO_WRITE), en laissant tourner les autres. deadline est un instant
+ * de l'horloge CLOCK_MONOTONIC en microsecondes, 0 pour attendre sans limite
+ * retourne 0 si fd est prêt, -1 si deadline est passée ou hors coroutine */
+int coro_wait_fd(int fd, int events, uint64_t deadline);
+
+/** Depuis une coroutine, laisser tourner les autres avant de reprendre
+ * retourne 0, ou -1 hors coroutine */
+int coro_yield(void);
+
+/** Retourner le nombre de coroutines vivantes de s */
+size_t coro_count(const CoroSched *s);
+
+#endif
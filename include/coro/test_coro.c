@@ -0,0 +1,133 @@
+#include "coro.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NB_ROUNDS 1000
+#define NB_MANY 10000
+
+static char trace[16];
+static int traceLen;
+
+/* appends its letter to the trace, yielding in between */
+static void letter(void *arg)
+{
+	trace[traceLen++] = *(char *)arg;
+	coro_yield();
+	trace[traceLen++] = *(char *)arg;
+}
+
+/* reads a counter from fd, sends it back incremented, NB_ROUNDS times */
+static void pong(void *arg)
+{
+	int fd = *(int *)arg;
+	int v;
+
+	for (int i = 0; i < NB_ROUNDS; i++) {
+		while (recv(fd, &v, sizeof(v), 0) < 0) {
+			assert(errno == EAGAIN);
+			assert(coro_wait_fd(fd, CORO_READ, 0) == 0);
+		}
+		v++;
+		assert(send(fd, &v, sizeof(v), 0) == sizeof(v));
+	}
+}
+
+/* starts the exchange, checks every answer */
+static void ping(void *arg)
+{
+	int fd = *(int *)arg;
+	int v = 0;
+
+	for (int i = 0; i < NB_ROUNDS; i++) {
+		assert(send(fd, &v, sizeof(v), 0) == sizeof(v));
+		while (recv(fd, &v, sizeof(v), 0) < 0)
+			assert(coro_wait_fd(fd, CORO_READ, 0) == 0);
+		assert(v == 2 * i + 1);
+		v++;
+	}
+}
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* waits on a silent socket until its deadline */
+static void expire(void *arg)
+{
+	int fd = *(int *)arg;
+	uint64_t deadline = now_us() + 20000;
+
+	assert(coro_wait_fd(fd, CORO_READ, deadline) == -1);
+	assert(now_us() >= deadline);
+}
+
+static int nbDone;
+
+/* touches a bit of its own stack */
+static void small(void *arg)
+{
+	char local[1024];
+	memset(local, *(int *)arg, sizeof(local));
+	coro_yield();
+	nbDone += local[0] == *(int *)arg;
+}
+
+int main(void)
+{
+	CoroSched *s = coro_sched_create(16 * 1024);
+	assert(s != NULL);
+
+	/* outside a coroutine nothing can wait */
+	assert(coro_yield() == -1);
+	assert(coro_wait_fd(0, CORO_READ, 0) == -1);
+
+	/* round robin between yields */
+	char a = 'a', b = 'b';
+	assert(coro_spawn(s, letter, &a) == 0);
+	assert(coro_spawn(s, letter, &b) == 0);
+	assert(coro_count(s) == 2);
+	assert(coro_sched_run(s) == 0);
+	assert(coro_count(s) == 0);
+	assert(traceLen == 4 && memcmp(trace, "abab", 4) == 0);
+
+	/* two coroutines talking over non blocking sockets */
+	int fds[2];
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, O_NONBLOCK);
+	assert(coro_spawn(s, pong, &fds[1]) == 0);
+	assert(coro_spawn(s, ping, &fds[0]) == 0);
+	assert(coro_sched_run(s) == 0);
+
+	/* deadlines */
+	assert(coro_spawn(s, expire, &fds[0]) == 0);
+	assert(coro_sched_run(s) == 0);
+	close(fds[0]);
+	close(fds[1]);
+
+	/* many coroutines alive at once, stacks are recycled */
+	static int values[NB_MANY];
+	for (int round = 0; round < 2; round++) {
+		for (int i = 0; i < NB_MANY; i++) {
+			values[i] = i & 0x7f;
+			assert(coro_spawn(s, small, &values[i]) == 0);
+		}
+		assert(coro_count(s) == NB_MANY);
+		assert(coro_sched_run(s) == 0);
+	}
+	assert(nbDone == 2 * NB_MANY);
+
+	coro_sched_free(s);
+	printf("coroutines: ok\n");
+
+	return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef COSERVER_H
+#define COSERVER_H
+
+#include "coro/coro.h"
+#include "serveur.h"
+
+/*================== Coroutines ==================*/
+/** Mode coro : chaque connexion est une coroutine qui exécute le même code
+ * en ligne droite qu'un thread client (handle_client), sur une petite pile
+ * de config.stackSize octets. Une lecture qui bloquerait cède la main à la
+ * boucle epoll de l'ordonnanceur (voir next_input), qui fait tourner toutes
+ * les connexions dans un seul thread. Les messages reçus sont déposés dans
+ * la file du répéteur, qui doit déjà tourner. Ne retourne qu'en cas
+ * d'erreur fatale */
+void coserver_run(int listenFD);
+
+/** Coroutine d'acceptation : une coroutine client par connexion acceptée
+ * sur la socket d'écoute non bloquante pointée par listenFD */
+void coserver_accept(void *listenFD);
+
+/** Coroutine d'une connexion : accueil avec échéance puis handle_client */
+void coserver_client(void *user);
+
+#endif  // COSERVER_H
@@ -0,0 +1,197 @@
+#include "epoch.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#define CACHE_LINE 64
+
+/* L'état d'un lecteur tient dans un mot : époque observée décalée d'un bit,
+ * et bit de poids faible à 1 pendant une section de lecture */
+#define PINNED 1UL
+
+/* Emplacement d'un thread lecteur, jamais libéré avant le domaine : un
+ * thread terminé le rend et un nouveau thread peut le reprendre */
+struct epoch_record {
+    unsigned long state;
+    int used;
+    struct epoch_record *next;
+    char pad[CACHE_LINE - sizeof(unsigned long) - sizeof(int) -
+             sizeof(void *)];
+};
+
+/* Objet en attente, avec l'époque à laquelle il a été retiré */
+struct retired {
+    void *ptr;
+    void (*free_fct)(void *);
+    unsigned long epoch;
+    struct retired *next;
+};
+
+struct epoch {
+    unsigned long global;
+    struct epoch_record *records;
+    pthread_key_t key;
+
+    // Les écrivains se partagent la liste d'attente
+    pthread_mutex_t mutexRetired;
+    struct retired *retired;
+    int nbRetired;
+};
+
+/* Rend l'emplacement d'un thread qui se termine */
+static void release_record(void *rec) {
+    struct epoch_record *r = rec;
+    __atomic_store_n(&r->state, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&r->used, 0, __ATOMIC_RELEASE);
+}
+
+Epoch *epoch_create(void) {
+    Epoch *e = calloc(1, sizeof(Epoch));
+    if (!e) return NULL;
+
+    if (pthread_key_create(&e->key, release_record) != 0) {
+        free(e);
+        return NULL;
+    }
+    pthread_mutex_init(&e->mutexRetired, NULL);
+    return e;
+}
+
+void epoch_free(Epoch *e) {
+    if (!e) return;
+
+    while (e->retired) {
+        struct retired *r = e->retired;
+        e->retired = r->next;
+        r->free_fct(r->ptr);
+        free(r);
+    }
+
+    while (e->records) {
+        struct epoch_record *r = e->records;
+        e->records = r->next;
+        free(r);
+    }
+
+    pthread_key_delete(e->key);
+    pthread_mutex_destroy(&e->mutexRetired);
+    free(e);
+}
+
+/* Emplacement du thread courant, pris au premier appel */
+static struct epoch_record *get_record(Epoch *e) {
+    struct epoch_record *rec = pthread_getspecific(e->key);
+    if (rec) return rec;
+
+    // Reprendre un emplacement libéré par un thread terminé
+    for (rec = __atomic_load_n(&e->records, __ATOMIC_ACQUIRE); rec;
+         rec = rec->next) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&rec->used, &expected, 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            break;
+    }
+
+    // Sinon en ajouter un en tête de liste
+    if (!rec) {
+        rec = calloc(1, sizeof(*rec));
+        if (!rec) abort();
+        rec->used = 1;
+        rec->next = __atomic_load_n(&e->records, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&e->records, &rec->next, rec, 1,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+    }
+
+    pthread_setspecific(e->key, rec);
+    return rec;
+}
+
+void epoch_enter(Epoch *e) {
+    struct epoch_record *rec = get_record(e);
+    unsigned long global = __atomic_load_n(&e->global, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&rec->state, (global << 1) | PINNED, __ATOMIC_RELAXED);
+
+    // Les lectures de la section ne doivent pas précéder la publication
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void epoch_exit(Epoch *e) {
+    struct epoch_record *rec = pthread_getspecific(e->key);
+    __atomic_store_n(&rec->state, 0, __ATOMIC_RELEASE);
+}
+
+void epoch_retire(Epoch *e, void *ptr, void (*free_fct)(void *)) {
+    struct retired *r = malloc(sizeof(*r));
+    if (!r) abort();
+    r->ptr = ptr;
+    r->free_fct = free_fct;
+
+    // L'époque est lue après le retrait de ptr de la structure partagée
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    r->epoch = __atomic_load_n(&e->global, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&e->mutexRetired);
+    r->next = e->retired;
+    e->retired = r;
+    e->nbRetired++;
+    pthread_mutex_unlock(&e->mutexRetired);
+}
+
+/* Avance l'époque globale si tous les lecteurs en section l'ont observée */
+static unsigned long try_advance(Epoch *e) {
+    unsigned long global = __atomic_load_n(&e->global, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    for (struct epoch_record *rec =
+             __atomic_load_n(&e->records, __ATOMIC_ACQUIRE);
+         rec; rec = rec->next) {
+        unsigned long state = __atomic_load_n(&rec->state, __ATOMIC_ACQUIRE);
+        if ((state & PINNED) && (state >> 1) != global) return global;
+    }
+
+    __atomic_compare_exchange_n(&e->global, &global, global + 1, 0,
+                                __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    return __atomic_load_n(&e->global, __ATOMIC_ACQUIRE);
+}
+
+int epoch_reclaim(Epoch *e) {
+    pthread_mutex_lock(&e->mutexRetired);
+    unsigned long global = try_advance(e);
+
+    // Un objet retiré à l'époque n est libre dès l'époque n + 2 : tout
+    // lecteur qui a pu le voir est alors sorti de sa section
+    struct retired *freeList = NULL;
+    struct retired **prev = &e->retired;
+    while (*prev) {
+        struct retired *r = *prev;
+        if (global - r->epoch >= 2) {
+            *prev = r->next;
+            r->next = freeList;
+            freeList = r;
+            e->nbRetired--;
+        } else {
+            prev = &r->next;
+        }
+    }
+    pthread_mutex_unlock(&e->mutexRetired);
+
+    int nbFreed = 0;
+    while (freeList) {
+        struct retired *r = freeList;
+        freeList = r->next;
+        r->free_fct(r->ptr);
+        free(r);
+        nbFreed++;
+    }
+
+    return nbFreed;
+}
+
+int epoch_pending(Epoch *e) {
+    pthread_mutex_lock(&e->mutexRetired);
+    int nb = e->nbRetired;
+    pthread_mutex_unlock(&e->mutexRetired);
+    return nb;
+}
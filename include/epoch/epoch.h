@@ -0,0 +1,63 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+/** Récupération de mémoire par époques, pour des structures partagées lues
+ * sans verrou
+ *
+ * Epoch est un type opaque représentant un domaine de récupération. Les
+ * lecteurs encadrent chaque accès à une donnée partagée par epoch_enter et
+ * epoch_exit, sans verrou ni appel système. Un écrivain qui remplace une
+ * donnée publie la nouvelle version puis confie l'ancienne à epoch_retire :
+ * elle n'est libérée qu'une fois que plus aucun lecteur ne peut la tenir,
+ * c'est-à-dire après deux avancées de l'époque globale.
+ *
+ * Toutes les fonctions de cette bibliothèque commencent par le préfixe
+ * "epoch_". À part epoch_create, elles prennent toutes un pointeur vers un
+ * domaine en premier argument.
+ *
+ * Chaque thread lecteur est enregistré automatiquement à son premier
+ * epoch_enter, et son emplacement est réutilisé après sa terminaison. Les
+ * sections de lecture ne s'imbriquent pas et ne doivent pas bloquer
+ * longtemps, sans quoi plus rien n'est libéré :
+ *
+ *   epoch_enter(e);
+ *   struct data *d = __atomic_load_n(&shared, __ATOMIC_ACQUIRE);
+ *   lire(d);
+ *   epoch_exit(e);
+ *
+ *   // écrivain
+ *   struct data *old = shared;
+ *   __atomic_store_n(&shared, copie_modifiee, __ATOMIC_RELEASE);
+ *   epoch_retire(e, old, free);
+ */
+
+typedef struct epoch Epoch;
+
+/** Créer un domaine de récupération
+ * retourne NULL en cas d'erreur */
+Epoch *epoch_create(void);
+
+/** Libérer le domaine et tout ce qui attend encore d'être libéré. Aucun
+ * lecteur ne doit plus l'utiliser */
+void epoch_free(Epoch *e);
+
+/** Entrer dans une section de lecture */
+void epoch_enter(Epoch *e);
+
+/** Sortir de la section de lecture */
+void epoch_exit(Epoch *e);
+
+/** Confier ptr, déjà retiré de toute structure partagée, pour qu'il soit
+ * libéré avec free_fct quand plus aucun lecteur ne peut le tenir. Peut être
+ * appelée depuis plusieurs threads */
+void epoch_retire(Epoch *e, void *ptr, void (*free_fct)(void *));
+
+/** Libérer tout ce qui peut l'être, en faisant avancer l'époque si tous les
+ * lecteurs actifs l'ont rejointe
+ * retourne le nombre d'objets libérés */
+int epoch_reclaim(Epoch *e);
+
+/** Retourner le nombre d'objets en attente de libération */
+int epoch_pending(Epoch *e);
+
+#endif
@@ -0,0 +1,130 @@
+#include "epoch.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NB_READERS 4
+#define NB_VERSIONS 20000
+#define MAGIC 0x5eed
+
+/* a published version: valid while magic is set */
+struct version {
+	int magic;
+	int number;
+};
+
+/* reads the current version in a loop until the writer is done */
+void *reader(void *arg);
+
+/* clears the magic before freeing, so that a use after free is noticed */
+void poison_free(void *ptr);
+
+static Epoch *domain;
+static struct version *current;
+static int done;
+static int nbFreed;
+
+int main(void)
+{
+	/* single thread tests */
+	domain = epoch_create();
+	assert(domain != NULL);
+	assert(epoch_reclaim(domain) == 0);
+
+	/* a retired object waits for two epochs */
+	struct version *v = malloc(sizeof(*v));
+	v->magic = MAGIC;
+	epoch_retire(domain, v, poison_free);
+	assert(epoch_pending(domain) == 1);
+	assert(epoch_reclaim(domain) == 0);
+	assert(epoch_reclaim(domain) == 1);
+	assert(epoch_pending(domain) == 0);
+	assert(nbFreed == 1);
+
+	/* a reader in its section holds back the epoch */
+	epoch_enter(domain);
+	v = malloc(sizeof(*v));
+	v->magic = MAGIC;
+	epoch_retire(domain, v, poison_free);
+	for (int i = 0; i < 10; i++)
+		assert(epoch_reclaim(domain) == 0);
+	epoch_exit(domain);
+	assert(epoch_reclaim(domain) + epoch_reclaim(domain) == 1);
+
+	/* a reader between two sections holds nothing */
+	epoch_enter(domain);
+	epoch_exit(domain);
+	v = malloc(sizeof(*v));
+	v->magic = MAGIC;
+	epoch_retire(domain, v, poison_free);
+	assert(epoch_reclaim(domain) + epoch_reclaim(domain) == 1);
+
+	/* pending objects are freed with the domain */
+	v = malloc(sizeof(*v));
+	v->magic = MAGIC;
+	epoch_retire(domain, v, poison_free);
+	epoch_free(domain);
+	assert(nbFreed == 4);
+	printf("single thread: ok\n");
+
+	/* one writer publishes new versions while readers keep reading the
+	 * current one: no reader ever sees a freed version */
+	domain = epoch_create();
+	current = malloc(sizeof(*current));
+	current->magic = MAGIC;
+	current->number = 0;
+
+	pthread_t threads[NB_READERS];
+	for (int i = 0; i < NB_READERS; i++)
+		pthread_create(&threads[i], NULL, reader, NULL);
+
+	for (int i = 1; i <= NB_VERSIONS; i++) {
+		struct version *next = malloc(sizeof(*next));
+		next->magic = MAGIC;
+		next->number = i;
+
+		struct version *old = current;
+		__atomic_store_n(&current, next, __ATOMIC_RELEASE);
+		epoch_retire(domain, old, poison_free);
+		epoch_reclaim(domain);
+	}
+	__atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+
+	for (int i = 0; i < NB_READERS; i++)
+		pthread_join(threads[i], NULL);
+
+	/* without readers, everything is eventually freed */
+	epoch_reclaim(domain);
+	epoch_reclaim(domain);
+	assert(epoch_pending(domain) == 0);
+
+	epoch_free(domain);
+	free(current);
+	printf("%d readers: ok\n", NB_READERS);
+
+	return 0;
+}
+
+void *reader(void *arg)
+{
+	int last = 0;
+
+	while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+		epoch_enter(domain);
+		struct version *v = __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+		assert(v->magic == MAGIC);
+		assert(v->number >= last);
+		last = v->number;
+		epoch_exit(domain);
+	}
+	return NULL;
+}
+
+void poison_free(void *ptr)
+{
+	struct version *v = ptr;
+	v->magic = 0;
+	free(v);
+	__atomic_add_fetch(&nbFreed, 1, __ATOMIC_RELAXED);
+}
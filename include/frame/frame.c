@@ -0,0 +1,101 @@
+#include "frame.h"
+
+#include <string.h>
+
+static void put_u32(char *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static uint32_t get_u32(const char *p) {
+    const unsigned char *u = (const unsigned char *)p;
+    return (uint32_t)u[0] << 24 | (uint32_t)u[1] << 16 | (uint32_t)u[2] << 8 |
+           u[3];
+}
+
+static void put_u64(char *p, uint64_t v) {
+    put_u32(p, v >> 32);
+    put_u32(p + 4, v);
+}
+
+static uint64_t get_u64(const char *p) {
+    return (uint64_t)get_u32(p) << 32 | get_u32(p + 4);
+}
+
+size_t frame_size(const struct frame *f) {
+    if (f->senderLen > 255 || f->roomLen > 255) return 0;
+
+    size_t size = FRAME_HEADER_SIZE + (f->time ? FRAME_STAMP_SIZE : 0) +
+                  f->senderLen + 1 + f->roomLen + 1 + f->bodyLen + 1;
+    return size <= FRAME_MAX_SIZE ? size : 0;
+}
+
+size_t frame_encode(const struct frame *f, char *dest) {
+    size_t size = frame_size(f);
+    if (!size) return 0;
+
+    put_u32(dest, size);
+    dest[4] = f->type;
+    dest[5] = f->senderLen;
+    dest[6] = f->roomLen;
+    dest[7] = f->time ? FRAME_STAMPED : 0;
+    put_u32(dest + 8, f->seq);
+
+    char *p = dest + FRAME_HEADER_SIZE;
+    if (f->time) {
+        put_u64(p, f->seq);
+        put_u64(p + 8, f->time);
+        p += FRAME_STAMP_SIZE;
+    }
+
+    // Chaque champ suivi de son octet nul
+    if (f->senderLen) memcpy(p, f->sender, f->senderLen);
+    p += f->senderLen;
+    *p++ = '\0';
+    if (f->roomLen) memcpy(p, f->room, f->roomLen);
+    p += f->roomLen;
+    *p++ = '\0';
+    if (f->bodyLen) memcpy(p, f->body, f->bodyLen);
+    p += f->bodyLen;
+    *p = '\0';
+
+    return size;
+}
+
+ssize_t frame_decode(const char *data, size_t len, struct frame *f) {
+    if (len < FRAME_HEADER_SIZE) return 0;
+
+    // L'en-tête suffit à connaître la trame entière
+    size_t size = get_u32(data);
+    size_t senderLen = (unsigned char)data[5];
+    size_t roomLen = (unsigned char)data[6];
+    size_t stamp = data[7] & FRAME_STAMPED ? FRAME_STAMP_SIZE : 0;
+    size_t fixed =
+        FRAME_HEADER_SIZE + stamp + senderLen + 1 + roomLen + 1 + 1;
+    if (size > FRAME_MAX_SIZE || size < fixed) return -1;
+    if (len < size) return 0;
+
+    const char *sender = data + FRAME_HEADER_SIZE + stamp;
+    const char *room = sender + senderLen + 1;
+    const char *body = room + roomLen + 1;
+    if (sender[senderLen] || room[roomLen] || data[size - 1]) return -1;
+
+    f->type = data[4];
+    f->seq = stamp ? get_u64(data + FRAME_HEADER_SIZE) : get_u32(data + 8);
+    f->time = stamp ? get_u64(data + FRAME_HEADER_SIZE + 8) : 0;
+    f->sender = sender;
+    f->senderLen = senderLen;
+    f->room = room;
+    f->roomLen = roomLen;
+    f->body = body;
+    f->bodyLen = size - fixed;
+
+    return size;
+}
+
+void frame_set_seq(char *data, uint64_t seq) {
+    put_u32(data + 8, seq);
+    put_u64(data + FRAME_HEADER_SIZE, seq);
+}
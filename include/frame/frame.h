@@ -0,0 +1,103 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/** Trames du protocole Freescord v2
+ *
+ * Le protocole texte historique envoie des lignes "pseudo: message" : il
+ * faut chercher la fin de ligne octet par octet puis couper au premier ':',
+ * ce qui est ambigu dès qu'un message en contient. En v2, chaque message est
+ * une trame préfixée par sa longueur, avec un en-tête de taille fixe :
+ *
+ *   0        4      5           6         7       8      12
+ *   | taille | type | taille pseudo | taille salon | options | seq | pseudo\0 salon\0 texte\0
+ *
+ * Les entiers sont en gros-boutiste, taille compte toute la trame, en-tête
+ * compris. Le pseudo, le salon et le texte sont chacun suivis d'un octet nul :
+ * une trame décodée se lit directement dans le tampon de réception, sans
+ * copie, avec des chaînes C valides.
+ *
+ * Avec l'option FRAME_STAMPED, l'en-tête est suivi de FRAME_STAMP_SIZE
+ * octets : le numéro du message sur 64 bits, dont seq ne garde que les 32
+ * bits de poids faible, et son heure d'envoi par le serveur, en µs depuis
+ * le 1er janvier 1970. Le serveur horodate ainsi tous les messages
+ * diffusés, numérotés dans l'ordre tous salons confondus.
+ *
+ * Reprise de session : une fois le pseudo accepté, le serveur envoie une
+ * trame FRAME_SESSION avec un jeton. Après une coupure, le client propose
+ * son pseudo suivi de ce jeton et du numéro du dernier message reçu
+ * ("pseudo jeton numéro") pour retrouver ses salons et recevoir ce qu'il a
+ * manqué.
+ *
+ * Négociation : le client envoie la ligne PROTO_HELLO avant son pseudo. Le
+ * serveur répond par la ligne PROTO_ACK, après laquelle il n'envoie plus que
+ * des trames ; le client n'envoie plus lui aussi que des trames après
+ * PROTO_HELLO. Un client qui ne l'envoie pas reste en protocole texte.
+ *
+ * Connexion en un aller-retour : le pseudo peut suivre PROTO_HELLO sur la
+ * même ligne ("/proto 2 pseudo"), et le client peut envoyer ses premiers
+ * messages sans attendre. Le serveur répond alors en un seul envoi par
+ * PROTO_ACK et la réponse au pseudo. Les trames FRAME_MSG reçues avant que le
+ * pseudo soit accepté sont ignorées : après un refus, le client propose un
+ * autre pseudo puis renvoie ses messages.
+ *
+ * Toutes les fonctions de cette bibliothèque commencent par le préfixe
+ * "frame_". */
+
+#define PROTO_HELLO "/proto 2"
+#define PROTO_ACK "FREESCORD/2"
+
+#define FRAME_HEADER_SIZE 12
+#define FRAME_STAMP_SIZE 16
+#define FRAME_MAX_SIZE 4096
+
+/* Options d'une trame, octet 7 de l'en-tête */
+#define FRAME_STAMPED 0x01
+
+/* Types de trame */
+enum frame_type {
+    FRAME_NICK = 1,   /* pseudo proposé, ou réponse : status dans seq et
+                         texte "status | explications" */
+    FRAME_MSG = 2,    /* message : pseudo de l'auteur, salon et numéro */
+    FRAME_NOTICE = 3, /* avis du serveur, texte seul */
+    FRAME_SESSION = 4, /* jeton de reprise de session dans le texte, numéro
+                          du message jusqu'auquel le client a tout reçu */
+    FRAME_PRIVATE = 5  /* message privé : pseudo de l'auteur, celui du
+                          destinataire à la place du salon */
+};
+
+/* Trame décodée, ou à encoder : les chaînes pointent dans la trame */
+struct frame {
+    uint8_t type;
+    uint64_t seq;        /* numéro du message, 32 bits sans horodatage */
+    uint64_t time;       /* heure d'envoi en µs, 0 : trame sans horodatage */
+    const char *sender;  /* au plus 255 octets */
+    size_t senderLen;
+    const char *room;    /* au plus 255 octets */
+    size_t roomLen;
+    const char *body;
+    size_t bodyLen;
+};
+
+/** Retourner la taille de la trame encodant f, ou 0 si elle dépasse
+ * FRAME_MAX_SIZE ou si le pseudo ou le salon sont trop longs */
+size_t frame_size(const struct frame *f);
+
+/** Encoder f dans dest, qui doit pouvoir contenir frame_size(f) octets
+ * retourne la taille de la trame, ou 0 si f ne peut pas être encodée */
+size_t frame_encode(const struct frame *f, char *dest);
+
+/** Décoder la trame au début des len octets de data, sans copie : les
+ * chaînes de f pointent dans data
+ * retourne la taille de la trame, 0 si elle n'est pas encore complète, -1
+ * si elle est invalide (le flux ne peut plus être suivi) */
+ssize_t frame_decode(const char *data, size_t len, struct frame *f);
+
+/** Changer le numéro de la trame horodatée encodée dans data, sans la
+ * réencoder */
+void frame_set_seq(char *data, uint64_t seq);
+
+#endif  // FRAME_H
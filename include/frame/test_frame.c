@@ -0,0 +1,89 @@
+#include "frame.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+int main(void)
+{
+	char data[2 * FRAME_MAX_SIZE];
+	struct frame f = {
+		.type = FRAME_MSG, .seq = 0x01020304,
+		.sender = "alice", .senderLen = 5,
+		.room = "#general", .roomLen = 8,
+		.body = "a: b ::", .bodyLen = 7,
+	};
+
+	/* round trip: fields are views into the frame */
+	size_t size = frame_size(&f);
+	assert(size == FRAME_HEADER_SIZE + 6 + 9 + 8);
+	assert(frame_encode(&f, data) == size);
+
+	struct frame g;
+	assert(frame_decode(data, size, &g) == (ssize_t) size);
+	assert(g.type == FRAME_MSG && g.seq == 0x01020304);
+	assert(g.sender == data + FRAME_HEADER_SIZE);
+	assert(strcmp(g.sender, "alice") == 0 && g.senderLen == 5);
+	assert(strcmp(g.room, "#general") == 0 && g.roomLen == 8);
+	assert(strcmp(g.body, "a: b ::") == 0 && g.bodyLen == 7);
+
+	/* incomplete frames wait for more data */
+	for (size_t len = 0; len < size; len++)
+		assert(frame_decode(data, len, &g) == 0);
+
+	/* two frames back to back, empty fields allowed */
+	struct frame n = {.type = FRAME_NOTICE, .body = "", .bodyLen = 0};
+	size_t size2 = frame_encode(&n, data + size);
+	assert(size2 == FRAME_HEADER_SIZE + 3);
+	assert(frame_decode(data + size, size2, &g) == (ssize_t) size2);
+	assert(g.type == FRAME_NOTICE && g.senderLen == 0 && g.bodyLen == 0);
+	assert(strcmp(g.body, "") == 0);
+
+	/* too long */
+	static char big[FRAME_MAX_SIZE];
+	memset(big, 'x', sizeof(big));
+	f.body = big;
+	f.bodyLen = sizeof(big);
+	assert(frame_size(&f) == 0 && frame_encode(&f, data) == 0);
+	f.bodyLen = 3;
+	f.senderLen = 256;
+	assert(frame_size(&f) == 0);
+
+	/* invalid frames are rejected */
+	frame_encode(&n, data);
+	data[size2 - 1] = 'x';
+	assert(frame_decode(data, size2, &g) == -1);
+	frame_encode(&n, data);
+	data[3] = FRAME_HEADER_SIZE;
+	assert(frame_decode(data, size2, &g) == -1);
+	data[0] = 0x7f;
+	assert(frame_decode(data, FRAME_HEADER_SIZE, &g) == -1);
+
+	/* stamped frames carry a 64-bit number and the server time */
+	struct frame st = {
+		.type = FRAME_MSG, .seq = 0x100000002ULL, .time = 1700000000123456ULL,
+		.sender = "bob", .senderLen = 3,
+		.room = "#dev", .roomLen = 4,
+		.body = "hi", .bodyLen = 2,
+	};
+	size_t size3 = frame_encode(&st, data);
+	assert(size3 == FRAME_HEADER_SIZE + FRAME_STAMP_SIZE + 4 + 5 + 3);
+	assert(frame_decode(data, size3, &g) == (ssize_t) size3);
+	assert(g.seq == 0x100000002ULL && g.time == 1700000000123456ULL);
+	assert(strcmp(g.sender, "bob") == 0 && strcmp(g.body, "hi") == 0);
+	for (size_t len = 0; len < size3; len++)
+		assert(frame_decode(data, len, &g) == 0);
+
+	/* the number of an encoded frame can be set in place */
+	frame_set_seq(data, 42);
+	assert(frame_decode(data, size3, &g) == (ssize_t) size3);
+	assert(g.seq == 42 && g.time == 1700000000123456ULL);
+
+	/* unstamped frames keep a 32-bit number and no time */
+	frame_encode(&n, data);
+	assert(frame_decode(data, size2, &g) == (ssize_t) size2);
+	assert(g.time == 0);
+
+	printf("frames: ok\n");
+
+	return 0;
+}
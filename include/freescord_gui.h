@@ -16,11 +16,18 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "buffer/buffer.h"
+#include "frame/frame.h"
+#include "slab/slab.h"
+
 // Constantes
 #define MAX_USERNAME_LENGTH 32
 #define BUFFER_SIZE 1024
 #define DEFAULT_SERVER "127.0.0.1"
 #define DEFAULT_PORT 4321
+#define MESSAGE_DATA_SIZE 512  // message et ses textes, pris dans la réserve
+#define TOKEN_SIZE 64          // jeton de session reçu du serveur
+#define RECONNECT_TRIES 5      // tentatives de reprise après une coupure
 
 // Structure pour les données d'un message à traiter dans le thread principal
 typedef struct {
@@ -29,6 +36,8 @@ typedef struct {
     char *username;
     char *message;
     gboolean is_me;
+    gboolean pooled;  // pris dans la réserve, sinon alloué par malloc
+    char text[];      // les trois textes, à la suite
 } MessageData;
 
 // Structure principale de l'application
@@ -56,6 +65,12 @@ typedef struct {
 
     // Informations utilisateur
     char username[MAX_USERNAME_LENGTH];
+
+    // Session, reprise après une coupure sur server:port
+    char server[BUFFER_SIZE];
+    int port;
+    char session_token[TOKEN_SIZE];
+    uint64_t last_seq;  // dernier message reçu
 } FreescordApp;
 
 // Fonctions d'initialisation
@@ -74,7 +89,8 @@ void on_window_destroy(GtkWidget *widget, FreescordApp *app);
 int connect_to_server(const char *server, int port);
 void send_message(FreescordApp *app, const char *message);
 void *receive_messages(void *data);
-void process_incoming_message(FreescordApp *app, const char *buffer);
+void process_incoming_frame(FreescordApp *app, const struct frame *f);
+int resume_session(FreescordApp *app, Buffer **socketBuf);
 void disconnect_from_server(FreescordApp *app);
 
 // Fonctions d'affichage
@@ -0,0 +1,60 @@
+#ifndef HANDSHAKE_H
+#define HANDSHAKE_H
+
+#include <stddef.h>
+
+#include "user.h"
+
+/** Accueil non bloquant des clients
+ *
+ * Entre l'acceptation de sa connexion et l'acceptation de son pseudo, un
+ * client n'a ni thread ni place dans les ensembles de diffusion : la boucle
+ * d'événements qui surveille sa socket fait avancer son accueil à chaque
+ * lecture possible (négociation du protocole puis propositions de pseudo),
+ * sans jamais bloquer. Il ne coûte que sa struct user et un petit tampon
+ * de réception (HANDSHAKE_BUFFER_SIZE).
+ *
+ * Chaque client doit avoir choisi son pseudo avant une échéance, fixée à
+ * son arrivée (config.handshakeTimeout). Les clients en attente d'une
+ * boucle forment une file dans l'ordre d'arrivée, qui est donc aussi
+ * l'ordre de leurs échéances : seul le premier est à surveiller.
+ *
+ * Toutes les fonctions commencent par le préfixe "handshake_". Une file
+ * n'est pas protégée : seul le thread de sa boucle la manipule. */
+
+struct handshake_queue {
+    struct user *first; /* échéance la plus proche */
+    struct user *last;
+    size_t count;
+};
+
+/** Envoyer l'accueil à u, qui vient d'être accepté, et le mettre en file */
+void handshake_start(struct handshake_queue *q, struct user *u);
+
+/** Lire une fois la socket de u et traiter ce qui est arrivé. Une fois son
+ * pseudo accepté, u quitte la file, reçoit son jeton de session, rejoint
+ * les connectés et le salon par défaut, ou les salons de la session qu'il
+ * reprend (voir session.h) ; les commandes déjà reçues restent dans son
+ * tampon
+ * retourne 1 si u est connecté, 0 s'il faut attendre la suite, -1 si u a
+ * quitté la file et doit être libéré (déconnexion ou flux invalide) */
+int handshake_read(struct handshake_queue *q, struct user *u);
+
+/** Traiter les commandes déjà dans le tampon de u, reçues sans passer par
+ * handshake_read (io_uring), comme handshake_read après sa lecture
+ * retourne 1 si u est connecté, 0 s'il faut attendre la suite, -1 si u a
+ * quitté la file et doit être libéré (flux invalide) */
+int handshake_process(struct handshake_queue *q, struct user *u);
+
+/** Retirer u de la file */
+void handshake_remove(struct handshake_queue *q, struct user *u);
+
+/** Retirer de la file et retourner un client dont l'échéance est passée, à
+ * libérer, ou NULL s'il n'y en a pas */
+struct user *handshake_expired(struct handshake_queue *q);
+
+/** Retourner le plus court de timeoutUs (-1 pour aucun délai) et du temps
+ * restant avant la prochaine échéance, en microsecondes */
+long handshake_timeout(struct handshake_queue *q, long timeoutUs);
+
+#endif  // HANDSHAKE_H
@@ -0,0 +1,52 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "journal/journal.h"
+#include "payload.h"
+#include "room.h"
+#include "user.h"
+
+#define HISTORY_DEFAULT 20        /* messages de /history sans argument */
+#define HISTORY_MAX 500           /* messages au plus par réponse */
+#define HISTORY_SCAN_MAX (1 << 20) /* messages du journal parcourus au plus */
+
+/** Historique ancien d'un salon, lu dans le journal
+ *
+ * "/history [n|since <seq>]" répond avec les n derniers messages du salon
+ * courant, ou ceux qui suivent le message seq du journal, au-delà de ce que
+ * garde l'historique en mémoire (voir scrollback.h). Le journal est lu à
+ * travers ses segments projetés en mémoire (voir journal/journal.h) : les
+ * trames gardées sont reprises telles quelles, sans relecture par read().
+ *
+ * La réponse est un seul message sous ses deux formes, les lignes de texte
+ * d'un côté et les trames de l'autre (voir proto.h), terminé par un avis
+ * donnant le numéro du dernier message pour continuer avec "since". Elle
+ * passe par la file d'envoi du demandeur comme tout avis, dans l'ordre des
+ * messages en direct.
+ *
+ * Les messages encore en attente de l'écrivain du journal, au plus ceux des
+ * dernières millisecondes, ne sont pas lus. */
+
+/** Répondre à la commande "/history ..." text de u, lue dans journal (NULL
+ * si le serveur n'en tient pas)
+ * retourne la réponse, avec une référence pour l'appelant, ou NULL en cas
+ * d'erreur */
+struct payload *history_command(Journal *journal, struct user *u,
+                                const char *text);
+
+/** Relire dans journal (NULL si le serveur n'en tient pas) les messages de
+ * room numérotés de after + 1 à upTo, au plus HISTORY_MAX, manqués par un
+ * client qui reprend sa session et déjà relâchés par l'historique en
+ * mémoire. Seuls les messages déjà écrits sont lus, sans attendre
+ * l'écrivain. Un avis indique la suite si la réponse est tronquée, faute de
+ * place ou parce que l'écrivain n'a pas encore tout écrit, ou que ces
+ * messages sont perdus sans journal
+ * retourne la réponse, avec une référence pour l'appelant, ou NULL s'il n'y
+ * a rien à envoyer ou en cas d'erreur */
+struct payload *history_range(Journal *journal, const struct room *room,
+                              uint64_t after, uint64_t upTo);
+
+#endif  // HISTORY_H
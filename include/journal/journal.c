@@ -0,0 +1,723 @@
+#include "journal.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Couple (numéro, position) d'une entrée d'index */
+#define INDEX_ENTRY_SIZE 16
+
+/* Entrées d'index gardées avant d'être écrites */
+#define INDEX_BATCH 64
+
+/* Intervalle des contrôles de l'âge des segments, en µs */
+#define RETENTION_CHECK 1000000
+
+#define FNV_BASIS 2166136261u
+
+struct segment {
+    uint64_t first; /* numéro de son premier message */
+    uint64_t bytes;
+    time_t last;    /* heure de sa dernière écriture */
+};
+
+struct journal {
+    char *dir;
+    int dirFD;
+    struct journal_options opts;
+
+    // Ajouts en attente, partagés avec l'écrivain
+    pthread_mutex_t mutex;
+    pthread_cond_t wakeWriter;
+    pthread_cond_t done; /* écriture ou synchronisation terminée */
+    char *pending;
+    size_t pendingLen;
+    size_t pendingSize;
+    uint64_t lastSeq;    /* numéro du dernier message ajouté */
+    uint64_t writtenSeq; /* dernier message écrit */
+    uint64_t durableSeq; /* dernier message synchronisé */
+    int syncWanted;      /* journal_sync attend la synchronisation */
+    int closing;
+    int failed;          /* une écriture ou synchronisation a échoué */
+    uint64_t appended;
+    uint64_t dropped;
+    uint64_t syncs;
+
+    // Réservé à l'écrivain
+    pthread_t writer;
+    char *batch;
+    size_t batchSize;
+    int segFD;
+    int idxFD;
+    uint64_t segBytes;  /* taille du segment en cours */
+    uint64_t nextIndex; /* position de sa prochaine entrée d'index */
+
+    // Segments du plus ancien au plus récent, partagés avec les lecteurs
+    pthread_mutex_t mutexSegments;
+    struct segment *segments;
+    size_t nbSegments;
+    size_t segmentsSize;
+    uint64_t totalBytes;
+};
+
+/*================== Encodage ==================*/
+static void put_u32(char *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static uint32_t get_u32(const char *p) {
+    const unsigned char *u = (const unsigned char *)p;
+    return (uint32_t)u[0] << 24 | (uint32_t)u[1] << 16 | (uint32_t)u[2] << 8 |
+           u[3];
+}
+
+static void put_u64(char *p, uint64_t v) {
+    put_u32(p, v >> 32);
+    put_u32(p + 4, v);
+}
+
+static uint64_t get_u64(const char *p) {
+    return (uint64_t)get_u32(p) << 32 | get_u32(p + 4);
+}
+
+/* FNV-1a, à poursuivre depuis h */
+static uint32_t fnv1a(uint32_t h, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char)data[i]) * 16777619u;
+    return h;
+}
+
+/* Contrôle de l'enregistrement rec : ses données puis le reste de son
+ * en-tête, pour hacher les données avant de connaître le numéro */
+static uint32_t record_check(uint32_t dataHash, const char *rec) {
+    uint32_t h = fnv1a(dataHash, rec, 4);
+    return fnv1a(h, rec + 8, JOURNAL_HEADER_SIZE - 8);
+}
+
+/* Vérifie l'enregistrement au début des avail octets de rec
+ * retourne 1 et sa taille de données dans *len s'il est complet et intact */
+static int record_valid(const char *rec, size_t avail, size_t *len) {
+    if (avail < JOURNAL_HEADER_SIZE) return 0;
+
+    *len = get_u32(rec);
+    if (*len > JOURNAL_RECORD_MAX || *len > avail - JOURNAL_HEADER_SIZE)
+        return 0;
+
+    uint32_t dataHash = fnv1a(FNV_BASIS, rec + JOURNAL_HEADER_SIZE, *len);
+    return get_u32(rec + 4) == record_check(dataHash, rec);
+}
+
+static uint64_t clock_us(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*================== Segments ==================*/
+static void segment_path(const Journal *j, char *path, uint64_t first,
+                         const char *ext) {
+    snprintf(path, PATH_MAX, "%s/%020" PRIu64 ".%s", j->dir, first, ext);
+}
+
+/* Ajoute un segment en fin de liste, verrou des segments pris */
+static int segments_push(Journal *j, uint64_t first, uint64_t bytes,
+                         time_t last) {
+    if (j->nbSegments == j->segmentsSize) {
+        size_t newSize = j->segmentsSize ? 2 * j->segmentsSize : 16;
+        struct segment *segments =
+            realloc(j->segments, newSize * sizeof(*segments));
+        if (!segments) return -1;
+        j->segments = segments;
+        j->segmentsSize = newSize;
+    }
+
+    j->segments[j->nbSegments++] = (struct segment){first, bytes, last};
+    j->totalBytes += bytes;
+    return 0;
+}
+
+static int compare_segments(const void *a, const void *b) {
+    uint64_t x = ((const struct segment *)a)->first;
+    uint64_t y = ((const struct segment *)b)->first;
+    return (x > y) - (x < y);
+}
+
+/* Liste les segments du dossier, triés par premier numéro */
+static int load_segments(Journal *j) {
+    DIR *d = opendir(j->dir);
+    if (!d) return -1;
+
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        char *end;
+        uint64_t first = strtoull(ent->d_name, &end, 10);
+        if (end != ent->d_name + 20 || strcmp(end, ".log") != 0) continue;
+
+        char path[PATH_MAX];
+        struct stat st;
+        segment_path(j, path, first, "log");
+        if (stat(path, &st) < 0 ||
+            segments_push(j, first, st.st_size, st.st_mtime) < 0) {
+            closedir(d);
+            return -1;
+        }
+    }
+    closedir(d);
+
+    qsort(j->segments, j->nbSegments, sizeof(*j->segments), compare_segments);
+    return 0;
+}
+
+/* Ajoute à entries l'entrée d'index du message seq écrit à la position off
+ * du segment en cours, s'il en faut une
+ * retourne le nouveau nombre d'entrées */
+static size_t index_add(Journal *j, char *entries, size_t count, uint64_t seq,
+                        uint64_t off) {
+    if (off < j->nextIndex) return count;
+
+    put_u64(entries + count * INDEX_ENTRY_SIZE, seq);
+    put_u64(entries + count * INDEX_ENTRY_SIZE + 8, off);
+    j->nextIndex = off + JOURNAL_INDEX_INTERVAL;
+    return count + 1;
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written < 0 && errno == EINTR) continue;
+        if (written < 0) return -1;
+        data += written;
+        len -= written;
+    }
+    return 0;
+}
+
+/* Reprend le dernier segment : sa fin coupée est retirée et son index
+ * reconstruit, puis il est rouvert pour la suite */
+static int recover(Journal *j) {
+    if (j->nbSegments == 0) return 0;
+
+    struct segment *s = &j->segments[j->nbSegments - 1];
+    char path[PATH_MAX];
+    segment_path(j, path, s->first, "log");
+    j->segFD = open(path, O_RDWR | O_APPEND);
+    segment_path(j, path, s->first, "idx");
+    j->idxFD = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (j->segFD < 0 || j->idxFD < 0) return -1;
+
+    char *map = NULL;
+    if (s->bytes > 0) {
+        map = mmap(NULL, s->bytes, PROT_READ, MAP_SHARED, j->segFD, 0);
+        if (map == MAP_FAILED) return -1;
+    }
+
+    // Les enregistrements intacts se suivent depuis le début du segment
+    char entries[INDEX_BATCH * INDEX_ENTRY_SIZE];
+    size_t nbEntries = 0, off = 0, len;
+    j->lastSeq = s->first - 1;
+    while (map && record_valid(map + off, s->bytes - off, &len)) {
+        j->lastSeq = get_u64(map + off + 8);
+        nbEntries = index_add(j, entries, nbEntries, j->lastSeq, off);
+        if (nbEntries == INDEX_BATCH) {
+            if (write_all(j->idxFD, entries, sizeof(entries)) < 0) break;
+            nbEntries = 0;
+        }
+        off += JOURNAL_HEADER_SIZE + len;
+    }
+    if (map) munmap(map, s->bytes);
+
+    if (write_all(j->idxFD, entries, nbEntries * INDEX_ENTRY_SIZE) < 0 ||
+        (off < s->bytes && ftruncate(j->segFD, off) < 0))
+        return -1;
+
+    j->totalBytes -= s->bytes - off;
+    s->bytes = off;
+    j->segBytes = off;
+    j->writtenSeq = j->durableSeq = j->lastSeq;
+    return 0;
+}
+
+/* Termine le segment en cours et en commence un dont le premier message
+ * sera first */
+static int roll_segment(Journal *j, uint64_t first) {
+    if (j->segFD >= 0) {
+        if (j->opts.syncInterval >= 0 && fdatasync(j->segFD) < 0) return -1;
+        close(j->segFD);
+        close(j->idxFD);
+    }
+
+    char path[PATH_MAX];
+    segment_path(j, path, first, "log");
+    j->segFD = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    segment_path(j, path, first, "idx");
+    j->idxFD = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (j->segFD < 0 || j->idxFD < 0) return -1;
+
+    // Le nouveau fichier doit survivre à un arrêt brutal lui aussi
+    if (j->opts.syncInterval >= 0) fsync(j->dirFD);
+
+    j->segBytes = 0;
+    j->nextIndex = 0;
+
+    pthread_mutex_lock(&j->mutexSegments);
+    int pushRes = segments_push(j, first, 0, time(NULL));
+    pthread_mutex_unlock(&j->mutexSegments);
+    return pushRes;
+}
+
+/* Enregistre la taille du segment en cours, qui grandit de added octets */
+static void segment_grow(Journal *j, uint64_t added) {
+    pthread_mutex_lock(&j->mutexSegments);
+    struct segment *s = &j->segments[j->nbSegments - 1];
+    s->bytes += added;
+    s->last = time(NULL);
+    j->totalBytes += added;
+    pthread_mutex_unlock(&j->mutexSegments);
+}
+
+/* Écrit les enregistrements de batch, en changeant de segment au besoin :
+ * un appel par segment, plus un pour ses entrées d'index
+ * retourne 1 si un segment a été commencé, 0 sinon, -1 en cas d'erreur */
+static int write_batch(Journal *j, const char *batch, size_t len) {
+    char entries[INDEX_BATCH * INDEX_ENTRY_SIZE];
+    size_t nbEntries = 0, run = 0, off = 0;
+    int rolled = 0;
+
+    while (off < len) {
+        size_t recLen = JOURNAL_HEADER_SIZE + get_u32(batch + off);
+        uint64_t seq = get_u64(batch + off + 8);
+
+        // Index plein, ou segment plein : ce qui précède part d'abord
+        int full = j->segFD < 0 ||
+                   (j->segBytes > 0 &&
+                    j->segBytes + recLen > j->opts.segmentSize);
+        if (full || nbEntries == INDEX_BATCH) {
+            if (j->segFD >= 0 &&
+                (write_all(j->segFD, batch + run, off - run) < 0 ||
+                 write_all(j->idxFD, entries,
+                           nbEntries * INDEX_ENTRY_SIZE) < 0))
+                return -1;
+            if (j->segFD >= 0) segment_grow(j, off - run);
+            nbEntries = 0;
+            run = off;
+        }
+        if (full) {
+            if (roll_segment(j, seq) < 0) return -1;
+            rolled = 1;
+        }
+
+        nbEntries = index_add(j, entries, nbEntries, seq, j->segBytes);
+        j->segBytes += recLen;
+        off += recLen;
+    }
+
+    if (write_all(j->segFD, batch + run, off - run) < 0 ||
+        write_all(j->idxFD, entries, nbEntries * INDEX_ENTRY_SIZE) < 0)
+        return -1;
+    segment_grow(j, off - run);
+    return rolled;
+}
+
+/* Supprime les plus anciens segments au-delà de la taille ou de l'âge
+ * maximal, en gardant toujours le segment en cours */
+static void enforce_retention(Journal *j) {
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&j->mutexSegments);
+    while (j->nbSegments > 1) {
+        struct segment *s = &j->segments[0];
+        int tooBig = j->opts.maxBytes && j->totalBytes > j->opts.maxBytes;
+        int tooOld = j->opts.maxAge && now - s->last > j->opts.maxAge;
+        if (!tooBig && !tooOld) break;
+
+        // Un lecteur qui a déjà ouvert le segment le lit jusqu'au bout
+        char path[PATH_MAX];
+        segment_path(j, path, s->first, "log");
+        unlink(path);
+        segment_path(j, path, s->first, "idx");
+        unlink(path);
+
+        j->totalBytes -= s->bytes;
+        j->nbSegments--;
+        memmove(j->segments, j->segments + 1,
+                j->nbSegments * sizeof(*j->segments));
+    }
+    pthread_mutex_unlock(&j->mutexSegments);
+}
+
+/*================== Écrivain ==================*/
+/* Attend des ajouts, une demande de synchronisation ou l'échéance du
+ * fdatasync groupé (dirty : des écritures attendent d'être synchronisées),
+ * verrou pris */
+static void writer_wait(Journal *j, int dirty, uint64_t lastSync) {
+    while (!j->pendingLen && !j->closing && !(dirty && j->syncWanted)) {
+        // Sans échéance, seul le contrôle de l'âge réveille l'écrivain
+        uint64_t deadline = 0;
+        if (dirty) deadline = lastSync + j->opts.syncInterval;
+        if (j->opts.maxAge) {
+            uint64_t check = clock_us(CLOCK_MONOTONIC) + RETENTION_CHECK;
+            if (!deadline || check < deadline) deadline = check;
+        }
+        if (!deadline) {
+            pthread_cond_wait(&j->wakeWriter, &j->mutex);
+            continue;
+        }
+
+        struct timespec ts = {deadline / 1000000, deadline % 1000000 * 1000};
+        if (pthread_cond_timedwait(&j->wakeWriter, &j->mutex, &ts) == ETIMEDOUT)
+            return;
+    }
+}
+
+static void *writer_run(void *journal) {
+    Journal *j = journal;
+    long interval = j->opts.syncInterval;
+    uint64_t lastSync = clock_us(CLOCK_MONOTONIC);
+    uint64_t lastRetention = 0;
+    int dirty = 0;
+
+    pthread_mutex_lock(&j->mutex);
+    while (1) {
+        writer_wait(j, dirty, lastSync);
+
+        // Tout ce qui s'est accumulé part d'un coup, les ajouts continuent
+        // dans l'autre tampon
+        char *batch = j->pending;
+        size_t len = j->pendingLen, size = j->pendingSize;
+        uint64_t last = j->lastSeq;
+        j->pending = j->batch;
+        j->pendingSize = j->batchSize;
+        j->pendingLen = 0;
+        j->batch = batch;
+        j->batchSize = size;
+        int forced = j->closing || j->syncWanted;
+        j->syncWanted = 0;
+        pthread_mutex_unlock(&j->mutex);
+
+        int failed = 0, rolled = 0;
+        if (len > 0) {
+            rolled = write_batch(j, batch, len);
+            failed = rolled < 0;
+            dirty = 1;
+
+            // Lisible dès maintenant, sans attendre le fdatasync
+            pthread_mutex_lock(&j->mutex);
+            if (failed) j->failed = 1;
+            __atomic_store_n(&j->writtenSeq, last, __ATOMIC_RELEASE);
+            pthread_cond_broadcast(&j->done);
+            pthread_mutex_unlock(&j->mutex);
+        }
+
+        // Un seul fdatasync pour tout ce qui a été écrit depuis le dernier
+        uint64_t now = clock_us(CLOCK_MONOTONIC);
+        int synced = 0;
+        if (dirty && (interval <= 0 || forced || now - lastSync >= interval)) {
+            if (interval >= 0 && j->segFD >= 0 && fdatasync(j->segFD) < 0)
+                failed = 1;
+            lastSync = now;
+            dirty = 0;
+            synced = 1;
+        }
+
+        if (rolled > 0 || now - lastRetention >= RETENTION_CHECK) {
+            enforce_retention(j);
+            lastRetention = now;
+        }
+
+        pthread_mutex_lock(&j->mutex);
+        if (failed) j->failed = 1;
+        if (synced) {
+            j->durableSeq = j->writtenSeq;
+            if (interval >= 0) j->syncs++;
+        }
+        pthread_cond_broadcast(&j->done);
+
+        if (j->closing && !j->pendingLen && !dirty) break;
+    }
+    pthread_mutex_unlock(&j->mutex);
+
+    return NULL;
+}
+
+/*================== Journal ==================*/
+static void journal_free(Journal *j) {
+    if (j->segFD >= 0) close(j->segFD);
+    if (j->idxFD >= 0) close(j->idxFD);
+    if (j->dirFD >= 0) close(j->dirFD);
+    free(j->segments);
+    free(j->pending);
+    free(j->batch);
+    free(j->dir);
+    free(j);
+}
+
+Journal *journal_open(const char *dir, const struct journal_options *opts) {
+    Journal *j = calloc(1, sizeof(*j));
+    if (!j) return NULL;
+
+    j->segFD = j->idxFD = -1;
+    if (opts) j->opts = *opts;
+    if (j->opts.segmentSize == 0) j->opts.segmentSize = JOURNAL_SEGMENT_SIZE;
+
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        free(j);
+        return NULL;
+    }
+    j->dir = strdup(dir);
+    j->dirFD = open(dir, O_RDONLY | O_DIRECTORY);
+    if (!j->dir || j->dirFD < 0 || load_segments(j) < 0 || recover(j) < 0) {
+        journal_free(j);
+        return NULL;
+    }
+
+    // Les échéances de l'écrivain suivent l'horloge monotone
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&j->wakeWriter, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&j->done, NULL);
+    pthread_mutex_init(&j->mutex, NULL);
+    pthread_mutex_init(&j->mutexSegments, NULL);
+
+    // Les signaux sont laissés aux autres threads : un gestionnaire qui
+    // attend l'écrivain ne doit pas s'exécuter dans l'écrivain
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int createRes = pthread_create(&j->writer, NULL, writer_run, j);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (createRes != 0) {
+        journal_free(j);
+        return NULL;
+    }
+    return j;
+}
+
+void journal_close(Journal *j) {
+    if (!j) return;
+
+    pthread_mutex_lock(&j->mutex);
+    j->closing = 1;
+    pthread_cond_signal(&j->wakeWriter);
+    pthread_mutex_unlock(&j->mutex);
+    pthread_join(j->writer, NULL);
+
+    pthread_cond_destroy(&j->wakeWriter);
+    pthread_cond_destroy(&j->done);
+    pthread_mutex_destroy(&j->mutex);
+    pthread_mutex_destroy(&j->mutexSegments);
+    journal_free(j);
+}
+
+int journal_append(Journal *j, uint64_t seq, const void *data, size_t len) {
+    size_t recLen = JOURNAL_HEADER_SIZE + len;
+    uint32_t dataHash = fnv1a(FNV_BASIS, data, len);
+
+    pthread_mutex_lock(&j->mutex);
+
+    // Hors d'ordre, trop gros, ou écrivain trop en retard : refusé plutôt
+    // qu'attendre
+    if (seq <= j->lastSeq || len > JOURNAL_RECORD_MAX ||
+        j->pendingLen + recLen > JOURNAL_QUEUE_MAX) {
+        j->dropped++;
+        pthread_mutex_unlock(&j->mutex);
+        return -1;
+    }
+    if (j->pendingLen + recLen > j->pendingSize) {
+        size_t newSize = j->pendingSize ? 2 * j->pendingSize : 64 * 1024;
+        while (newSize < j->pendingLen + recLen) newSize *= 2;
+        char *pending = realloc(j->pending, newSize);
+        if (!pending) {
+            j->dropped++;
+            pthread_mutex_unlock(&j->mutex);
+            return -1;
+        }
+        j->pending = pending;
+        j->pendingSize = newSize;
+    }
+
+    j->lastSeq = seq;
+    char *rec = j->pending + j->pendingLen;
+    put_u32(rec, len);
+    put_u64(rec + 8, seq);
+    put_u64(rec + 16, clock_us(CLOCK_REALTIME));
+    put_u32(rec + 4, record_check(dataHash, rec));
+    memcpy(rec + JOURNAL_HEADER_SIZE, data, len);
+    j->pendingLen += recLen;
+    j->appended++;
+
+    // L'écrivain ne dort que si rien n'attend
+    if (j->pendingLen == recLen) pthread_cond_signal(&j->wakeWriter);
+
+    pthread_mutex_unlock(&j->mutex);
+    return 0;
+}
+
+int journal_sync(Journal *j) {
+    pthread_mutex_lock(&j->mutex);
+
+    uint64_t target = j->lastSeq;
+    while (j->durableSeq < target && !j->failed) {
+        j->syncWanted = 1;
+        pthread_cond_signal(&j->wakeWriter);
+        pthread_cond_wait(&j->done, &j->mutex);
+    }
+    int res = j->failed ? -1 : 0;
+
+    pthread_mutex_unlock(&j->mutex);
+    return res;
+}
+
+int journal_flush(Journal *j) {
+    pthread_mutex_lock(&j->mutex);
+
+    // L'écrivain, réveillé par les ajouts, n'attend pas l'intervalle pour
+    // écrire
+    uint64_t target = j->lastSeq;
+    while (j->writtenSeq < target && !j->failed)
+        pthread_cond_wait(&j->done, &j->mutex);
+    int res = j->failed ? -1 : 0;
+
+    pthread_mutex_unlock(&j->mutex);
+    return res;
+}
+
+uint64_t journal_written_seq(Journal *j) {
+    return __atomic_load_n(&j->writtenSeq, __ATOMIC_ACQUIRE);
+}
+
+uint64_t journal_last_seq(Journal *j) {
+    pthread_mutex_lock(&j->mutex);
+    uint64_t seq = j->lastSeq;
+    pthread_mutex_unlock(&j->mutex);
+    return seq;
+}
+
+/*================== Lecture ==================*/
+/* Position dans le segment first, projeté en map sur size octets, de la
+ * dernière entrée d'index avant le message from, par dichotomie dans
+ * l'index projeté lui aussi. L'entrée trouvée doit désigner un
+ * enregistrement intact de ce numéro : sinon (index coupé ou abîmé), la
+ * lecture part du début du segment */
+static size_t index_lookup(Journal *j, uint64_t first, uint64_t from,
+                           const char *map, size_t size) {
+    char path[PATH_MAX];
+    segment_path(j, path, first, "idx");
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    char *entries = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= INDEX_ENTRY_SIZE)
+        entries = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (entries == MAP_FAILED) return 0;
+
+    // Dernière entrée de numéro au plus from
+    size_t lo = 0, hi = st.st_size / INDEX_ENTRY_SIZE;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (get_u64(entries + mid * INDEX_ENTRY_SIZE) <= from)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    uint64_t seq = get_u64(entries + lo * INDEX_ENTRY_SIZE);
+    uint64_t off = get_u64(entries + lo * INDEX_ENTRY_SIZE + 8);
+    munmap(entries, st.st_size);
+
+    size_t len;
+    if (seq > from || off >= size ||
+        !record_valid(map + off, size - off, &len) ||
+        get_u64(map + off + 8) != seq)
+        return 0;
+    return off;
+}
+
+/* Lit le segment first à partir du message from */
+static int read_segment(Journal *j, uint64_t first, uint64_t from,
+                        int (*fn)(const struct journal_entry *e, void *arg),
+                        void *arg) {
+    char path[PATH_MAX];
+    segment_path(j, path, first, "log");
+
+    // Supprimé depuis par la rétention : il n'y a plus rien à y lire
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return errno == ENOENT ? 0 : -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    size_t size = st.st_size;
+    char *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+
+    // Un enregistrement en cours d'écriture arrête la lecture
+    size_t off = from > first ? index_lookup(j, first, from, map, size) : 0;
+    size_t len;
+    int res = 0;
+    while (res == 0 && record_valid(map + off, size - off, &len)) {
+        struct journal_entry e = {get_u64(map + off + 8),
+                                  get_u64(map + off + 16),
+                                  map + off + JOURNAL_HEADER_SIZE, len};
+        if (e.seq >= from) res = fn(&e, arg);
+        off += JOURNAL_HEADER_SIZE + len;
+    }
+
+    munmap(map, size);
+    return res;
+}
+
+int journal_read(Journal *j, uint64_t from,
+                 int (*fn)(const struct journal_entry *e, void *arg),
+                 void *arg) {
+    // Liste copiée : l'écrivain peut ajouter ou supprimer des segments
+    // pendant la lecture
+    pthread_mutex_lock(&j->mutexSegments);
+    size_t nb = j->nbSegments;
+    uint64_t *firsts = malloc((nb ? nb : 1) * sizeof(*firsts));
+    for (size_t i = 0; firsts && i < nb; i++) firsts[i] = j->segments[i].first;
+    pthread_mutex_unlock(&j->mutexSegments);
+    if (!firsts) return -1;
+
+    size_t start = 0;
+    while (start + 1 < nb && firsts[start + 1] <= from) start++;
+
+    int res = 0;
+    for (size_t i = start; i < nb && res == 0; i++)
+        res = read_segment(j, firsts[i], from, fn, arg);
+
+    free(firsts);
+    return res;
+}
+
+void journal_print(Journal *j, FILE *out) {
+    pthread_mutex_lock(&j->mutex);
+    fprintf(out, "journal_appended %" PRIu64 "\n", j->appended);
+    fprintf(out, "journal_dropped %" PRIu64 "\n", j->dropped);
+    fprintf(out, "journal_syncs %" PRIu64 "\n", j->syncs);
+    pthread_mutex_unlock(&j->mutex);
+
+    pthread_mutex_lock(&j->mutexSegments);
+    fprintf(out, "journal_segments %zu\n", j->nbSegments);
+    fprintf(out, "journal_bytes %" PRIu64 "\n", j->totalBytes);
+    pthread_mutex_unlock(&j->mutexSegments);
+}
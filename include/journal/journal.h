@@ -0,0 +1,143 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** Journal de messages sur disque, en ajout seul
+ *
+ * Journal est un type opaque représentant un dossier de segments : des
+ * fichiers où les messages sont ajoutés les uns à la suite des autres, sans
+ * jamais être réécrits. Chaque message reçoit un numéro, qui continue de
+ * croître d'un démarrage à l'autre, et l'heure de son ajout. Sur disque,
+ * chaque enregistrement est précédé d'un en-tête de taille fixe :
+ *
+ *   0        4          8     16          24
+ *   | taille | contrôle | seq | heure (µs) | données
+ *
+ * Les entiers sont en gros-boutiste ; taille compte les données seules, et
+ * le contrôle (FNV-1a) couvre le reste de l'en-tête et les données : au
+ * redémarrage, un enregistrement coupé par un arrêt brutal est retiré de la
+ * fin du dernier segment.
+ *
+ * Un segment est nommé par le numéro de son premier message
+ * (00000000000000000001.log) et accompagné d'un index clairsemé (.idx) :
+ * un couple (numéro, position) tous les JOURNAL_INDEX_INTERVAL octets, pour
+ * commencer une lecture près du message voulu sans parcourir le segment.
+ *
+ * Toutes les fonctions de cette bibliothèque commencent par le préfixe
+ * "journal_". À part journal_open, elles prennent toutes un pointeur vers un
+ * journal en premier argument.
+ *
+ * Les messages sont numérotés par l'appelant, dans l'ordre croissant mais
+ * pas forcément sans trou : le numéro peut ainsi figurer dans les données
+ * elles-mêmes. Un message dont le numéro ne dépasse pas celui du dernier
+ * ajouté est refusé.
+ *
+ * Écriture groupée : journal_append ne fait que copier le message en
+ * mémoire, sans appel système ni attente du disque. Un thread écrivain
+ * dédié écrit en un seul appel tout ce qui s'est accumulé, et ne force le
+ * passage sur disque (fdatasync) qu'une fois par intervalle : tous les
+ * messages ajoutés pendant l'intervalle partagent le même fdatasync. Si
+ * l'écrivain prend trop de retard (JOURNAL_QUEUE_MAX octets en attente),
+ * les ajouts sont refusés plutôt que d'attendre.
+ *
+ * Rétention : les plus anciens segments sont supprimés quand le journal
+ * dépasse sa taille maximale, ou quand leur dernier message dépasse l'âge
+ * maximal. Le segment en cours d'écriture est toujours gardé.
+ *
+ *   struct journal_options opts = {.syncInterval = 10000};
+ *   Journal *j = journal_open("logs", &opts);
+ *   journal_append(j, seq, data, len);
+ *   ...
+ *   journal_read(j, seq, afficher, NULL);
+ *   journal_close(j);
+ */
+
+typedef struct journal Journal;
+
+/* Taille au-delà de laquelle un nouveau segment est commencé */
+#define JOURNAL_SEGMENT_SIZE (64 * 1024 * 1024)
+
+/* Octets de segment entre deux entrées de son index */
+#define JOURNAL_INDEX_INTERVAL 4096
+
+/* Taille de l'en-tête d'un enregistrement */
+#define JOURNAL_HEADER_SIZE 24
+
+/* Plus gros message accepté */
+#define JOURNAL_RECORD_MAX (64 * 1024)
+
+/* Octets en attente de l'écrivain au-delà desquels les ajouts sont refusés */
+#define JOURNAL_QUEUE_MAX (64 * 1024 * 1024)
+
+/* Réglages d'un journal, à 0 pour les valeurs par défaut */
+struct journal_options {
+    size_t segmentSize; /* taille d'un segment (JOURNAL_SEGMENT_SIZE) */
+    long syncInterval;  /* µs entre deux fdatasync, 0 : après chaque
+                           écriture, < 0 : jamais (pas de durabilité) */
+    uint64_t maxBytes;  /* taille totale gardée, 0 : sans limite */
+    long maxAge;        /* âge des messages gardés en s, 0 : sans limite */
+};
+
+/* Message lu dans le journal : data pointe dans le segment, le temps de
+ * l'appel */
+struct journal_entry {
+    uint64_t seq;
+    uint64_t time; /* heure de l'ajout, en µs depuis le 1er janvier 1970 */
+    const char *data;
+    size_t len;
+};
+
+/** Ouvrir le journal du dossier dir, créé s'il n'existe pas, avec les
+ * réglages opts (NULL : valeurs par défaut), et démarrer son écrivain. La
+ * fin coupée du dernier segment est retirée : la numérotation reprend
+ * après le dernier message intact (journal_last_seq)
+ * retourne NULL en cas d'erreur */
+Journal *journal_open(const char *dir, const struct journal_options *opts);
+
+/** Écrire et synchroniser tout ce qui a été ajouté, arrêter l'écrivain et
+ * libérer le journal */
+void journal_close(Journal *j);
+
+/** Ajouter au journal les len octets de data, message numéro seq, sans
+ * attendre le disque
+ * retourne 0, ou -1 si seq ne dépasse pas le dernier numéro ajouté, si le
+ * message est trop gros ou si l'écrivain a trop de retard */
+int journal_append(Journal *j, uint64_t seq, const void *data, size_t len);
+
+/** Attendre que tout ce qui a été ajouté jusqu'ici soit écrit, et donc
+ * lisible par journal_read. Ce qui vient d'être écrit n'attend pas son
+ * fdatasync, mais l'écrivain ne prend les ajouts suivants qu'après celui
+ * en cours : l'attente peut en comprendre un
+ * retourne 0, ou -1 si une écriture a échoué */
+int journal_flush(Journal *j);
+
+/** Attendre que tout ce qui a été ajouté jusqu'ici soit écrit, et
+ * synchronisé si le journal l'est, sans attendre la fin de l'intervalle
+ * retourne 0, ou -1 si une écriture a échoué */
+int journal_sync(Journal *j);
+
+/** Retourner le numéro du dernier message ajouté (0 : aucun) */
+uint64_t journal_last_seq(Journal *j);
+
+/** Retourner le numéro du dernier message écrit, lisible par journal_read
+ * (0 : aucun), sans verrou ni attente de l'écrivain */
+uint64_t journal_written_seq(Journal *j);
+
+/** Appeler fn pour chaque message écrit de numéro au moins from, dans
+ * l'ordre, jusqu'à ce que fn retourne une valeur non nulle ou que le
+ * journal soit épuisé. Les messages encore en attente de l'écrivain ne sont
+ * pas lus
+ * retourne la dernière valeur retournée par fn, 0 si le journal a été lu
+ * jusqu'au bout, -1 en cas d'erreur */
+int journal_read(Journal *j, uint64_t from,
+                 int (*fn)(const struct journal_entry *e, void *arg),
+                 void *arg);
+
+/** Écrire les statistiques du journal, une par ligne "journal_<statistique>
+ * valeur" (appended, dropped, syncs, segments et bytes), dans out */
+void journal_print(Journal *j, FILE *out);
+
+#endif  // JOURNAL_H
@@ -0,0 +1,292 @@
+#include "journal.h"
+#include <assert.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define NB_MESSAGES 10000
+#define NB_THREADS 4
+
+/* state of a read checked by check_entry */
+struct reader {
+	uint64_t next; /* expected sequence number */
+	uint64_t count;
+	uint64_t stop; /* stop after this message, 0 to read everything */
+};
+
+/* checks that entries come in order and hold "message <seq>" */
+int check_entry(const struct journal_entry *e, void *arg);
+
+/* appends NB_MESSAGES / NB_THREADS messages */
+void *append_many(void *arg);
+
+/* records the number of the first entry read */
+int first_entry(const struct journal_entry *e, void *arg);
+
+/* reads the journal from message from, returns the number read */
+uint64_t read_from(Journal *j, uint64_t from);
+
+/* number of files in dir ending with ext */
+int count_files(const char *dir, const char *ext);
+
+/* removes dir and its files */
+void remove_dir(const char *dir);
+
+/* appends "message <seq>" messages until seq reaches last */
+void append_until(Journal *j, uint64_t last);
+
+int main(void)
+{
+	char dir[] = "/tmp/test_journal.XXXXXX";
+	assert(mkdtemp(dir) != NULL);
+
+	/* an empty journal */
+	struct journal_options opts = {.segmentSize = 64 * 1024};
+	Journal *j = journal_open(dir, &opts);
+	assert(j != NULL);
+	assert(journal_last_seq(j) == 0);
+	assert(read_from(j, 1) == 0);
+
+	/* appends are read back after a sync */
+	append_until(j, 1000);
+	assert(journal_last_seq(j) == 1000);
+	assert(journal_sync(j) == 0);
+	assert(read_from(j, 1) == 1000);
+	assert(read_from(j, 0) == 1000);
+
+	/* reads start anywhere, within or across segments */
+	assert(read_from(j, 500) == 501);
+	assert(read_from(j, 1000) == 1);
+	assert(read_from(j, 1001) == 0);
+
+	/* a read stops when the callback returns non zero */
+	struct reader r = {.next = 10, .stop = 20};
+	assert(journal_read(j, 10, check_entry, &r) == 1);
+	assert(r.count == 11);
+
+	/* oversized and out of order messages are refused */
+	char *big = calloc(1, JOURNAL_RECORD_MAX + 1);
+	assert(journal_append(j, 1001, big, JOURNAL_RECORD_MAX + 1) == -1);
+	free(big);
+	assert(journal_append(j, 1000, "message 1000", 12) == -1);
+	assert(journal_append(j, 10, "message 10", 10) == -1);
+	assert(journal_last_seq(j) == 1000);
+
+	/* concurrent appends are all written, in order */
+	pthread_t threads[NB_THREADS];
+	for (int i = 0; i < NB_THREADS; i++)
+		pthread_create(&threads[i], NULL, append_many, j);
+	for (int i = 0; i < NB_THREADS; i++)
+		pthread_join(threads[i], NULL);
+	assert(journal_last_seq(j) == 1000 + NB_MESSAGES);
+	assert(journal_sync(j) == 0);
+	struct reader all = {.next = 1};
+	assert(journal_read(j, 1, check_entry, &all) == 0);
+
+	/* small segments roll, each with its index */
+	int segments = count_files(dir, ".log");
+	assert(segments > 2);
+	assert(count_files(dir, ".idx") == segments);
+
+	/* a damaged index only costs a scan from the start of the segment */
+	char idx[PATH_MAX];
+	snprintf(idx, sizeof(idx), "%s/%020d.idx", dir, 1);
+	int fd = open(idx, O_WRONLY);
+	assert(fd >= 0);
+	char garbage[64];
+	memset(garbage, 0x7f, sizeof(garbage));
+	assert(pwrite(fd, garbage, sizeof(garbage), 32) == sizeof(garbage));
+	close(fd);
+	assert(read_from(j, 700) == 301 + NB_MESSAGES);
+	assert(read_from(j, 3) == 998 + NB_MESSAGES);
+	journal_close(j);
+
+	/* numbering continues after a reopen */
+	j = journal_open(dir, &opts);
+	assert(j != NULL);
+	assert(journal_last_seq(j) == 1000 + NB_MESSAGES);
+	append_until(j, 1000 + NB_MESSAGES + 10);
+	journal_close(j);
+
+	/* a torn tail is cut at the last whole message */
+	char path[PATH_MAX], last[64] = "";
+	DIR *d = opendir(dir);
+	struct dirent *ent;
+	while ((ent = readdir(d)) != NULL)
+		if (strstr(ent->d_name, ".log") && strcmp(ent->d_name, last) > 0)
+			strcpy(last, ent->d_name);
+	closedir(d);
+	snprintf(path, sizeof(path), "%s/%s", dir, last);
+	struct stat st;
+	assert(stat(path, &st) == 0);
+	fd = open(path, O_WRONLY | O_APPEND);
+	assert(fd >= 0);
+	char header[JOURNAL_HEADER_SIZE + 4] = {0, 0, 0, 20, 'x'};
+	assert(write(fd, header, sizeof(header)) == sizeof(header));
+	close(fd);
+	j = journal_open(dir, &opts);
+	assert(j != NULL);
+	assert(journal_last_seq(j) == 1000 + NB_MESSAGES + 10);
+	struct stat cut;
+	assert(stat(path, &cut) == 0);
+	assert(cut.st_size == st.st_size);
+	assert(read_from(j, 1) == 1000 + NB_MESSAGES + 10);
+	append_until(j, 1000 + NB_MESSAGES + 20);
+	assert(journal_sync(j) == 0);
+	assert(read_from(j, 1) == 1000 + NB_MESSAGES + 20);
+	journal_close(j);
+
+	/* the oldest segments go once the journal is too big */
+	opts.maxBytes = 3 * opts.segmentSize;
+	j = journal_open(dir, &opts);
+	append_until(j, 2 * NB_MESSAGES);
+	journal_close(j);
+	segments = count_files(dir, ".log");
+	assert(segments <= 4);
+	assert(count_files(dir, ".idx") == segments);
+	j = journal_open(dir, &opts);
+	uint64_t kept = read_from(j, 1);
+	assert(kept > 0 && kept < 2 * NB_MESSAGES);
+	assert(read_from(j, 2 * NB_MESSAGES - 10) == 11);
+	journal_close(j);
+
+	/* and once they are too old, the current segment aside */
+	d = opendir(dir);
+	struct timespec old[2] = {{.tv_sec = 1000}, {.tv_sec = 1000}};
+	while ((ent = readdir(d)) != NULL)
+		if (ent->d_name[0] != '.')
+			assert(utimensat(dirfd(d), ent->d_name, old, 0) == 0);
+	closedir(d);
+	opts.maxBytes = 0;
+	opts.maxAge = 3600;
+	j = journal_open(dir, &opts);
+	append_until(j, 2 * NB_MESSAGES + 1);
+	assert(journal_sync(j) == 0);
+	assert(count_files(dir, ".log") == 1);
+
+	/* numbers may skip, and a flush makes everything readable */
+	uint64_t first = 0;
+	assert(journal_append(j, 2 * NB_MESSAGES + 5, "message x", 9) == 0);
+	assert(journal_flush(j) == 0);
+	assert(journal_written_seq(j) == 2 * NB_MESSAGES + 5);
+	journal_read(j, 2 * NB_MESSAGES + 2, first_entry, &first);
+	assert(first == 2 * NB_MESSAGES + 5);
+	append_until(j, 2 * NB_MESSAGES + 6);
+	journal_close(j);
+
+	/* without durability, everything is still written on close */
+	opts.maxAge = 0;
+	opts.syncInterval = -1;
+	j = journal_open(dir, &opts);
+	append_until(j, 2 * NB_MESSAGES + 100);
+	journal_close(j);
+	j = journal_open(dir, &opts);
+	assert(journal_last_seq(j) == 2 * NB_MESSAGES + 100);
+	assert(read_from(j, 2 * NB_MESSAGES + 7) == 94);
+	journal_close(j);
+
+	remove_dir(dir);
+	printf("journal: ok\n");
+	return 0;
+}
+
+int check_entry(const struct journal_entry *e, void *arg)
+{
+	struct reader *r = arg;
+	char expected[32];
+	int len = snprintf(expected, sizeof(expected), "message %llu",
+			   (unsigned long long)e->seq);
+
+	assert(e->seq == r->next);
+	assert(e->len == (size_t)len);
+	assert(memcmp(e->data, expected, len) == 0);
+	assert(e->time > 0);
+	r->next++;
+	r->count++;
+	return r->stop && e->seq == r->stop;
+}
+
+void *append_many(void *arg)
+{
+	Journal *j = arg;
+	for (int i = 0; i < NB_MESSAGES / NB_THREADS; i++) {
+		/* numbers are taken and appended under the same lock, as
+		 * the server does */
+		static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+		char msg[32];
+		pthread_mutex_lock(&mutex);
+		uint64_t seq = journal_last_seq(j) + 1;
+		int len = snprintf(msg, sizeof(msg), "message %llu",
+				   (unsigned long long)seq);
+		assert(journal_append(j, seq, msg, len) == 0);
+		pthread_mutex_unlock(&mutex);
+	}
+	return NULL;
+}
+
+uint64_t read_from(Journal *j, uint64_t from)
+{
+	struct reader r = {.next = 0};
+	uint64_t first = 0;
+
+	/* the first message read depends on retention */
+	journal_read(j, from, first_entry, &first);
+	if (first == 0)
+		return 0;
+	r.next = first;
+	assert(journal_read(j, from, check_entry, &r) == 0);
+	assert(r.next == journal_last_seq(j) + 1);
+	return r.count;
+}
+
+int first_entry(const struct journal_entry *e, void *arg)
+{
+	*(uint64_t *)arg = e->seq;
+	return 1;
+}
+
+int count_files(const char *dir, const char *ext)
+{
+	int count = 0;
+	DIR *d = opendir(dir);
+	struct dirent *ent;
+	while ((ent = readdir(d)) != NULL) {
+		size_t len = strlen(ent->d_name);
+		if (len > strlen(ext) &&
+		    strcmp(ent->d_name + len - strlen(ext), ext) == 0)
+			count++;
+	}
+	closedir(d);
+	return count;
+}
+
+void remove_dir(const char *dir)
+{
+	char path[PATH_MAX];
+	DIR *d = opendir(dir);
+	struct dirent *ent;
+	while ((ent = readdir(d)) != NULL) {
+		if (ent->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+		unlink(path);
+	}
+	closedir(d);
+	rmdir(dir);
+}
+
+void append_until(Journal *j, uint64_t last)
+{
+	char msg[32];
+	for (uint64_t seq = journal_last_seq(j) + 1; seq <= last; seq++) {
+		int len = snprintf(msg, sizeof(msg), "message %llu",
+				   (unsigned long long)seq);
+		assert(journal_append(j, seq, msg, len) == 0);
+	}
+}
@@ -1,10 +1,23 @@
 #include "list.h"
 
 #include <error.h>
+#include <pthread.h>
 #include <stdio.h>
 
+#include "slab.h"
+
+/* nodes of all lists come from one slab, created on first use */
+static Slab *nodes;
+static pthread_once_t nodesOnce = PTHREAD_ONCE_INIT;
+
+static void create_nodes(void) {
+    nodes = slab_create("list_node", sizeof(struct node));
+    if (nodes == NULL) error(2, 0, "slab_create failed in create_node\n");
+}
+
 struct node *list_create_node(void *elt) {
-    struct node *r = malloc(sizeof(struct node));
+    pthread_once(&nodesOnce, create_nodes);
+    struct node *r = slab_alloc(nodes);
     if (r == NULL) error(2, 0, "malloc failed in create_node\n");
     r->elt = elt;
     return r;
@@ -25,7 +38,7 @@ void list_free(struct list *l, void (*free_fct)(void *)) {
         if (free_fct) free_fct(curr->elt);
         tmp = curr;
         curr = curr->next;
-        free(tmp);
+        slab_release(nodes, tmp);
     }
     free(l);
 }
@@ -126,7 +139,7 @@ void *list_remove_node(struct list *l, struct node *n) {
     if (n->next != NULL) n->next->prev = n->prev;
     l->length--;
     void *res = n->elt;
-    free(n);
+    slab_release(nodes, n);
     return res;
 }
 
@@ -55,7 +55,9 @@
  * - insert_node_before, to insert a value before a given node in the list
  * - insert_node_after, to insert a value after a given node in the list
  * - remove_node, to remove a given node in the list
- * - create_node, to create a new node on the heap with a given (void *) element
+ * - create_node, to create a new node with a given (void *) element. Nodes
+ *   come from a slab shared by all lists (see slab.h), and are given back by
+ *   the remove functions and by free: they must never be freed directly
  * The insertion after or before a given node and the removal operation of a
  *given node assume that the given node is part of the list. Behaviour is
  *unspecified if it is not.
@@ -0,0 +1,65 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "payload.h"
+#include "user.h"
+
+#define MAILBOX_MAX 100                   /* messages gardés par pseudo */
+#define MAILBOX_TABLE_SIZE 4096           /* listes de la table des pseudos */
+#define DEFAULT_MAILBOX_BYTES (4 << 20)   /* boîtes gardées en mémoire */
+
+/** Boîtes aux lettres des messages privés
+ *
+ * "/msg pseudo texte" est remis tout de suite si le destinataire est
+ * connecté. Sinon, le message attend dans la boîte de ce pseudo, au plus
+ * MAILBOX_MAX messages, et lui est remis à sa prochaine connexion, après
+ * la réponse à son pseudo et l'historique de ses salons. Jusqu'à ce qu'il
+ * ait relevé sa boîte, un utilisateur qui se connecte compte comme absent :
+ * aucun message privé ne peut passer avant sa boîte.
+ *
+ * Une boîte garde les trames de ses messages (voir frame.h) à la suite les
+ * unes des autres ; la forme texte n'est refaite qu'à la remise. Toutes les
+ * boîtes en mémoire tiennent dans un budget commun : au-delà, les moins
+ * récemment servies sont ajoutées à leur fichier dans le dossier de
+ * décharge, "<pseudo en hexadécimal>.mbox", puis libérées. Une boîte
+ * déchargée ne garde en mémoire que son pseudo et son nombre de messages.
+ * Sans dossier, les messages déchargés sont perdus. Les fichiers trouvés
+ * dans le dossier au démarrage sont repris.
+ *
+ * Un seul verrou protège toutes les boîtes, mais aucun accès au disque
+ * n'est fait sous lui : une boîte déchargée est mise en file, puis écrite
+ * par le dépôt qui a dépassé le budget une fois le verrou rendu. Un second
+ * verrou garde les fichiers dans l'ordre de cette file, et la remise
+ * reprend le fichier, puis ce qui est encore en file, puis la mémoire.
+ *
+ * Toutes les fonctions commencent par le préfixe "mailbox_". */
+
+/** Préparer les boîtes : maxBytes en mémoire au plus, déchargées dans dir
+ * (créé au besoin, NULL : pas de décharge), dont les boîtes sont reprises
+ * retourne 0, ou -1 si dir ne peut être ouvert */
+int mailbox_init(size_t maxBytes, const char *dir);
+
+/** Retourner l'utilisateur connecté sous le pseudo nick s'il a relevé sa
+ * boîte, NULL si ses messages privés doivent y être gardés. Le résultat
+ * reste valable dans une section de lecture des ensembles (voir userset.h)
+ */
+struct user *mailbox_recipient(const char *nick);
+
+/** Déposer la trame du message privé frame dans la boîte de nick, si
+ * mailbox_recipient ne le trouve pas
+ * retourne le nombre de messages dans sa boîte, 0 s'il est connecté (rien
+ * n'est déposé), -1 si sa boîte est pleine ou en cas d'erreur */
+ssize_t mailbox_put(const char *nick, const struct payload *frame);
+
+/** Vider la boîte de u, qui vient de se connecter : ses messages privés lui
+ * sont ensuite remis en direct. À appeler par le thread qui remplit sa file
+ * d'envoi, après la réponse à son pseudo
+ * retourne ses messages, précédés d'un avis, en un seul message sous ses
+ * deux formes avec une référence pour l'appelant, ou NULL si elle est vide
+ * ou en cas d'erreur */
+struct payload *mailbox_take(struct user *u);
+
+#endif  // MAILBOX_H
@@ -0,0 +1,88 @@
+#ifndef OUTQ_H
+#define OUTQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "payload.h"
+
+#define OUTQ_INITIAL_SIZE 8
+#define OUTQ_IOV_MAX 64
+
+/** File d'envoi d'un utilisateur
+ *
+ * La file ne copie pas les messages : elle garde une référence vers chaque
+ * struct payload partagée entre tous les destinataires, dans un tableau
+ * circulaire qui s'agrandit au besoin. Les messages en attente partent
+ * ensemble avec un seul sendmsg (un iovec par message) et sans jamais
+ * bloquer (MSG_DONTWAIT) : ce qui ne peut pas partir tout de suite reste en
+ * file jusqu'à ce que la socket redevienne disponible en écriture. Un client
+ * lent ne retient donc que sa propre file.
+ *
+ * L'envoi peut aussi être confié à un autre (io_uring) : outq_prepare décrit
+ * les messages à envoyer, qui restent en file sans pouvoir être abandonnés
+ * jusqu'à ce que outq_sent indique ce qui est parti.
+ *
+ * Toutes les fonctions commencent par le préfixe "outq_" et prennent un
+ * pointeur vers la file en premier argument. Une file n'est pas protégée :
+ * un seul thread doit la manipuler à la fois.
+ *
+ * Une file tient en 48 octets (index sur 32 bits) pour partager sa ligne de
+ * cache avec le reste de ce que la diffusion lit d'un destinataire (voir
+ * user.h). */
+
+struct outq {
+    struct payload **items;
+    uint32_t size;     /* taille du tableau items */
+    uint32_t first;    /* index du plus ancien message */
+    uint32_t count;    /* messages en file */
+    uint32_t inflight; /* messages décrits par outq_prepare, en cours d'envoi */
+    size_t offset;     /* octets déjà envoyés du plus ancien message */
+    size_t bytes;      /* octets restant à envoyer */
+    size_t inflightBytes; /* octets des messages en cours d'envoi */
+};
+
+/** Initialiser une file vide */
+void outq_init(struct outq *q);
+
+/** Mettre p en fin de file, en prenant une référence sur p
+ * retourne 0, ou -1 si l'allocation échoue */
+int outq_push(struct outq *q, struct payload *p);
+
+/** Envoyer sur fd autant de données que possible sans bloquer
+ * retourne 1 si la file est vide, 0 s'il reste des données, -1 si la
+ * connexion est rompue */
+int outq_flush(struct outq *q, int fd);
+
+/** Décrire dans iov (au plus max cases) les prochains messages à envoyer,
+ * à la suite de ceux déjà décrits, un iovec par message. Ils sont gardés
+ * jusqu'à ce que outq_sent les retire
+ * retourne le nombre d'iovec remplis */
+size_t outq_prepare(struct outq *q, struct iovec *iov, size_t max);
+
+/** Retirer de la file les sent premiers octets décrits par outq_prepare,
+ * dans l'ordre où ils ont été décrits */
+void outq_sent(struct outq *q, size_t sent);
+
+/** Abandonner les messages qui n'ont pas commencé à partir (le message en
+ * cours d'envoi est conservé pour ne pas le couper en deux, de même que
+ * ceux décrits par outq_prepare)
+ * retourne le nombre de messages abandonnés */
+size_t outq_drop_pending(struct outq *q);
+
+/** Vider la file et libérer toute la mémoire associée */
+void outq_clear(struct outq *q);
+
+/** Retourner le nombre d'octets en file qui n'ont pas encore été confiés
+ * au noyau (hors envoi décrit par outq_prepare) */
+size_t outq_waiting(const struct outq *q);
+
+/** Retourner le dernier message mis en file, ou NULL si elle est vide */
+struct payload *outq_last(const struct outq *q);
+
+/** Retourner 1 si la file est vide, 0 sinon */
+int outq_is_empty(const struct outq *q);
+
+#endif  // OUTQ_H
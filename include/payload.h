@@ -0,0 +1,51 @@
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <stddef.h>
+
+/** Message diffusé, immuable et partagé
+ *
+ * Un message est mis en forme une seule fois, sa longueur est connue dès sa
+ * création, puis le même objet est placé dans la file d'envoi de chacun de
+ * ses destinataires. Un compteur de références atomique permet de le libérer
+ * lorsque le dernier destinataire a fini de l'écrire, quel que soit le thread
+ * qui s'en charge.
+ *
+ * Un message peut porter sa version en trame v2 (voir frame.h), mise en
+ * forme elle aussi une seule fois : chaque destinataire reçoit la forme
+ * correspondant à son protocole. La trame appartient au message et est
+ * libérée avec lui.
+ *
+ * Les messages courts, les plus fréquents, viennent de réserves par taille
+ * (voir slab.h) : les rafales ne morcellent pas le tas.
+ *
+ * payload_printf, payload_create et payload_alloc retournent un message
+ * possédant une référence ; chaque payload_ref doit être compensé par un
+ * payload_unref. */
+
+struct payload {
+    unsigned refs;
+    size_t len;
+    struct payload *frame; /* même message en trame v2, ou NULL */
+    char data[];           /* len octets suivis d'un caractère nul */
+};
+
+/** Créer un message de len octets dont le contenu reste à écrire
+ * retourne NULL si l'allocation échoue */
+struct payload *payload_alloc(size_t len);
+
+/** Créer un message contenant une copie des len octets de data
+ * retourne NULL si l'allocation échoue */
+struct payload *payload_create(const char *data, size_t len);
+
+/** Créer un message mis en forme comme par printf
+ * retourne NULL en cas d'erreur */
+struct payload *payload_printf(const char *fmt, ...);
+
+/** Ajouter une référence à p et retourner p */
+struct payload *payload_ref(struct payload *p);
+
+/** Retirer une référence à p, qui est libéré s'il n'en a plus */
+void payload_unref(struct payload *p);
+
+#endif  // PAYLOAD_H
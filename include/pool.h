@@ -0,0 +1,55 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <poll.h>
+
+#include "serveur.h"
+
+#define MAX_WORKERS 256
+#define WORKER_INBOX_SIZE 1024
+
+/*================== Pool de threads ==================*/
+/** Thread du pool : il mène l'accueil puis lit les messages de tous ses
+ * clients avec poll, sans jamais bloquer sur l'un d'eux. La première case de
+ * fds surveille sa boîte de réception, les suivantes la socket de users[i]
+ * (fds[i + 1]) */
+struct worker {
+    int id;
+    pthread_t thread;
+
+    Ring *inbox;  /* clients acceptés qui lui sont confiés (struct user *) */
+    size_t load;  /* clients servis, lu par le thread d'acceptation */
+
+    struct pollfd *fds;
+    struct user **users;
+    size_t count;
+    size_t size;
+
+    // Clients qui n'ont pas encore de pseudo
+    struct handshake_queue pending;
+};
+
+/** Lancer nbWorkers threads avec une pile de config.stackSize octets, puis
+ * accepter les connexions sur listenFD et confier chacune au thread qui sert
+ * le moins de clients. Les messages reçus sont déposés dans la file du
+ * répéteur, qui doit déjà tourner. Ne retourne qu'en cas d'erreur fatale */
+void pool_run(int nbWorkers, int listenFD);
+
+/** Boucle d'un thread du pool, à passer à pthread_create */
+void *worker_run(void *worker);
+
+/* Ajoute un client accepté aux sockets surveillées et lui souhaite la
+ * bienvenue */
+void worker_add(struct worker *w, struct user *u);
+
+/* Retire le client d'indice i des sockets surveillées, sans le libérer */
+void worker_remove(struct worker *w, size_t i);
+
+/** Traite des données disponibles sur la socket du client d'indice i
+ * retourne -1 s'il a été retiré, 0 sinon */
+int worker_read(struct worker *w, size_t i);
+
+/* Déconnecte le client d'indice i : le répéteur le libérera */
+void worker_close(struct worker *w, size_t i);
+
+#endif  // POOL_H
@@ -0,0 +1,71 @@
+#ifndef PROTO_H
+#define PROTO_H
+
+#include <stdint.h>
+
+#include "frame/frame.h"
+#include "payload.h"
+#include "room.h"
+#include "user.h"
+
+/** Protocoles texte (v1) et trames (v2) côté serveur
+ *
+ * Chaque client commence en v1 et peut passer en v2 avant d'avoir choisi son
+ * pseudo (voir frame.h). Le serveur lit ses commandes dans son tampon de
+ * réception, lignes en v1 et trames en v2, toujours sans copie.
+ *
+ * Les messages sortants sont mis en forme une fois sous les deux formes :
+ * le texte dans la struct payload, la trame dans son champ frame. La file
+ * de chaque destinataire reçoit la forme de son protocole.
+ *
+ * Toutes les fonctions commencent par le préfixe "proto_". */
+
+/** Passer u en v2 si *line est PROTO_HELLO, éventuellement suivi du pseudo
+ * (voir frame.h) : *line pointe alors sur ce pseudo, ou vaut NULL s'il n'y
+ * en a pas et PROTO_ACK est envoyé aussitôt. Avec un pseudo, PROTO_ACK part
+ * avec la réponse à ce pseudo (proto_send_status)
+ * retourne 1 si u est passé en v2, 0 sinon */
+int proto_hello(struct user *u, char **line);
+
+/** Extraire du tampon de u sa prochaine commande, ligne ou trame selon son
+ * protocole : *text pointe sur son texte, terminé par '\0', dans le tampon.
+ * En v2, seules les trames FRAME_NICK sont lues avant l'acceptation du
+ * pseudo et les trames FRAME_MSG après, les autres sont ignorées
+ * retourne 1 si une commande a été extraite, 0 s'il faut lire la suite, -1
+ * si le flux est invalide */
+int proto_next(struct user *u, char **text);
+
+/** Créer le message text de u diffusé dans room, horodaté maintenant. Sa
+ * trame porte le numéro 0, à remplacer par frame_set_seq
+ * retourne NULL en cas d'erreur */
+struct payload *proto_message(struct user *u, struct room *room,
+                              const char *text);
+
+/** Créer le message privé text de u pour le pseudo nick, horodaté
+ * maintenant (trame FRAME_PRIVATE, sans numéro)
+ * retourne NULL en cas d'erreur */
+struct payload *proto_private(struct user *u, const char *nick,
+                              const char *text);
+
+/** Créer un avis du serveur mis en forme comme par printf, encadré de "***"
+ * en v1
+ * retourne NULL en cas d'erreur */
+struct payload *proto_notice(const char *fmt, ...);
+
+/** Envoyer directement à u, hors file, la réponse text à sa proposition de
+ * pseudo ("status | explications"), suivie de prompt en v1. En v2, status
+ * est aussi dans le champ seq de la trame
+ * retourne le résultat de send */
+ssize_t proto_send_status(struct user *u, int status, const char *text,
+                          const char *prompt);
+
+/** Envoyer directement à u, hors file, son jeton de session u->token et le
+ * numéro du message jusqu'auquel il a tout reçu (trame FRAME_SESSION). Un
+ * client v1 ne reçoit rien
+ * retourne le résultat de send, ou 0 en v1 */
+ssize_t proto_send_session(struct user *u, uint64_t seq);
+
+/** Retourner la forme de p à envoyer à u */
+struct payload *proto_payload(struct user *u, struct payload *p);
+
+#endif  // PROTO_H
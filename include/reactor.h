@@ -0,0 +1,84 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <sys/epoll.h>
+
+#include "serveur.h"
+
+#define MAX_EVENTS 256
+#define MAX_REACTORS 64
+
+/*================== Boucle d'événements ==================*/
+struct reactor {
+    int id;
+    int epollFD;
+    int listenFD;
+    uint64_t acceptResume; /* reprise de l'écoute suspendue, 0 sinon */
+    pthread_t thread;
+
+    // Messages diffusés par les autres réacteurs, déposés dans l'ordre des
+    // numéros
+    LIST *inbox;
+    pthread_mutex_t mutexInbox;
+    int inboxFD; /* eventfd signalant un dépôt dans inbox */
+    LIST *drained; /* boîte reprise, en cours de distribution */
+
+    // Destinataires à envoyer, messages privés à déposer chez chaque autre
+    // réacteur et réacteurs à réveiller à la fin du tour
+    struct flush_batch batch;
+    LIST *outbox[MAX_REACTORS];
+    int posted[MAX_REACTORS];
+
+    // Clients acceptés par ce réacteur qui n'ont pas encore de pseudo
+    struct handshake_queue pending;
+};
+
+/** Lancer nbReactors boucles epoll, chacune dans son thread fixé sur un coeur.
+ * Avec plus d'un réacteur, chacun possède sa propre socket d'écoute
+ * SO_REUSEPORT sur le port donné et le noyau répartit les connexions entre
+ * elles. Chaque réacteur ne touche qu'à ses propres utilisateurs : une
+ * diffusion est faite localement puis déposée dans la boîte de réception des
+ * autres réacteurs. Ne retourne qu'en cas d'erreur fatale */
+void reactors_run(int nbReactors, int listenFD, uint16_t port);
+
+/** Boucle d'un réacteur, à passer à pthread_create */
+void *reactor_run(void *reactor);
+
+/* Accepte toutes les connexions en attente sur la socket d'écoute */
+void reactor_accept(struct reactor *r);
+
+/* Traite des données disponibles sur la socket d'un utilisateur, en menant
+ * son accueil tant qu'il n'a pas de pseudo */
+void reactor_read(struct reactor *r, struct user *u);
+
+/** Traite une commande complète (ligne ou trame) reçue d'un utilisateur
+ * connecté
+ * retourne -1 si l'utilisateur a été fermé, 0 sinon */
+int reactor_line(struct reactor *r, struct user *u, char *line);
+
+/** Envoie ce qui peut l'être de la file d'un utilisateur
+ * retourne 0, ou -1 si la connexion a été fermée */
+int reactor_write(struct reactor *r, struct user *u);
+
+/** Termine un tour de boucle : dépose en une fois chez chaque autre réacteur
+ * les messages privés du tour, réveille ceux qui ont reçu quelque chose,
+ * puis envoie la file de chaque destinataire en un seul appel système */
+void reactor_flush(struct reactor *r);
+
+/* Retire un utilisateur de la boucle et libère ses ressources */
+void reactor_close(struct reactor *r, struct user *u);
+
+/* Numérote un message et le dépose chez les autres réacteurs, chacun
+ * prenant sa propre référence sur le contenu, puis le diffuse aux
+ * utilisateurs de r après ce que sa boîte avait reçu avant lui ; rien n'est
+ * envoyé avant reactor_flush */
+void reactor_broadcast(struct reactor *r, struct message_info *msg);
+
+/* Remet un message privé au destinataire s'il est servi par r, le dépose
+ * chez le réacteur qui le sert, ou le garde dans sa boîte s'il est absent */
+void reactor_private(struct reactor *r, struct message_info *msg);
+
+/* Distribue les messages déposés dans la boîte de réception de r */
+void reactor_drain_inbox(struct reactor *r);
+
+#endif  // REACTOR_H
@@ -0,0 +1,45 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stddef.h>
+
+#include "user.h"
+
+#define REGISTRY_INITIAL_SIZE 1024
+
+/** Annuaire des utilisateurs authentifiés
+ *
+ * Deux index à adressage ouvert (sondage linéaire, suppression par
+ * décalage arrière, sans pierre tombale) retrouvent un utilisateur par
+ * pseudo ou par socket en temps constant, quel que soit le nombre de
+ * connectés. Les tables doublent dès qu'elles sont à moitié pleines.
+ *
+ * La réservation d'un pseudo vérifie sa disponibilité et l'inscrit sous le
+ * même verrou : deux clients ne peuvent pas obtenir le même pseudo.
+ *
+ * L'annuaire ne possède pas les utilisateurs. Un pointeur obtenu par
+ * registry_find_* reste valable tant que l'utilisateur n'est pas libéré :
+ * les utilisateurs étant libérés par userset_retire, il suffit de
+ * l'utiliser dans une section de lecture de l'ensemble des connectés. */
+
+/** Initialiser l'annuaire, vide */
+void registry_init(void);
+
+/** Réserver le pseudo nick pour u : s'il est libre, il est copié dans
+ * u->username et u est inscrit par pseudo et par socket
+ * retourne 0, 1 si le pseudo est déjà pris, -1 en cas d'erreur */
+int registry_reserve(struct user *u, const char *nick);
+
+/** Désinscrire u, s'il a réservé un pseudo */
+void registry_release(struct user *u);
+
+/** Retourner l'utilisateur portant le pseudo nick, ou NULL */
+struct user *registry_find_nick(const char *nick);
+
+/** Retourner l'utilisateur authentifié sur la socket fd, ou NULL */
+struct user *registry_find_fd(int fd);
+
+/** Retourner le nombre d'utilisateurs inscrits */
+size_t registry_count(void);
+
+#endif  // REGISTRY_H
@@ -0,0 +1,140 @@
+#include "ring.h"
+
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define CACHE_LINE 64
+
+/* Algorithme de D. Vyukov : chaque case porte un numéro de séquence qui
+ * indique si elle est libre pour le tour courant des producteurs ou prête
+ * pour le consommateur. */
+struct ring {
+    size_t mask;
+    size_t eltSize;
+    size_t *seqs;
+    char *data;
+    int wakeFD;
+
+    /* Index des producteurs, du consommateur et état du consommateur chacun
+     * sur sa ligne de cache pour éviter les faux partages */
+    char pad0[CACHE_LINE];
+    size_t head;
+    char pad1[CACHE_LINE - sizeof(size_t)];
+    size_t tail;
+    char pad2[CACHE_LINE - sizeof(size_t)];
+    int sleeping;
+    char pad3[CACHE_LINE - sizeof(int)];
+};
+
+Ring *ring_create(size_t capacity, size_t eltSize) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+
+    Ring *r = calloc(1, sizeof(Ring));
+    if (!r) return NULL;
+
+    r->seqs = malloc(size * sizeof(size_t));
+    r->data = malloc(size * eltSize);
+    r->wakeFD = eventfd(0, EFD_NONBLOCK);
+    if (!r->seqs || !r->data || r->wakeFD < 0) {
+        if (r->wakeFD >= 0) close(r->wakeFD);
+        free(r->seqs);
+        free(r->data);
+        free(r);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < size; i++) r->seqs[i] = i;
+    r->mask = size - 1;
+    r->eltSize = eltSize;
+    return r;
+}
+
+void ring_free(Ring *r) {
+    if (!r) return;
+    close(r->wakeFD);
+    free(r->seqs);
+    free(r->data);
+    free(r);
+}
+
+int ring_push(Ring *r, const void *elt) {
+    size_t pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+
+    while (1) {
+        size_t *seq = &r->seqs[pos & r->mask];
+        size_t s = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)s - (intptr_t)pos;
+
+        if (diff == 0) {
+            // Case libre : on tente de la réserver
+            if (__atomic_compare_exchange_n(&r->head, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            return -1;  // le consommateur n'a pas encore libéré cette case
+        } else {
+            pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(r->data + (pos & r->mask) * r->eltSize, elt, r->eltSize);
+    __atomic_store_n(&r->seqs[pos & r->mask], pos + 1, __ATOMIC_RELEASE);
+
+    // Réveil uniquement si le consommateur dort (barrière avec ring_sleep)
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&r->sleeping, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&r->sleeping, 0, __ATOMIC_ACQ_REL)) {
+        uint64_t one = 1;
+        if (write(r->wakeFD, &one, sizeof(one)) < 0) {
+            // Compteur saturé : le consommateur est de toute façon réveillé
+        }
+    }
+
+    return 0;
+}
+
+void ring_push_wait(Ring *r, const void *elt) {
+    while (ring_push(r, elt) < 0) sched_yield();
+}
+
+int ring_pop(Ring *r, void *elt) {
+    size_t pos = r->tail;
+    size_t *seq = &r->seqs[pos & r->mask];
+
+    if (__atomic_load_n(seq, __ATOMIC_ACQUIRE) != pos + 1) return -1;
+
+    memcpy(elt, r->data + (pos & r->mask) * r->eltSize, r->eltSize);
+
+    // La case redevient libre pour le tour suivant des producteurs
+    __atomic_store_n(seq, pos + r->mask + 1, __ATOMIC_RELEASE);
+    r->tail = pos + 1;
+    return 0;
+}
+
+int ring_fd(const Ring *r) { return r->wakeFD; }
+
+int ring_sleep(Ring *r) {
+    __atomic_store_n(&r->sleeping, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    // Un producteur a pu déposer un élément avant de voir sleeping
+    size_t pos = r->tail;
+    if (__atomic_load_n(&r->seqs[pos & r->mask], __ATOMIC_ACQUIRE) == pos + 1) {
+        __atomic_store_n(&r->sleeping, 0, __ATOMIC_RELAXED);
+        return 0;
+    }
+    return 1;
+}
+
+void ring_wake(Ring *r) {
+    uint64_t count;
+    __atomic_store_n(&r->sleeping, 0, __ATOMIC_RELAXED);
+    if (read(r->wakeFD, &count, sizeof(count)) < 0) {
+        // Rien à lire : réveil par un autre descripteur
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef RING_H
+#define RING_H
+#include <stddef.h>
+
+/** File circulaire bornée sans verrou, plusieurs producteurs / un consommateur
+ *
+ * Ring est un type opaque contenant des éléments de taille fixe, copiés à
+ * l'entrée et à la sortie. N'importe quel nombre de threads peut déposer des
+ * éléments en parallèle, un seul thread doit les retirer.
+ *
+ * Toutes les fonctions de cette bibliothèque commencent par le préfixe
+ * "ring_". À part ring_create, elles prennent toutes un pointeur vers une
+ * file en premier argument.
+ *
+ * Les primitives sont :
+ * - ring_push pour déposer un élément, sans bloquer (échoue si la file est
+ *   pleine), et ring_push_wait qui patiente jusqu'à ce qu'une place se libère
+ * - ring_pop pour retirer le plus ancien élément, sans bloquer
+ *
+ * Réveil du consommateur : ring_fd donne un descripteur (eventfd) à surveiller
+ * en lecture avec poll/epoll. Pour éviter un appel système par élément, les
+ * producteurs n'écrivent dans ce descripteur que si le consommateur s'est
+ * déclaré endormi :
+ *
+ *   while (1) {
+ *       while (ring_pop(r, &elt) == 0) traiter(&elt);
+ *       if (ring_sleep(r)) {       // la file est vide, on peut dormir
+ *           poll(...);             // attente sur ring_fd(r) et autres
+ *           ring_wake(r);
+ *       }
+ *   }
+ */
+
+typedef struct ring Ring;
+
+/** Créer une file pouvant contenir au moins capacity éléments de eltSize
+ * octets (la capacité est arrondie à la puissance de deux supérieure)
+ * retourne NULL en cas d'erreur */
+Ring *ring_create(size_t capacity, size_t eltSize);
+
+/** Libérer la file et toute la mémoire associée */
+void ring_free(Ring *r);
+
+/** Copier elt dans la file
+ * retourne 0, ou -1 si la file est pleine */
+int ring_push(Ring *r, const void *elt);
+
+/** Copier elt dans la file, en cédant le processeur tant qu'elle est pleine */
+void ring_push_wait(Ring *r, const void *elt);
+
+/** Retirer le plus ancien élément et le copier dans elt
+ * retourne 0, ou -1 si la file est vide. Réservé au consommateur */
+int ring_pop(Ring *r, void *elt);
+
+/** Retourner le descripteur à surveiller en lecture pour être réveillé */
+int ring_fd(const Ring *r);
+
+/** Déclarer le consommateur endormi
+ * retourne 1 s'il peut attendre sur ring_fd, 0 si des éléments sont arrivés
+ * entre-temps (il reste alors éveillé) */
+int ring_sleep(Ring *r);
+
+/** Signaler la fin de l'attente du consommateur */
+void ring_wake(Ring *r);
+
+#endif
@@ -0,0 +1,117 @@
+#include "ring.h"
+#include <assert.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define NB_PRODUCERS 4
+#define NB_PER_PRODUCER 100000
+
+/* an element with the producer id and a per-producer sequence number */
+struct item {
+	int producer;
+	int seq;
+};
+
+/* pushes NB_PER_PRODUCER items in order, waiting when the ring is full */
+void *producer(void *arg);
+
+static Ring *shared;
+
+int main(void)
+{
+	/* single thread tests */
+	Ring *r = ring_create(3, sizeof(int));
+	assert(r != NULL);
+	int v;
+
+	/* empty ring */
+	assert(ring_pop(r, &v) == -1);
+
+	/* capacity is rounded up to 4 */
+	for (int i = 0; i < 4; i++)
+		assert(ring_push(r, &i) == 0);
+	int extra = 42;
+	assert(ring_push(r, &extra) == -1);
+
+	/* values come out in FIFO order */
+	for (int i = 0; i < 4; i++) {
+		assert(ring_pop(r, &v) == 0);
+		assert(v == i);
+	}
+	assert(ring_pop(r, &v) == -1);
+
+	/* wrap around several times */
+	for (int i = 0; i < 1000; i++) {
+		assert(ring_push(r, &i) == 0);
+		assert(ring_pop(r, &v) == 0);
+		assert(v == i);
+	}
+
+	/* the consumer can sleep on an empty ring, a push wakes it up */
+	assert(ring_sleep(r) == 1);
+	assert(ring_push(r, &extra) == 0);
+	struct pollfd pfd = { ring_fd(r), POLLIN, 0 };
+	assert(poll(&pfd, 1, 0) == 1);
+	ring_wake(r);
+	assert(poll(&pfd, 1, 0) == 0);
+
+	/* sleeping is refused when an element is already there */
+	assert(ring_sleep(r) == 0);
+	assert(ring_pop(r, &v) == 0 && v == 42);
+
+	/* no wake up is sent while the consumer is awake */
+	assert(ring_push(r, &extra) == 0);
+	assert(poll(&pfd, 1, 0) == 0);
+	assert(ring_pop(r, &v) == 0);
+
+	ring_free(r);
+	printf("single thread: ok\n");
+
+	/* several producers, one consumer: every item is received once and
+	 * items of a given producer keep their order */
+	shared = ring_create(64, sizeof(struct item));
+	pthread_t threads[NB_PRODUCERS];
+	int ids[NB_PRODUCERS];
+	int next[NB_PRODUCERS];
+
+	for (int i = 0; i < NB_PRODUCERS; i++) {
+		ids[i] = i;
+		next[i] = 0;
+		pthread_create(&threads[i], NULL, producer, &ids[i]);
+	}
+
+	int received = 0;
+	struct item it;
+	pfd.fd = ring_fd(shared);
+	while (received < NB_PRODUCERS * NB_PER_PRODUCER) {
+		while (ring_pop(shared, &it) == 0) {
+			assert(it.producer >= 0 && it.producer < NB_PRODUCERS);
+			assert(it.seq == next[it.producer]);
+			next[it.producer]++;
+			received++;
+		}
+		if (received < NB_PRODUCERS * NB_PER_PRODUCER && ring_sleep(shared)) {
+			poll(&pfd, 1, -1);
+			ring_wake(shared);
+		}
+	}
+
+	for (int i = 0; i < NB_PRODUCERS; i++)
+		pthread_join(threads[i], NULL);
+	assert(ring_pop(shared, &it) == -1);
+
+	ring_free(shared);
+	printf("%d producers: ok\n", NB_PRODUCERS);
+
+	return 0;
+}
+
+void *producer(void *arg)
+{
+	struct item it = { *(int *) arg, 0 };
+	for (; it.seq < NB_PER_PRODUCER; it.seq++)
+		ring_push_wait(shared, &it);
+	return NULL;
+}
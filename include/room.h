@@ -0,0 +1,127 @@
+#ifndef ROOM_H
+#define ROOM_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "journal/journal.h"
+#include "payload.h"
+#include "scrollback.h"
+#include "user.h"
+#include "userset.h"
+
+#define ROOM_NAME_SIZE 32
+#define DEFAULT_ROOM "#general"
+#define MAX_ROOMS 4096
+#define DEFAULT_HISTORY_MESSAGES 50
+#define DEFAULT_HISTORY_BYTES (32 * 1024)
+
+/** Salons de discussion
+ *
+ * Chaque salon garde son propre ensemble de membres, publié sans verrou
+ * comme l'ensemble des connectés (voir userset.h) : un message n'est
+ * distribué qu'aux membres du salon où il est envoyé, le coût d'une
+ * diffusion dépend donc de la taille du salon et non du nombre de
+ * connectés.
+ *
+ * Un utilisateur peut être membre de plusieurs salons. Ses messages vont
+ * dans son salon courant, le dernier rejoint. Les salons sont créés au
+ * premier /join et ne sont jamais libérés (au plus MAX_ROOMS) : un message
+ * en transit peut ainsi toujours désigner son salon.
+ *
+ * La liste des salons d'un utilisateur n'est manipulée que par le thread
+ * qui lit sa socket.
+ *
+ * Chaque salon garde ses derniers messages, déjà mis en forme (voir
+ * scrollback.h), pour les rejouer à ceux qui le rejoignent avant les
+ * messages en direct. Un arrivant est inscrit sans rien recevoir en direct
+ * (USERSET_PENDING) jusqu'à ce que celui qui remplit sa file d'envoi
+ * appelle room_history : les messages gardés à cet instant lui sont
+ * rejoués, les suivants lui parviennent en direct, sans trou ni doublon.
+ *
+ * Tous les messages diffusés, tous salons confondus, sont numérotés dans
+ * l'ordre et horodatés par le serveur : le numéro et l'heure d'envoi sont
+ * dans leur trame (voir frame.h). Un client n'a donc qu'un numéro à retenir
+ * pour reprendre sa session (voir session.h) : room_history lui rejoue ce
+ * qui suit ce numéro dans chacun de ses salons. Le numéro est pris par le
+ * thread qui remplit les files d'envoi (le répéteur, la boucle io_uring ou
+ * le réacteur de l'émetteur), sous un verrou commun à tous les salons :
+ * chaque client reçoit les messages dans l'ordre des numéros, et aucun
+ * message plus ancien que le dernier reçu ne peut encore lui parvenir.
+ * L'historique de chaque salon suit le même ordre sous le verrou du salon.
+ *
+ * Si le serveur tient un journal (voir journal/journal.h), chaque message y
+ * est ajouté sous forme de trame, sous son numéro : la numérotation reprend
+ * après le dernier message du journal au redémarrage. L'ajout ne fait que
+ * copier la trame, l'écriture sur disque est laissée à l'écrivain du
+ * journal. */
+
+struct room {
+    char name[ROOM_NAME_SIZE];
+    struct userset members;
+    pthread_mutex_t mutexHistory; /* historique et dernier numéro */
+    uint64_t seq; /* numéro du dernier message diffusé dans le salon */
+    struct scrollback history;
+};
+
+/** Initialiser la table des salons et créer DEFAULT_ROOM. Chaque salon
+ * garde au plus historyMessages messages et historyBytes octets
+ * d'historique (0 message : pas d'historique). Les messages sont aussi
+ * ajoutés à journal, sauf s'il est NULL */
+void rooms_init(size_t historyMessages, size_t historyBytes,
+                Journal *journal);
+
+/** Vérifier un nom de salon : '#' suivi de 1 à ROOM_NAME_SIZE - 2
+ * caractères, sans espace ni ':'
+ * retourne 0 s'il est valide, -1 sinon */
+int room_check_name(const char *name);
+
+/** Retourner le salon nommé name, créé s'il n'existe pas et que create est
+ * non nul
+ * retourne NULL si le nom est invalide, si le salon n'existe pas (sans
+ * create) ou s'il y a trop de salons */
+struct room *room_get(const char *name, int create);
+
+/** Faire entrer u dans room, qui devient son salon courant. Un nouveau
+ * membre ne reçoit rien en direct avant room_history
+ * retourne 1 si u est un nouveau membre, 0 s'il l'était déjà, -1 en cas
+ * d'erreur */
+int room_join(struct user *u, struct room *room);
+
+/** Faire sortir u de room ; son salon courant devient le dernier rejoint
+ * parmi ceux qui lui restent
+ * retourne 0, ou -1 si u n'en était pas membre */
+int room_part(struct user *u, struct room *room);
+
+/** Faire sortir u de tous ses salons, avant sa déconnexion, en temps
+ * proportionnel à son nombre de salons */
+void room_part_all(struct user *u);
+
+/** Retourner le numéro du dernier message diffusé, tous salons confondus */
+uint64_t rooms_last_seq(void);
+
+/** Numéroter le message p de room (voir proto_message), le garder dans
+ * l'historique du salon et l'ajouter au journal. À appeler par un seul
+ * thread pour des destinataires donnés : ils le reçoivent alors dans
+ * l'ordre des numéros. post(arg, seq), s'il est donné, est appelé avec le
+ * numéro sous le verrou qui l'attribue : ce qu'il dépose pour d'autres
+ * threads suit le même ordre
+ * retourne le numéro du message */
+uint64_t room_publish(struct room *room, struct payload *p,
+                      void (*post)(void *arg, uint64_t seq), void *arg);
+
+/** Copier l'historique de room postérieur au message numéro after (0 :
+ * tout) dans *history, tableau alloué à libérer par free, avec une
+ * référence sur chaque message, et faire recevoir en direct à u tous les
+ * messages suivants. *missing reçoit le numéro du plus récent message
+ * postérieur à after qui n'est plus dans l'historique, à relire dans le
+ * journal, 0 s'il n'en manque aucun ou si after vaut 0. À appeler une fois
+ * par arrivée, par le thread qui remplit la file d'envoi de u, avant d'y
+ * mettre l'historique
+ * retourne le nombre de messages copiés, ou -1 si u a déjà reçu son
+ * historique ou n'est plus membre de room */
+ssize_t room_history(struct room *room, struct user *u, uint64_t after,
+                     struct payload ***history, uint64_t *missing);
+
+#endif  // ROOM_H
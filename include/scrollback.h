@@ -0,0 +1,63 @@
+#ifndef SCROLLBACK_H
+#define SCROLLBACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "payload.h"
+
+/** Historique borné des derniers messages d'un salon
+ *
+ * L'historique garde une référence vers chacun des derniers messages
+ * diffusés, déjà mis en forme sous ses deux formes (texte et trame, voir
+ * payload.h), dans un tableau circulaire alloué une fois pour toutes :
+ * rejouer l'historique à un arrivant revient à mettre ces références dans
+ * sa file d'envoi, sans rien remettre en forme.
+ *
+ * La mémoire est bornée dès l'initialisation : au plus size messages et
+ * maxBytes octets (les deux formes comptées). Les plus anciens sont relâchés
+ * pour faire de la place ; un message plus gros que maxBytes vide
+ * l'historique sans y entrer, qui reste ainsi une suite sans trou des
+ * derniers messages.
+ *
+ * Chaque message est gardé avec son numéro de diffusion, et l'historique
+ * retient le numéro du plus récent message relâché : un client qui reprend
+ * sa session après le message n° after sait ainsi si tout ce qu'il a manqué
+ * est encore en mémoire ou s'il faut en relire une partie dans le journal.
+ *
+ * Toutes les fonctions commencent par le préfixe "scrollback_" et prennent
+ * un pointeur vers l'historique en premier argument. Un historique n'est
+ * pas protégé : ses utilisateurs le manipulent sous leur propre verrou (voir
+ * room.h). */
+
+struct scrollback {
+    struct payload **items;
+    uint64_t *seqs; /* numéro de chaque message */
+    uint64_t evicted; /* numéro du plus récent message relâché, ou avant
+                         lequel l'historique a commencé */
+    uint32_t size;  /* messages au plus, 0 : pas d'historique */
+    uint32_t first; /* index du plus ancien message */
+    uint32_t count; /* messages gardés */
+    size_t bytes;   /* octets des messages gardés */
+    size_t maxBytes;
+};
+
+/** Initialiser un historique vide d'au plus size messages et maxBytes
+ * octets, commencé après le message numéro start (ceux d'avant n'y sont
+ * pas)
+ * retourne 0, ou -1 si l'allocation échoue */
+int scrollback_init(struct scrollback *sb, size_t size, size_t maxBytes,
+                    uint64_t start);
+
+/** Garder p, numéro seq, comme message le plus récent, en prenant une
+ * référence sur p, quitte à relâcher les plus anciens */
+void scrollback_push(struct scrollback *sb, struct payload *p, uint64_t seq);
+
+/** Copier dans out, qui a de la place pour sb->count messages, les messages
+ * gardés de numéro supérieur à after, du plus ancien au plus récent, avec
+ * une référence sur chacun
+ * retourne le nombre de messages copiés */
+size_t scrollback_copy(const struct scrollback *sb, uint64_t after,
+                       struct payload **out);
+
+#endif  // SCROLLBACK_H
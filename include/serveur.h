@@ -7,15 +7,35 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include "handshake.h"
+#include "proto.h"
+#include "registry.h"
+#include "ring/ring.h"
+#include "room.h"
+#include "stats.h"
 #include "user.h"
+#include "userset.h"
 
 #define MAX_CLIENTS 10
-#define BUFFER_SIZE 1024
+#define LISTEN_BACKLOG SOMAXCONN
 #define PORT_FREESCORD 4321
 
+#define WELCOME_MSG "Bienvenue sur Freescord !\r\n"
+#define NICKNAME_PROMPT "Entrez votre pseudo : "
+#define NICKNAME_SIZE USER_NAME_SIZE
+#define DEFAULT_HIGH_WATER (64 * 1024)
+#define REPEATER_RING_SIZE 1024
+#define DEFAULT_BATCH_WINDOW 0   /* µs, 0 : envoi à la fin de chaque tour */
+#define DEFAULT_BATCH_CAP 1000   /* µs */
+#define DEFAULT_HANDSHAKE_TIMEOUT 30000 /* ms */
+#define DEFAULT_POOL_WORKERS 4
+#define DEFAULT_STACK_SIZE (64 * 1024)
+#define DEFAULT_JOURNAL_SYNC 10 /* ms */
+
 #define CHECK_ERR(x, msg)                              \
     if (x < 0) {                                       \
         fprintf(stderr, "[SERVER ERROR] - %s\n", msg); \
@@ -23,46 +43,264 @@
     }
 
 /*================== Message avec ID de l'émetteur ==================*/
+enum message_type {
+    MSG_BROADCAST, /* payload est à diffuser dans room */
+    MSG_NOTICE,    /* payload est une réponse du serveur pour sender seul */
+    MSG_REPLAY,    /* sender a rejoint room : son historique après le
+                      message seq (0 : tout), puis payload s'il n'est pas
+                      NULL */
+    MSG_PRIVATE,   /* payload est un message privé pour le pseudo nommé
+                      dans sa trame (voir mailbox.h) */
+    MSG_MAILBOX,   /* sender vient de se connecter : sa boîte lui est
+                      remise, voir login_mailbox */
+    MSG_LEAVE      /* sender a quitté le chat, le répéteur le libère */
+};
+
 struct message_info {
+    enum message_type type;
+    struct user *sender;
     int sender_socket;
-    char content[BUFFER_SIZE + 64];
+    struct room *room;       /* salon destinataire d'une diffusion */
+    uint64_t seq;            /* numéro, donné par room_publish */
+    struct payload *payload; /* une référence, relâchée après diffusion */
+};
+
+/*================== Configuration du serveur ==================*/
+enum server_mode {
+    MODE_THREAD, /* un thread par client (mode historique) */
+    MODE_EPOLL,  /* une boucle d'événements epoll non bloquante */
+    MODE_POOL,   /* un nombre fixe de threads, plusieurs clients chacun */
+    MODE_CORO,   /* une coroutine par client, dans un seul thread */
+    MODE_URING   /* une boucle io_uring, repli sur epoll si indisponible */
 };
 
+/* Traitement d'un client dont la file d'envoi dépasse le seuil */
+enum lag_policy {
+    LAG_DROP,      /* le nouveau message n'est pas mis en file */
+    LAG_COALESCE,  /* la file est résumée par un avertissement */
+    LAG_DISCONNECT /* le client est déconnecté */
+};
+
+struct server_config {
+    enum server_mode mode;
+    uint16_t port;
+    int nbReactors;        /* boucles epoll en parallèle (mode epoll) */
+    size_t highWater;      /* seuil d'une file d'envoi, en octets */
+    enum lag_policy lagPolicy;
+    long batchWindow;      /* attente d'autres messages avant envoi, en µs */
+    long batchCap;         /* âge maximal d'un lot avant envoi, en µs */
+    long handshakeTimeout; /* délai pour choisir un pseudo, en ms */
+    int nbWorkers;         /* threads du pool (mode pool) */
+    size_t stackSize;      /* pile des threads et coroutines, en octets */
+    size_t historyMessages; /* historique de chaque salon, en messages */
+    size_t historyBytes;    /* et en octets */
+    const char *journalDir; /* dossier du journal, NULL : pas de journal */
+    long journalSync;       /* ms entre deux fdatasync, < 0 : jamais */
+    uint64_t journalMaxBytes; /* taille gardée du journal, 0 : sans limite */
+    long journalMaxAge;     /* âge gardé du journal en s, 0 : sans limite */
+    size_t mailboxBytes;    /* boîtes des absents gardées en mémoire */
+    const char *mailboxDir; /* décharge des boîtes, NULL : perdues */
+};
+
+/*================== Regroupement des envois ==================*/
+/** Destinataires dont la file a reçu des messages depuis le dernier envoi :
+ * chacun n'est envoyé qu'une fois par lot, en un seul appel système pour
+ * toutes ses lignes en attente */
+struct flush_batch {
+    struct user **users;
+    size_t count;
+    size_t size;
+    uint64_t start; /* instant du premier message du lot en µs, 0 si vide */
+};
+
+extern struct server_config config;
+extern struct userset connectUsers;
+extern Ring *repeaterRing;
+
 /*================== Liste des fonctions ==================*/
 
-/** Gérer toutes les communications avec le client renseigné dans
- * user, qui doit être l'adresse d'une struct user */
+/** Lire les options de la ligne de commande :
+ * srv [-m thread|epoll|pool|coro|uring] [-r réacteurs] [-t threads]
+ *     [-s pile_ko] [-w seuil] [-l drop|coalesce|disconnect] [-b fenêtre_us]
+ *     [-B plafond_us] [-H délai_ms] [-k messages] [-K octets] [-d dossier]
+ *     [-f fsync_ms] [-R octets] [-A secondes] [-M octets] [-D dossier]
+ *     [port] */
+void parse_options(int argc, char *argv[], struct server_config *cfg);
+
+/** Boucle d'accueil du mode thread : accepte les connexions sur listenFD et
+ * mène l'accueil de chaque client sans bloquer (voir handshake.h). Un thread
+ * handle_client n'est créé qu'une fois son pseudo accepté. Ne retourne
+ * qu'en cas d'erreur fatale */
+void accept_clients(int listenFD);
+
+/** Préparer attr pour un thread client ou du pool : pile de
+ * config.stackSize octets, au moins PTHREAD_STACK_MIN */
+void thread_attr_init(pthread_attr_t *attr);
+
+/** Gérer les messages du client renseigné dans user, qui doit être
+ * l'adresse d'une struct user dont le pseudo a été accepté */
 void *handle_client(void *user);
 
-/** Créer et configurer une socket d'écoute sur le port donné en argument
+/** Créer et configurer une socket d'écoute sur le port donné en argument,
+ * en IPv6 et IPv4 à la fois (IPv4 seul si le système n'a pas IPv6), avec
+ * SO_REUSEPORT si reusePort est non nul, pour que plusieurs sockets
+ * puissent se partager le même port
  * retourne le descripteur de cette socket, ou -1 en cas d'erreur */
-int create_listening_sock(uint16_t port);
+int create_listening_sock(uint16_t port, int reusePort);
 
 /* Gère un client connecté */
 void *handle_client(void *user);
 
-/* Thread qui lit dans le tube et distribue les messages */
+/* Thread qui vide la file des threads clients et distribue les messages */
 void *read_tupe(void *arg);
 
-/* Envoie un message à un utilisateur */
-void repeat_message(struct user *u, char *message);
+/** Met un message partagé dans la file de u, sans l'envoyer, en appliquant
+ * la politique de retard si la file dépasse le seuil
+ * retourne 0, ou -1 si u est en cours de déconnexion ou ne prend pas le
+ * message */
+int repeat_message(struct user *u, struct payload *message);
+
+/** repeat_message pour un membre d'un ensemble parcouru par une diffusion,
+ * qui peut le croiser deux fois s'il change de ligne (voir userset.h)
+ * retourne 0, ou -1 si message est déjà le dernier de sa file ou s'il ne le
+ * prend pas */
+int repeat_member(struct user *u, struct payload *message);
+
+/** Envoie autant que possible de la file de u sans bloquer, et interrompt la
+ * connexion en cas d'erreur
+ * retourne 1 s'il reste des données en file, 0 si tout est parti, -1 si u est
+ * en cours de déconnexion */
+int flush_user(struct user *u);
+
+/* Met le message numéro seq dans la file de tous les utilisateurs de la
+ * version users sauf l'émetteur et ceux qui le reçoivent par leur
+ * historique, qui seront envoyés avec le lot */
+void send_messageAll(const struct user_set *users, struct payload *message,
+                     uint64_t seq, int sender_socket,
+                     struct flush_batch *batch);
+
+/** Met dans la file de u l'historique de room, qu'il vient de rejoindre,
+ * postérieur au message after (0 : tout l'historique en mémoire, sinon
+ * aussi ce qui n'est plus que dans le journal), puis notice s'il n'est pas
+ * NULL, à envoyer avec le lot. Appelé par le thread qui remplit la file de
+ * u, une fois par arrivée (voir room.h) */
+void replay_room(struct user *u, struct room *room, struct payload *notice,
+                 uint64_t after, struct flush_batch *batch);
+
+/** Remplir msg pour rejouer à u, qui vient de se connecter, l'historique
+ * de son salon numéro i : ce qu'il a manqué s'il reprend sa session (voir
+ * session.h), avec un avis après le dernier salon. Appelé par le thread
+ * qui lit la socket de u, pour chacun de ses salons */
+void login_replay(struct user *u, size_t i, struct message_info *msg);
+
+/** Remettre le message privé msg à son destinataire, nommé dans sa trame,
+ * s'il est connecté et servi par owner (-1 : l'appelant sert tout le
+ * monde), sinon le déposer dans sa boîte (voir mailbox.h). Un avis est
+ * renvoyé à l'émetteur si le message est gardé ou perdu, sauf si
+ * msg->sender est NULL
+ * retourne le réacteur du destinataire s'il est servi par un autre, -1
+ * sinon */
+int send_private(struct message_info *msg, int owner,
+                 struct flush_batch *batch);
+
+/** Mettre dans la file de u, qui vient de se connecter, les messages privés
+ * gardés dans sa boîte pendant son absence, après l'historique de ses
+ * salons ; les suivants lui sont remis en direct. Appelé par le thread qui
+ * remplit sa file d'envoi (voir mailbox_take) */
+void login_mailbox(struct user *u, struct flush_batch *batch);
+
+/* Ouvre le lot s'il est vide : son plafond court à partir de maintenant */
+void batch_begin(struct flush_batch *batch);
+
+/* Ajoute u aux destinataires du lot, une seule fois */
+void batch_add(struct flush_batch *batch, struct user *u);
+
+/* Retire u du lot, avant de le libérer */
+void batch_remove(struct flush_batch *batch, struct user *u);
+
+/** Indique si le lot doit partir : toujours sans fenêtre, sinon lorsque la
+ * dernière attente s'est terminée sans nouveau message (idle non nul) ou que
+ * le plafond est atteint */
+int batch_due(struct flush_batch *batch, int idle);
+
+/** Délai d'attente d'autres messages avant l'envoi du lot, en µs, ou -1 si
+ * le lot est vide */
+long batch_timeout(struct flush_batch *batch);
+
+/* Envoie la file de chaque destinataire du lot puis met à jour ses
+ * événements dans epollFD, et vide le lot */
+void batch_flush(struct flush_batch *batch, int epollFD, uint32_t baseEvents);
+
+/** Horloge monotone, en microsecondes */
+uint64_t now_us(void);
+
+/** epoll_wait avec un délai en microsecondes (-1 : pas de limite) */
+int wait_events(int epollFD, struct epoll_event *events, int maxEvents,
+                long timeoutUs);
+
+/** Après un user_accept en échec, retirer la socket d'écoute listenFD de
+ * epollFD si les descripteurs manquent (voir user_accept_starved) : la
+ * connexion en attente y réveillerait la boucle sans fin. *resume reçoit
+ * l'instant de sa reprise */
+void accept_pause(int epollFD, int listenFD, uint64_t *resume);
+
+/** Remettre listenFD dans epollFD (pointeur NULL) une fois passé l'instant
+ * *resume, s'il n'est pas nul
+ * retourne timeoutUs, réduit au délai restant avant la reprise */
+long accept_resume(int epollFD, int listenFD, uint64_t *resume,
+                   long timeoutUs);
+
+/** Inscrire u dans epollFD pour baseEvents, plus EPOLLOUT tant que sa file
+ * d'envoi n'est pas vide (u est retiré de epollFD s'il n'y a plus rien à
+ * surveiller) */
+void user_update_events(struct user *u, int epollFD, uint32_t baseEvents);
+
+/* Déconnecte un client dont la file d'envoi est saturée */
+void disconnect_lagging(struct user *u);
+
+/** Construit le message à partir du texte envoyé par u : une diffusion dans
+ * son salon courant, mise en forme une fois pour tous les destinataires et
+ * à numéroter par room_publish, un message privé, ou la réponse à une
+ * commande de salon (ou l'avis qu'il n'est dans aucun salon) à lui
+ * renvoyer, précédée de l'historique du salon qu'il vient de rejoindre */
+void build_message(struct user *u, char *text, struct message_info *msg);
+
+/** Traiter la commande "/msg pseudo texte" de u : msg reçoit le message
+ * privé à remettre, ou l'avis à lui renvoyer si la commande est mal formée
+ * retourne 0, ou -1 si text n'est pas cette commande */
+int private_command(struct user *u, char *text, struct message_info *msg);
+
+/** Traiter les commandes /join #salon, /part [#salon] et /history de u (voir
+ * history.h) ; *joined
+ * reçoit le salon dont u vient de devenir membre, NULL sinon
+ * retourne la réponse à envoyer à u, ou NULL si text n'est pas une commande
+ * de salon */
+struct payload *room_command(struct user *u, char *text,
+                             struct room **joined);
 
-/* Envoie un message à tous les utilisateurs connectés sauf l'émetteur */
-void send_messageAll(LIST *users, char *message, int sender_socket);
+/** Répondre à la proposition de pseudo nick de u
+ * retourne le status envoyé au client (0 si accepté, le pseudo est alors
+ * réservé pour u dans l'annuaire) */
+int answer_nickname(struct user *u, char *nick);
 
-/** demander au client de saisir un username*/
-void ask_username(int client, char *username, size_t size);
+/** Retourner la prochaine commande reçue de u (ligne ou trame selon son
+ * protocole), en lisant sa socket autant que nécessaire (bloquant, ou en
+ * cédant la main dans une coroutine), ou NULL si la connexion est terminée */
+char *next_input(struct user *u);
 
-/** Vérifier la validité du pseudo */
+/** Vérifier la forme du pseudo : 0 s'il est valide, 2 sinon. Sa
+ * disponibilité est vérifiée lors de la réservation */
 int check_nickname(char *buffer, size_t size);
 
-/* Envoie un message d'erreur au client */
-void send_error_nickname(int client, int status);
+/* Envoie au client la réponse à sa proposition de pseudo */
+void send_error_nickname(struct user *u, int status);
 
 /* Vérifie si la commande est une commande de déconnexion */
 int is_exit_command(char *buffer);
 
-/* Fonction de gestion des signaux */
-void on_exit(int signum);
+/* Thread des signaux de handled, bloqués dans tous les autres : affiche les
+ * compteurs du serveur (SIGUSR1), et arrête le serveur après avoir
+ * synchronisé le journal (SIGINT) */
+void *signal_thread(void *handled);
 
 #endif  // SERVEUR_H
@@ -0,0 +1,46 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "room.h"
+#include "user.h"
+
+#define SESSION_TTL 300         /* s pendant lesquelles une session reste */
+#define SESSION_MAX 65536       /* sessions gardées au plus */
+#define SESSION_TABLE_SIZE 4096 /* listes de la table des jetons */
+
+/** Reprise de session après une coupure
+ *
+ * À la connexion, chaque client reçoit un jeton aléatoire (trame
+ * FRAME_SESSION en v2, voir frame.h). À son départ, sa session (pseudo et
+ * salons) est gardée sous ce jeton pendant SESSION_TTL secondes. Un client
+ * qui revient dans ce délai propose son pseudo suivi du jeton et du numéro
+ * du dernier message reçu ("pseudo jeton numéro") : il retrouve ses salons
+ * et ne reçoit que ce qu'il a manqué (voir room_history), puis un nouveau
+ * jeton. Un jeton ne sert qu'une fois et seulement pour le même pseudo.
+ *
+ * Les sessions sont gardées dans l'ordre des départs, qui est aussi celui
+ * de leurs échéances : les plus anciennes sont retirées d'abord, et au-delà
+ * de SESSION_MAX sessions avant leur échéance.
+ *
+ * Toutes les fonctions commencent par le préfixe "session_". */
+
+/** Tirer un nouveau jeton dans u->token
+ * retourne 0, ou -1 si le système ne fournit pas d'aléa */
+int session_issue(struct user *u);
+
+/** Garder la session de u sous son jeton, avant qu'il ne quitte ses salons
+ * et l'annuaire. Sans jeton ou sans pseudo accepté, rien n'est gardé */
+void session_save(struct user *u);
+
+/** Reprendre la session gardée sous token pour le pseudo nick : ses salons
+ * sont copiés dans *rooms, tableau alloué à libérer par free, et la session
+ * est oubliée
+ * retourne le nombre de salons, ou -1 si le jeton est inconnu, expiré ou
+ * d'un autre pseudo */
+ssize_t session_resume(const char *token, const char *nick,
+                       struct room ***rooms);
+
+#endif  // SESSION_H
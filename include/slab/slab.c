@@ -0,0 +1,247 @@
+#include "slab.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+/* Taille d'un bloc découpé en objets, qui en contient au moins SLAB_BATCH */
+#define CHUNK_SIZE (64 * 1024)
+
+/* Alignement des objets, comme malloc */
+#define ALIGN 16
+
+/* Les blocs commencent sur une ligne de cache, et leurs objets aussi si leur
+ * taille en est un multiple */
+#define CACHE_LINE 64
+
+/* Un objet libre sert de maillon à la liste qui le contient */
+struct free_obj {
+    struct free_obj *next;
+};
+
+/* En-tête d'un bloc, suivi de ses objets */
+struct chunk {
+    struct chunk *next;
+};
+
+#define CHUNK_HEADER CACHE_LINE
+
+/* Objets libres gardés par un thread, sans verrou */
+struct slab_cache {
+    Slab *slab;
+    struct free_obj *head;
+    unsigned count;
+};
+
+struct slab {
+    const char *name;
+    size_t size;
+    size_t perChunk;
+    pthread_key_t key;
+
+    // Liste commune et blocs, partagés entre les threads
+    pthread_mutex_t mutex;
+    struct free_obj *free;
+    struct chunk *chunks;
+    size_t nbChunks;
+
+    size_t live;
+    size_t highWater;
+
+    struct slab *next; /* réserves existantes, pour slab_print */
+};
+
+static pthread_mutex_t mutexAll = PTHREAD_MUTEX_INITIALIZER;
+static Slab *all;
+
+/* Rend à la liste commune les count premiers objets du cache */
+static void cache_flush(struct slab_cache *c, unsigned count) {
+    if (count == 0) return;
+
+    struct free_obj *first = c->head, *last = c->head;
+    for (unsigned i = 1; i < count; i++) last = last->next;
+    c->head = last->next;
+    c->count -= count;
+
+    Slab *s = c->slab;
+    pthread_mutex_lock(&s->mutex);
+    last->next = s->free;
+    s->free = first;
+    pthread_mutex_unlock(&s->mutex);
+}
+
+/* Vide le cache d'un thread qui se termine */
+static void release_cache(void *cache) {
+    struct slab_cache *c = cache;
+    cache_flush(c, c->count);
+    free(c);
+}
+
+Slab *slab_create(const char *name, size_t size) {
+    Slab *s = calloc(1, sizeof(Slab));
+    if (!s) return NULL;
+
+    if (pthread_key_create(&s->key, release_cache) != 0) {
+        free(s);
+        return NULL;
+    }
+    pthread_mutex_init(&s->mutex, NULL);
+
+    // Un objet libre doit pouvoir contenir son maillon
+    if (size < sizeof(struct free_obj)) size = sizeof(struct free_obj);
+    s->name = name;
+    s->size = (size + ALIGN - 1) / ALIGN * ALIGN;
+    s->perChunk = (CHUNK_SIZE - CHUNK_HEADER) / s->size;
+    if (s->perChunk < SLAB_BATCH) s->perChunk = SLAB_BATCH;
+
+    pthread_mutex_lock(&mutexAll);
+    s->next = all;
+    all = s;
+    pthread_mutex_unlock(&mutexAll);
+    return s;
+}
+
+void slab_free(Slab *s) {
+    if (!s) return;
+
+    pthread_mutex_lock(&mutexAll);
+    Slab **prev = &all;
+    while (*prev != s) prev = &(*prev)->next;
+    *prev = s->next;
+    pthread_mutex_unlock(&mutexAll);
+
+    // Seul le cache du thread appelant est encore joignable
+    free(pthread_getspecific(s->key));
+    pthread_key_delete(s->key);
+
+    while (s->chunks) {
+        struct chunk *c = s->chunks;
+        s->chunks = c->next;
+        free(c);
+    }
+
+    pthread_mutex_destroy(&s->mutex);
+    free(s);
+}
+
+/* Cache du thread courant, créé au premier appel */
+static struct slab_cache *get_cache(Slab *s) {
+    struct slab_cache *c = pthread_getspecific(s->key);
+    if (c) return c;
+
+    c = calloc(1, sizeof(*c));
+    if (!c) return NULL;
+    c->slab = s;
+    if (pthread_setspecific(s->key, c) != 0) {
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+/* Découpe un nouveau bloc dans la liste commune, verrou pris
+ * retourne -1 si la mémoire manque */
+static int add_chunk(Slab *s) {
+    struct chunk *c;
+    if (posix_memalign((void **)&c, CACHE_LINE,
+                       CHUNK_HEADER + s->perChunk * s->size) != 0)
+        return -1;
+
+    c->next = s->chunks;
+    s->chunks = c;
+    __atomic_add_fetch(&s->nbChunks, 1, __ATOMIC_RELAXED);
+
+    char *objs = (char *)c + CHUNK_HEADER;
+    for (size_t i = s->perChunk; i > 0; i--) {
+        struct free_obj *o = (struct free_obj *)(objs + (i - 1) * s->size);
+        o->next = s->free;
+        s->free = o;
+    }
+    return 0;
+}
+
+/* Remplit le cache vide d'un lot pris dans la liste commune */
+static void cache_refill(struct slab_cache *c) {
+    Slab *s = c->slab;
+
+    pthread_mutex_lock(&s->mutex);
+    if (s->free || add_chunk(s) == 0) {
+        struct free_obj *first = s->free, *last = s->free;
+        unsigned count = 1;
+        while (count < SLAB_BATCH && last->next) {
+            last = last->next;
+            count++;
+        }
+        s->free = last->next;
+        last->next = NULL;
+        c->head = first;
+        c->count = count;
+    }
+    pthread_mutex_unlock(&s->mutex);
+}
+
+void *slab_alloc(Slab *s) {
+    struct slab_cache *c = get_cache(s);
+    if (!c) return NULL;
+
+    if (!c->head) cache_refill(c);
+    struct free_obj *o = c->head;
+    if (!o) return NULL;
+    c->head = o->next;
+    c->count--;
+
+    size_t live = __atomic_add_fetch(&s->live, 1, __ATOMIC_RELAXED);
+    size_t high = __atomic_load_n(&s->highWater, __ATOMIC_RELAXED);
+    while (live > high &&
+           !__atomic_compare_exchange_n(&s->highWater, &high, live, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+    return o;
+}
+
+void slab_release(Slab *s, void *ptr) {
+    if (!ptr) return;
+    __atomic_sub_fetch(&s->live, 1, __ATOMIC_RELAXED);
+
+    struct free_obj *o = ptr;
+    struct slab_cache *c = get_cache(s);
+    if (!c) {
+        // Sans cache, directement dans la liste commune
+        pthread_mutex_lock(&s->mutex);
+        o->next = s->free;
+        s->free = o;
+        pthread_mutex_unlock(&s->mutex);
+        return;
+    }
+
+    o->next = c->head;
+    c->head = o;
+    c->count++;
+
+    // Un thread qui libère plus qu'il n'alloue rend l'excédent par lots
+    if (c->count >= 2 * SLAB_BATCH) cache_flush(c, SLAB_BATCH);
+}
+
+size_t slab_size(const Slab *s) { return s->size; }
+
+size_t slab_live(const Slab *s) {
+    return __atomic_load_n(&s->live, __ATOMIC_RELAXED);
+}
+
+size_t slab_high_water(const Slab *s) {
+    return __atomic_load_n(&s->highWater, __ATOMIC_RELAXED);
+}
+
+size_t slab_reserved(const Slab *s) {
+    size_t nbChunks = __atomic_load_n(&s->nbChunks, __ATOMIC_RELAXED);
+    return nbChunks * (CHUNK_HEADER + s->perChunk * s->size);
+}
+
+void slab_print(FILE *out) {
+    pthread_mutex_lock(&mutexAll);
+    for (Slab *s = all; s; s = s->next) {
+        fprintf(out, "slab_%s_live %zu\n", s->name, slab_live(s));
+        fprintf(out, "slab_%s_high %zu\n", s->name, slab_high_water(s));
+        fprintf(out, "slab_%s_bytes %zu\n", s->name, slab_reserved(s));
+    }
+    pthread_mutex_unlock(&mutexAll);
+}
@@ -0,0 +1,71 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/** Réserves d'objets de taille fixe
+ *
+ * Slab est un type opaque représentant une réserve d'objets tous de la même
+ * taille, découpés dans de grands blocs jamais rendus au système : les
+ * connexions et les messages qui vont et viennent réutilisent toujours les
+ * mêmes emplacements au lieu de morceler le tas.
+ *
+ * Toutes les fonctions de cette bibliothèque commencent par le préfixe
+ * "slab_". À part slab_create et slab_print, elles prennent toutes un
+ * pointeur vers une réserve en premier argument.
+ *
+ * Chaque thread garde un petit cache d'objets libres : slab_alloc et
+ * slab_release ne prennent le verrou de la réserve que pour échanger un lot
+ * d'objets avec la liste commune, quand ce cache est vide ou trop plein. Un
+ * objet peut être rendu par un autre thread que celui qui l'a obtenu, et le
+ * cache d'un thread qui se termine retourne dans la liste commune.
+ *
+ *   Slab *s = slab_create("node", sizeof(struct node));
+ *   struct node *n = slab_alloc(s);
+ *   ...
+ *   slab_release(s, n);
+ *
+ * Les objets sont alignés comme ceux de malloc, et sur une ligne de cache
+ * (64 octets) si leur taille en est un multiple. Comme malloc, slab_alloc
+ * retourne un objet non initialisé, ou NULL si la mémoire manque. */
+
+typedef struct slab Slab;
+
+/* Objets demandés à la liste commune par un cache vide, rendus par un cache
+ * plein */
+#define SLAB_BATCH 32
+
+/** Créer une réserve d'objets de size octets, nommée name dans les
+ * statistiques (name n'est pas copié)
+ * retourne NULL en cas d'erreur */
+Slab *slab_create(const char *name, size_t size);
+
+/** Libérer la réserve et tous ses blocs. Plus aucun thread ne doit
+ * l'utiliser, ni tenir d'objet qui en vient */
+void slab_free(Slab *s);
+
+/** Retourner un objet de la réserve, ou NULL si la mémoire manque */
+void *slab_alloc(Slab *s);
+
+/** Rendre à la réserve ptr, obtenu par slab_alloc(s). Ne fait rien si ptr
+ * vaut NULL */
+void slab_release(Slab *s, void *ptr);
+
+/** Retourner la taille des objets de la réserve */
+size_t slab_size(const Slab *s);
+
+/** Retourner le nombre d'objets actuellement obtenus et pas encore rendus */
+size_t slab_live(const Slab *s);
+
+/** Retourner le plus grand nombre d'objets obtenus en même temps */
+size_t slab_high_water(const Slab *s);
+
+/** Retourner la mémoire réservée par les blocs de la réserve, en octets */
+size_t slab_reserved(const Slab *s);
+
+/** Écrire les statistiques de toutes les réserves existantes, une par ligne
+ * "slab_<nom>_<statistique> valeur" (live, high et bytes), dans out */
+void slab_print(FILE *out);
+
+#endif  // SLAB_H
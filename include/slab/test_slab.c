@@ -0,0 +1,143 @@
+#include "slab.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define NB_THREADS 4
+#define NB_OBJECTS 100000
+#define NB_HELD 1000
+
+/* an object passed from one thread to another */
+struct object {
+	uint64_t owner;
+	char pad[40];
+};
+
+/* allocates and releases objects, keeping up to NB_HELD at a time */
+void *churn(void *arg);
+
+/* releases the objects allocated by the main thread */
+void *release_all(void *arg);
+
+static Slab *slab;
+
+int main(void)
+{
+	/* single thread tests */
+	slab = slab_create("test", sizeof(struct object));
+	assert(slab != NULL);
+	assert(slab_size(slab) >= sizeof(struct object));
+	assert(slab_size(slab) % 16 == 0);
+	assert(slab_live(slab) == 0);
+	assert(slab_reserved(slab) == 0);
+
+	/* objects are distinct, aligned and writable */
+	struct object *objs[NB_HELD];
+	for (int i = 0; i < NB_HELD; i++) {
+		objs[i] = slab_alloc(slab);
+		assert(objs[i] != NULL);
+		assert((uintptr_t)objs[i] % 16 == 0);
+		memset(objs[i], 0, sizeof(struct object));
+		objs[i]->owner = i;
+	}
+	for (int i = 0; i < NB_HELD; i++)
+		assert(objs[i]->owner == (uint64_t)i);
+	assert(slab_live(slab) == NB_HELD);
+	assert(slab_high_water(slab) == NB_HELD);
+	size_t reserved = slab_reserved(slab);
+	assert(reserved >= NB_HELD * sizeof(struct object));
+
+	/* released objects are reused without growing the slab */
+	for (int i = 0; i < NB_HELD; i++)
+		slab_release(slab, objs[i]);
+	slab_release(slab, NULL);
+	assert(slab_live(slab) == 0);
+	for (int i = 0; i < NB_HELD; i++)
+		objs[i] = slab_alloc(slab);
+	assert(slab_reserved(slab) == reserved);
+	for (int i = 0; i < NB_HELD; i++)
+		slab_release(slab, objs[i]);
+	assert(slab_high_water(slab) == NB_HELD);
+
+	/* objects whose size is a multiple of a cache line are aligned on one */
+	Slab *lines = slab_create("lines", 128);
+	for (int i = 0; i < NB_HELD; i++) {
+		objs[i] = slab_alloc(lines);
+		assert((uintptr_t)objs[i] % 64 == 0);
+	}
+	for (int i = 0; i < NB_HELD; i++)
+		slab_release(lines, objs[i]);
+	slab_free(lines);
+
+	/* statistics are printed by name */
+	char line[256];
+	FILE *out = fmemopen(line, sizeof(line), "w");
+	slab_print(out);
+	fclose(out);
+	assert(strstr(line, "slab_test_live 0\n") != NULL);
+	assert(strstr(line, "slab_test_high 1000\n") != NULL);
+	printf("single thread: ok\n");
+
+	/* objects allocated here are released by another thread */
+	for (int i = 0; i < NB_HELD; i++)
+		objs[i] = slab_alloc(slab);
+	pthread_t releaser;
+	pthread_create(&releaser, NULL, release_all, objs);
+	pthread_join(releaser, NULL);
+	assert(slab_live(slab) == 0);
+
+	/* the cache of a finished thread went back to the slab: the same
+	 * objects serve again */
+	for (int i = 0; i < NB_HELD; i++)
+		objs[i] = slab_alloc(slab);
+	assert(slab_reserved(slab) == reserved);
+	for (int i = 0; i < NB_HELD; i++)
+		slab_release(slab, objs[i]);
+	printf("cross thread: ok\n");
+
+	/* several threads churn through the same slab: no object is ever
+	 * handed to two threads at once */
+	pthread_t threads[NB_THREADS];
+	for (int i = 0; i < NB_THREADS; i++)
+		pthread_create(&threads[i], NULL, churn, (void *)(uintptr_t)i);
+	for (int i = 0; i < NB_THREADS; i++)
+		pthread_join(threads[i], NULL);
+	assert(slab_live(slab) == 0);
+	assert(slab_high_water(slab) <= NB_THREADS * NB_HELD);
+	assert(slab_reserved(slab) <= 2 * NB_THREADS * NB_HELD *
+		slab_size(slab) + reserved);
+
+	slab_free(slab);
+	printf("%d threads: ok\n", NB_THREADS);
+
+	return 0;
+}
+
+void *churn(void *arg)
+{
+	uint64_t me = (uintptr_t)arg + 1;
+	struct object *held[NB_HELD];
+
+	for (int i = 0; i < NB_OBJECTS / NB_HELD; i++) {
+		for (int j = 0; j < NB_HELD; j++) {
+			held[j] = slab_alloc(slab);
+			assert(held[j] != NULL);
+			held[j]->owner = me;
+		}
+		for (int j = 0; j < NB_HELD; j++) {
+			assert(held[j]->owner == me);
+			slab_release(slab, held[j]);
+		}
+	}
+	return NULL;
+}
+
+void *release_all(void *arg)
+{
+	struct object **objs = arg;
+	for (int i = 0; i < NB_HELD; i++)
+		slab_release(slab, objs[i]);
+	return NULL;
+}
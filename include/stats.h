@@ -0,0 +1,42 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+/** Compteurs d'événements du serveur, incrémentés de façon atomique depuis
+ * n'importe quel thread. */
+
+enum stat_id {
+    STAT_LAG_DROPPED,      /* messages abandonnés pour un client en retard */
+    STAT_LAG_COALESCED,    /* files en retard résumées en un avertissement */
+    STAT_LAG_SKIPPED,      /* messages retirés par ces résumés */
+    STAT_LAG_DISCONNECTED, /* clients déconnectés pour retard */
+    STAT_MESSAGES,         /* messages reçus pour diffusion */
+    STAT_SEND_CALLS,       /* appels à sendmsg vers les clients */
+    STAT_RECV_CALLS,       /* lectures sur les sockets des clients */
+    STAT_WAIT_CALLS,       /* attentes d'événements (epoll, poll, io_uring) */
+    STAT_RING_OPS,         /* opérations déposées dans io_uring, sans appel */
+    STAT_BATCHES,          /* lots d'envoi regroupés */
+    STAT_HANDSHAKE_EXPIRED, /* clients sans pseudo à leur échéance */
+    STAT_REPLAYED,         /* messages d'historique rejoués aux arrivants */
+    STAT_HISTORY_SENT,     /* messages du journal envoyés par /history */
+    STAT_SESSIONS_RESUMED, /* sessions reprises avec leur jeton */
+    STAT_MAIL_QUEUED,      /* messages privés déposés dans une boîte */
+    STAT_MAIL_DELIVERED,   /* messages de boîte remis à la connexion */
+    STAT_MAIL_EVICTED,     /* messages de boîtes déchargés sur disque */
+    STAT_MAIL_DROPPED,     /* messages privés perdus, boîte pleine ou
+                              sans dossier de décharge */
+    STAT_COUNT
+};
+
+/** Ajouter n au compteur id */
+void stats_add(enum stat_id id, long n);
+
+/** Retourner la valeur courante du compteur id */
+long stats_get(enum stat_id id);
+
+/** Écrire tous les compteurs, un par ligne "nom valeur", dans out, suivis
+ * des statistiques des réserves d'objets (voir slab.h) */
+void stats_print(FILE *out);
+
+#endif  // STATS_H
@@ -0,0 +1,88 @@
+#ifndef URING_H
+#define URING_H
+
+#include "serveur.h"
+
+#define URING_ENTRIES 1024   /* file de soumission */
+#define URING_NB_BUFS 512    /* tampons de réception partagés (puissance de 2) */
+#define URING_BUF_SIZE 4096  /* une trame entière tient dans un tampon */
+#define URING_BUF_GROUP 0
+#define URING_SEND_IOV 1024  /* messages par sendmsg (UIO_MAXIOV) */
+#define URING_SEND_CHAIN 64  /* sendmsg liés au plus par envoi d'une file */
+
+/*================== Boucle io_uring ==================*/
+/** Mode uring : une seule boucle, comme un réacteur epoll, mais les appels
+ * système de chaque tour sont regroupés en un seul io_uring_enter :
+ * - une acceptation multishot produit toutes les nouvelles connexions ;
+ * - une réception multishot par client, dans des tampons fournis par le
+ *   serveur et partagés entre tous les clients : un client inactif ne
+ *   retient aucun tampon ;
+ * - les envois d'une diffusion sont déposés ensemble, un sendmsg par
+ *   destinataire (une chaîne de sendmsg liés pour une longue file), et
+ *   partent avec l'attente du tour suivant.
+ *
+ * Les anneaux sont manipulés directement (appels système io_uring_setup,
+ * io_uring_enter et io_uring_register), sans liburing. */
+struct uring_loop {
+    int ringFD;
+    int listenFD;
+
+    // File de soumission
+    unsigned *sqHead, *sqTail, *sqMask;
+    struct io_uring_sqe *sqes;
+    unsigned sqLocalTail; /* entrées préparées, pas encore publiées */
+
+    // File de complétion
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+
+    // Anneau des tampons de réception rendus au noyau
+    struct io_uring_buf_ring *bufRing;
+    char *bufs;
+    unsigned short bufTail;
+
+    // Destinataires à envoyer à la fin du tour, envois libres
+    struct flush_batch batch;
+    struct uring_send *freeSends;
+
+    // Clients qui n'ont pas encore de pseudo
+    struct handshake_queue pending;
+};
+
+/** Lancer la boucle io_uring sur listenFD. Les messages sont diffusés depuis
+ * la boucle, sans répéteur
+ * retourne -1 si io_uring n'est pas disponible (noyau trop ancien ou
+ * interdit, en-têtes absents à la compilation), avant d'avoir accepté qui
+ * que ce soit ; ne retourne pas sinon */
+int uring_run(int listenFD);
+
+/** Créer les anneaux et enregistrer les tampons de réception
+ * retourne 0, ou -1 si une fonction nécessaire manque */
+int uring_setup(struct uring_loop *l, int listenFD);
+
+/* Traite la complétion d'une acceptation */
+void uring_accept(struct uring_loop *l, int res, unsigned flags);
+
+/* Traite la complétion d'une réception sur la socket de u */
+void uring_recv(struct uring_loop *l, struct user *u, int res, unsigned flags);
+
+/* Découpe et traite les len octets reçus de u */
+void uring_input(struct uring_loop *l, struct user *u, const char *data,
+                 size_t len);
+
+/** Traite une commande complète (ligne ou trame) reçue d'un utilisateur
+ * connecté
+ * retourne -1 si l'utilisateur a été fermé, 0 sinon */
+int uring_line(struct uring_loop *l, struct user *u, char *line);
+
+/* Dépose l'envoi de la file de u, s'il n'y en a pas déjà un en cours */
+void uring_send(struct uring_loop *l, struct user *u);
+
+/* Envoie la file de chaque destinataire du lot, et vide le lot */
+void uring_flush(struct uring_loop *l);
+
+/* Retire u des ensembles de diffusion et interrompt sa connexion ; il est
+ * libéré lorsque plus aucune opération en cours ne le désigne */
+void uring_close(struct uring_loop *l, struct user *u);
+
+#endif  // URING_H
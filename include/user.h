@@ -9,22 +9,103 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include "buffer/buffer.h"
+#include "frame/frame.h"
 #include "list/list.h"
+#include "outq.h"
 
-struct user {
-    char *username;
+/* Plus longue ligne reçue d'un client, les plus longues sont coupées. Une
+ * trame entière doit aussi y tenir */
+#define USER_LINE_SIZE FRAME_MAX_SIZE
 
-    struct sockaddr *address;
-    socklen_t addr_len;
-    int sock;
+/* Tampon de réception avant le choix du pseudo : assez pour la négociation
+ * du protocole et un pseudo, agrandi à USER_LINE_SIZE une fois connecté */
+#define HANDSHAKE_BUFFER_SIZE 128
+
+/* Place du pseudo (nul final compris), dans la structure elle-même */
+#define USER_NAME_SIZE 16
+
+/* Jeton de reprise de session : 32 chiffres hexadécimaux et le nul final */
+#define USER_TOKEN_SIZE 33
+
+#define USER_CACHE_LINE 64
+
+/* Pause de l'acceptation quand les descripteurs manquent, en µs */
+#define ACCEPT_PAUSE 100000
+
+struct room;
+
+/* Étape de la connexion d'un utilisateur */
+enum user_state {
+    USER_NICKNAME, /* en attente d'un pseudo valide */
+    USER_CONNECTED, /* authentifié, reçoit les messages diffusés */
+    USER_CLOSING    /* déconnexion demandée, ne reçoit plus rien */
+};
+
+/* Protocole parlé par le client (voir frame.h) */
+enum user_proto {
+    PROTO_V1 = 1, /* lignes de texte */
+    PROTO_V2 = 2  /* trames préfixées par leur taille */
 };
 
+/** Un utilisateur, en un seul bloc aligné sur une ligne de cache
+ *
+ * Les champs sont rangés selon qui les lit : la diffusion d'un message ne
+ * touche que la première ligne de chaque destinataire (socket, état,
+ * protocole, lot et file d'envoi), la lecture de ses commandes la deuxième,
+ * et l'adresse, le pseudo et les salons ne servent qu'à l'arrivée et au
+ * départ. */
+struct user {
+    // Diffusion : exactement une ligne de cache
+    int sock;
+    enum user_state state;
+    enum user_proto proto;
+    int inBatch;       /* déjà dans le lot d'envoi en cours */
+    struct outq outq;  /* messages en attente d'envoi */
+
+    // Lecture et boucles d'événements
+    Buffer *in;        /* octets reçus, découpés au fil des lectures */
+    struct room *room; /* salon où vont ses messages, NULL si aucun */
+    uint32_t events;   /* événements epoll actuellement surveillés */
+    int owner;         /* réacteur qui gère sa socket (mode epoll) */
+    int ioOps;         /* opérations io_uring en cours (mode uring) */
+    int registered;    /* pseudo réservé dans l'annuaire */
+    int mailOpen;      /* boîte relevée : ses messages privés vont en direct */
+    struct user *hsPrev, *hsNext; /* file d'accueil (voir handshake.h) */
+    uint64_t deadline;            /* échéance du choix du pseudo, en µs */
+
+    // Arrivée et départ
+    char username[USER_NAME_SIZE];
+    struct room **rooms; /* salons dont il est membre, le courant en dernier */
+    size_t nbRooms;
+    socklen_t addr_len;  /* 0 si l'adresse est inconnue */
+    struct sockaddr_storage address; /* IPv4 ou IPv6 */
+    char token[USER_TOKEN_SIZE]; /* jeton présenté à l'accueil, puis celui
+                                    de sa session (voir session.h) */
+    uint64_t resumeSeq; /* session reprise : dernier message reçu, 0 sinon */
+} __attribute__((aligned(USER_CACHE_LINE)));
+
 /** accepter une connection TCP depuis la socket d'écoute sl et retourner un
- * pointeur vers un struct user, dynamiquement alloué et convenablement
- * initialisé */
+ * pointeur vers un struct user, pris dans la réserve des utilisateurs (voir
+ * slab.h) et convenablement initialisé, ou NULL si accept échoue (ou n'a
+ * rien à accepter lorsque sl est non bloquante) */
 struct user *user_accept(int sl);
 
-/** libérer toute la mémoire associée à user */
+/** retourner 1 si err, erreur de accept, vient d'un manque de descripteurs
+ * ou de mémoire : la connexion reste en attente et ferait échouer aussitôt
+ * l'essai suivant, l'acceptation doit s'arrêter ACCEPT_PAUSE µs */
+int user_accept_starved(int err);
+
+/** retourner un struct user pris dans la réserve et initialisé pour la
+ * socket sock, déjà acceptée (sans adresse) */
+struct user *user_create(int sock);
+
+/** libérer toute la mémoire associée à user, rendue à sa réserve */
 void user_free(struct user *user);
 
+/** interrompre la connexion de user sans le libérer : sa file d'envoi est
+ * vidée (sauf un envoi io_uring en cours) et il passe dans l'état
+ * USER_CLOSING */
+void user_shutdown(struct user *user);
+
 #endif /* USER_H */
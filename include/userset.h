@@ -0,0 +1,128 @@
+#ifndef USERSET_H
+#define USERSET_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "user.h"
+
+/** Ensembles d'utilisateurs lus sans verrou
+ *
+ * Un ensemble est une table dense en colonnes : la socket, le réacteur,
+ * l'adresse de chaque membre et le premier message qui lui revient sont
+ * rangés dans des tableaux parallèles. Une diffusion parcourt ces colonnes
+ * d'un bout à l'autre et ne touche la struct user que des membres
+ * effectivement servis.
+ *
+ * Le premier message d'un membre sert à l'historique des salons (voir
+ * room.h) : un arrivant ne reçoit en direct que les messages numérotés à
+ * partir de from, les précédents lui sont rejoués. Un membre inscrit avec
+ * USERSET_PENDING ne reçoit rien en direct tant que userset_set_from n'a
+ * pas fixé ce numéro.
+ *
+ * Les diffusions et les contrôles parcourent la version courante sans
+ * jamais prendre de verrou ; seuls les écrivains d'un même ensemble se
+ * sérialisent entre eux. Un index propre aux écrivains donne la ligne de
+ * chaque membre, et la table est tenue à jour sur place en temps constant :
+ * - une arrivée remplit la ligne qui suit la dernière, puis la publie en
+ *   avançant count ;
+ * - un départ reçoit le dernier membre dans sa ligne (retrait par échange,
+ *   l'ordre n'est pas gardé), puis count recule. L'ancienne ligne du
+ *   dernier reste intacte jusqu'à la prochaine arrivée.
+ * Une ligne réécrite passe par une génération impaire : un lecteur qui la
+ * lit pendant ce temps l'ignore. Les lecteurs parcourent la table de la fin
+ * vers le début : un membre ne fait que descendre, de la fin vers un trou,
+ * il ne peut donc pas passer derrière un lecteur sans être vu. Il peut en
+ * revanche être vu deux fois, à son ancienne ligne puis à la nouvelle : le
+ * lecteur écarte un membre déjà servi pour ce message (voir
+ * repeat_member).
+ *
+ * La table change de version quand elle est pleine, ou remplie à moins
+ * d'un quart ; la version remplacée n'est libérée qu'une fois que plus
+ * aucun lecteur ne peut la tenir (récupération par époques, voir epoch.h,
+ * un seul domaine pour tous les ensembles).
+ *
+ *   const struct user_set *set = userset_read_begin(&s);
+ *   for (size_t i = userset_count(set); i-- > 0;) {
+ *       unsigned gen = __atomic_load_n(&set->gens[i], __ATOMIC_ACQUIRE);
+ *       struct user *u = __atomic_load_n(&set->users[i], __ATOMIC_RELAXED);
+ *       __atomic_thread_fence(__ATOMIC_ACQUIRE);
+ *       if (gen & 1 || gen != __atomic_load_n(&set->gens[i],
+ *                                              __ATOMIC_RELAXED))
+ *           continue;
+ *       traiter(u);
+ *   }
+ *   userset_read_end();
+ *
+ * Un ensemble ne possède pas ses utilisateurs : celui qui retire un
+ * utilisateur de tous ses ensembles le confie ensuite à userset_retire, qui
+ * ne le libère que lorsque plus aucun lecteur ne peut l'avoir obtenu d'une
+ * version précédente. */
+
+/* Taille de la plus petite table */
+#define USERSET_MIN_SIZE 16
+
+/* Premier message d'un membre dont l'historique n'a pas encore été rejoué */
+#define USERSET_PENDING UINT64_MAX
+
+struct user_set {
+    size_t count;  /* membres (userset_count) */
+    size_t size;   /* lignes allouées */
+    unsigned *gens; /* génération de chaque ligne, impaire en réécriture */
+    int *socks;    /* socket de chaque membre */
+    int *owners;   /* réacteur qui gère sa socket (voir reactor.h) */
+    uint64_t *from; /* premier message à lui distribuer en direct */
+    struct user **users;
+};
+
+/* Case de l'index des lignes, vide si user est NULL */
+struct userset_slot {
+    struct user *user;
+    size_t row;
+};
+
+struct userset {
+    struct user_set *current;
+    // Ligne de chaque membre : adressage ouvert, suppression par décalage
+    // arrière (comme registry.h), réservé aux écrivains
+    struct userset_slot *index;
+    size_t indexMask;
+    pthread_mutex_t mutexWriters;
+};
+
+/** Initialiser le domaine de récupération commun, une fois au démarrage */
+void userset_setup(void);
+
+/** Initialiser l'ensemble s, vide */
+void userset_init(struct userset *s);
+
+/** Entrer dans une section de lecture et retourner la version courante de
+ * s, valable jusqu'à userset_read_end. Les sections ne s'imbriquent pas */
+const struct user_set *userset_read_begin(struct userset *s);
+
+/** Sortir de la section de lecture */
+void userset_read_end(void);
+
+/** Retourner le nombre de lignes à parcourir dans set, version obtenue par
+ * userset_read_begin, de la dernière à la première */
+size_t userset_count(const struct user_set *set);
+
+/** Ajouter u à s, en fin de table, recevant en direct les messages
+ * numérotés à partir de from (0 : tous), s'il n'y figure pas déjà
+ * retourne 0, ou -1 si l'allocation échoue */
+int userset_add(struct userset *s, struct user *u, uint64_t from);
+
+/** Fixer à from le premier message distribué en direct à u, s'il attend
+ * encore son historique (inscrit avec USERSET_PENDING)
+ * retourne 0, ou -1 si u n'est pas membre de s ou a déjà son numéro */
+int userset_set_from(struct userset *s, struct user *u, uint64_t from);
+
+/** Retirer u de s, s'il y figure, sans parcourir la table */
+void userset_remove(struct userset *s, struct user *u);
+
+/** Libérer u avec user_free dès que plus aucune section de lecture ne peut
+ * le tenir ; u doit déjà avoir été retiré de tous les ensembles */
+void userset_retire(struct user *u);
+
+#endif  // USERSET_H
@@ -4,12 +4,25 @@
 
 /*====== Fonction principale ======*/
 int main(int argc, char *argv[]) {
-    char *host = argc == 3 ? argv[1] : CONNECTION_HOST;
-    uint16_t port = argc == 3 ? atoi(argv[2]) : PORT_FREESCORD;
+    char *nick = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        if (opt != 'n') {
+            fprintf(stderr, "Usage : %s [-n pseudo] [hôte port]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        nick = optarg;
+    }
+
+    int nbArgs = argc - optind;
+    char *host = nbArgs == 2 ? argv[optind] : CONNECTION_HOST;
+    uint16_t port = nbArgs == 2 ? atoi(argv[optind + 1]) : PORT_FREESCORD;
 
     setvbuf(stdout, NULL, _IONBF, 0);
 
     int socketFD = connect_serveur_tcp(host, port);
+    CHECK_ERR(socketFD, "connect");
 
     // Création des buffers
     Buffer *stdinBuf = buff_create(STDIN_FILENO, BUFFER_SIZE);
@@ -19,7 +32,8 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    Buffer *socketBuf = buff_create(socketFD, BUFFER_SIZE);
+    // Une trame entière doit tenir dans le tampon de la socket
+    Buffer *socketBuf = buff_create(socketFD, FRAME_MAX_SIZE);
     if (socketBuf == NULL) {
         fprintf(stderr, "[CLIENT ERROR] - buffer socket\n");
         buff_free(stdinBuf);
@@ -27,9 +41,11 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    welcome_sequence(socketFD);
+    struct client_session session = {.lastSeq = 0};
+    welcome_sequence(socketFD, socketBuf, nick, &session);
     printf("%s", PROMPT);
     fflush(stdout);
+    CHECK_ERR(show_frames(socketBuf, &session), "trame invalide");
 
     struct pollfd fds[] = {{STDIN_FILENO, POLLIN, 0}, {socketFD, POLLIN, 0}};
 
@@ -43,8 +59,17 @@ int main(int argc, char *argv[]) {
             if (handle_stdin(socketFD, stdinBuf) < 0) done = true;
 
         // Gestion des messages du serveur
-        if (buff_ready(socketBuf) || (fds[1].revents & POLLIN))
-            if (handle_socket(socketFD, socketBuf) < 0) done = true;
+        // Les trames déjà reçues sont toutes traitées à chaque lecture
+        if (!done && (fds[1].revents & (POLLIN | POLLHUP)) &&
+            handle_socket(socketFD, socketBuf, &session) < 0) {
+            // Coupure : la session est reprise sur une nouvelle connexion
+            close(socketFD);
+            socketFD = resume_session(host, port, &session, &socketBuf);
+            if (socketFD < 0) break;
+            fds[1].fd = socketFD;
+            printf("%s", PROMPT);
+            if (show_frames(socketBuf, &session) < 0) break;
+        }
     }
 
     buff_free(stdinBuf);
@@ -65,81 +90,131 @@ int connect_serveur_tcp(char *adresse, uint16_t port) {
     int inetRes = inet_pton(AF_INET, adresse, &serverAddr.sin_addr);
     CHECK_ERR(inetRes, "inet_pton");
 
-    int connectRes =
-        connect(socketFD, (struct sockaddr *)&serverAddr, sizeof(serverAddr));
-    CHECK_ERR(connectRes, "connect");
+    if (connect(socketFD, (struct sockaddr *)&serverAddr, sizeof(serverAddr)) <
+        0) {
+        close(socketFD);
+        return -1;
+    }
 
     return socketFD;
 }
 
 /*====== Séquence d'accueil et pseudo ======*/
-void welcome_sequence(int sock) {
-    char buffer[BUFFER_SIZE];
-    int received, sended, status;
-
-    // Message de bienvenue
-    received = recv(sock, buffer, sizeof(buffer) - 1, 0);
-    CHECK_ERR(received, "recv welcome");
-
-    buffer[received] = '\0';
-    printf("%s", buffer);
-    fflush(stdout);
-
-    do {
-        received = recv(sock, buffer, sizeof(buffer) - 1, 0);
-        CHECK_ERR(received, "recv");
-
-        buffer[received] = '\0';
-        printf("%s", buffer);
-        fflush(stdout);
+int wait_ack(Buffer *socketBuf, bool quiet, bool prompt) {
+    char *line;
+    size_t ackLen = strlen(PROTO_ACK);
+
+    // Accueil puis demande du pseudo, sur la même ligne que PROTO_ACK
+    while (1) {
+        while (buff_next_line(socketBuf, &line) < 0)
+            if (buff_read_more(socketBuf) <= 0) return -1;
+
+        size_t lineLen = strlen(line);
+        if (lineLen >= ackLen &&
+            strcmp(line + lineLen - ackLen, PROTO_ACK) == 0) {
+            if (!quiet && prompt)
+                printf("%.*s", (int)(lineLen - ackLen), line);
+            return 0;
+        }
+        if (!quiet) printf("%s\n", line);
+    }
+}
 
-        // Lire le pseudo depuis stdin
-        if (fgets(buffer, sizeof(buffer), stdin) == NULL)
-            CHECK_ERR(-1, "fgets");
-        buffer[strcspn(buffer, "\n")] = '\0';
+void welcome_sequence(int sock, Buffer *socketBuf, const char *nick,
+                      struct client_session *session) {
+    char buffer[BUFFER_SIZE];
+    struct frame f;
+
+    // Demande du protocole v2, avec le pseudo s'il est déjà connu : le
+    // serveur répond après son accueil en texte
+    int len = snprintf(buffer, sizeof(buffer), "%s%s%s\r\n", PROTO_HELLO,
+                       nick ? " " : "", nick ? nick : "");
+    CHECK_ERR(send(sock, buffer, len, 0), "send hello");
+    CHECK_ERR(wait_ack(socketBuf, false, !nick), "recv welcome");
+    if (nick) snprintf(buffer, sizeof(buffer), "%s", nick);
+
+    while (1) {
+        if (!nick) {
+            // Lire le pseudo depuis stdin
+            if (fgets(buffer, sizeof(buffer), stdin) == NULL)
+                CHECK_ERR(-1, "fgets");
+            buffer[strcspn(buffer, "\n")] = '\0';
+
+            CHECK_ERR(send_frame(sock, FRAME_NICK, buffer), "send nickname");
+        }
+        nick = NULL;
 
-        lf_to_crlf(buffer);
-        sended = send(sock, buffer, strlen(buffer), 0);
-        CHECK_ERR(sended, "send nickname");
+        // Réponse du serveur : status dans seq, "status | explications"
+        do {
+            CHECK_ERR(wait_frame(socketBuf, &f), "recv");
+        } while (f.type != FRAME_NICK);
 
-        // Recevoir la réponse du serveur
-        received = recv(sock, buffer, sizeof(buffer) - 1, 0);
-        CHECK_ERR(received, "recv");
-        buffer[received] = '\0';
+        printf("%s\n", f.body);
+        if (f.seq == 0) break;
+        printf("%s", NICKNAME_PROMPT);
+    }
 
-        crlf_to_lf(buffer);
-        printf("%s", buffer);
-        fflush(stdout);
+    strcpy(session->nick, buffer);
+    printf("\n\n");
+}
 
-        // Extraire le status (premier caractère)
-        status = buffer[0] - '0';
-    } while (status != 0);
+/*====== Reprise de session ======*/
+int resume_session(char *host, uint16_t port, struct client_session *session,
+                   Buffer **socketBuf) {
+    char buffer[3 * BUFFER_SIZE];
+
+    if (!session->token[0]) return -1;
+
+    // Le serveur peut ne pas avoir encore vu la coupure : le pseudo est
+    // alors encore pris, la tentative suivante attend un peu plus
+    for (int i = 0; i < RECONNECT_TRIES; i++) {
+        printf("Reconnexion (%d/%d)...\n", i + 1, RECONNECT_TRIES);
+        sleep(1 << i);
+
+        int sock = connect_serveur_tcp(host, port);
+        if (sock < 0) continue;
+        buff_free(*socketBuf);
+        *socketBuf = buff_create(sock, FRAME_MAX_SIZE);
+        CHECK_ERR(*socketBuf ? 0 : -1, "buffer socket");
+
+        int len = snprintf(buffer, sizeof(buffer), "%s %s %s %llu\r\n",
+                           PROTO_HELLO, session->nick, session->token,
+                           (unsigned long long)session->lastSeq);
+        bool ok = send(sock, buffer, len, 0) == len &&
+                  wait_ack(*socketBuf, true, false) >= 0;
+
+        // Réponse au pseudo : status dans seq
+        struct frame f = {0};
+        while (ok && f.type != FRAME_NICK)
+            ok = wait_frame(*socketBuf, &f) >= 0;
+
+        if (ok && f.seq == 0) {
+            printf("Session reprise.\n");
+            return sock;
+        }
+        close(sock);
+    }
 
-    printf("\n\n");
+    return -1;
 }
 
 /*====== Gère les saisies clavier ======*/
 int handle_stdin(int sock, Buffer *stdinBuf) {
     char buffer[BUFFER_SIZE];
-    int sended;
 
     if (buff_fgets(stdinBuf, buffer, sizeof(buffer)) == NULL) return -1;
 
     buffer[strcspn(buffer, "\n")] = '\0';
 
     if (is_exit_command(buffer)) {
-        lf_to_crlf(buffer);
-        sended = send(sock, buffer, strlen(buffer), 0);
-        CHECK_ERR(sended, "send exit");
+        CHECK_ERR(send_frame(sock, FRAME_MSG, buffer), "send exit");
 
         printf("\nDéconnexion...\n");
         close(sock);
         return -1;
     }
 
-    lf_to_crlf(buffer);
-    int sendRes = send(sock, buffer, strlen(buffer), 0);
-    CHECK_ERR(sendRes, "send");
+    CHECK_ERR(send_frame(sock, FRAME_MSG, buffer), "send");
 
     printf("%s", PROMPT);
     fflush(stdout);
@@ -147,28 +222,79 @@ int handle_stdin(int sock, Buffer *stdinBuf) {
 }
 
 /*====== Gère les messages reçus ======*/
-int handle_socket(int sock, Buffer *socketBuf) {
-    char buffer[BUFFER_SIZE];
-
-    if (buff_fgets_crlf(socketBuf, buffer, sizeof(buffer)) == NULL) {
-        if (buff_eof(socketBuf)) {
-            printf("\nLa connexion au serveur a été fermée.\n");
-            return -1;
-        }
-        return 0;
+int handle_socket(int sock, Buffer *socketBuf,
+                  struct client_session *session) {
+    if (buff_read_more(socketBuf) <= 0) {
+        printf("\nLa connexion au serveur a été fermée.\n");
+        return -1;
     }
 
-    crlf_to_lf(buffer);
+    return show_frames(socketBuf, session);
+}
 
-    printf("\r");
-    printf("\033[K");  // Effacer la ligne
-    printf("%s", buffer);
+int show_frames(Buffer *socketBuf, struct client_session *session) {
+    // Toutes les trames complètes, lues directement dans le tampon
+    struct frame f;
+    ssize_t nextRes;
+    while ((nextRes = next_frame(socketBuf, &f)) > 0) {
+        if (f.type == FRAME_SESSION) {
+            // Jusqu'à ce numéro, tout est reçu ou arrive avec l'historique
+            snprintf(session->token, sizeof(session->token), "%s", f.body);
+            session->lastSeq = f.seq;
+            continue;
+        }
 
-    // Réafficher le prompt
-    printf("%s", PROMPT);
+        printf("\r");
+        printf("\033[K");  // Effacer la ligne
+        if (f.type == FRAME_MSG) {
+            printf("%s %s: %s\n", f.room, f.sender, f.body);
+            if (f.seq > session->lastSeq) session->lastSeq = f.seq;
+        } else if (f.type == FRAME_PRIVATE) {
+            printf("[privé] %s: %s\n", f.sender, f.body);
+        } else if (f.type == FRAME_NOTICE) {
+            printf("*** %s ***\n", f.body);
+        }
+
+        // Réafficher le prompt
+        printf("%s", PROMPT);
+    }
     fflush(stdout);
 
+    if (nextRes < 0) {
+        printf("\nTrame invalide reçue du serveur.\n");
+        return -1;
+    }
+
     return 0;
 }
 
+/*====== Trames ======*/
+int send_frame(int sock, enum frame_type type, const char *text) {
+    char frame[FRAME_MAX_SIZE];
+    struct frame f = {.type = type, .body = text, .bodyLen = strlen(text)};
+
+    size_t size = frame_encode(&f, frame);
+    if (size == 0) return -1;
+
+    return send(sock, frame, size, 0) == (ssize_t)size ? 0 : -1;
+}
+
+ssize_t next_frame(Buffer *b, struct frame *f) {
+    char *data;
+    size_t len = buff_peek(b, &data);
+
+    ssize_t size = frame_decode(data, len, f);
+    if (size > 0) buff_consume(b, size);
+    return size;
+}
+
+int wait_frame(Buffer *b, struct frame *f) {
+    ssize_t nextRes;
+
+    while ((nextRes = next_frame(b, f)) == 0)
+        if (buff_read_more(b) <= 0) return -1;
+
+    return nextRes < 0 ? -1 : 0;
+}
+
 int is_exit_command(char *buffer) { return (strcmp(buffer, "/exit") == 0); }
\ No newline at end of file
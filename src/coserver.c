@@ -0,0 +1,71 @@
+#include "../include/coserver.h"
+
+#include <errno.h>
+#include <fcntl.h>
+
+static CoroSched *sched;
+
+// Clients sans pseudo : chaque coroutine surveille elle-même son échéance
+static struct handshake_queue pending;
+
+void coserver_run(int listenFD) {
+    int flags = fcntl(listenFD, F_GETFL, 0);
+    int fcntlRes = fcntl(listenFD, F_SETFL, flags | O_NONBLOCK);
+    CHECK_ERR(fcntlRes, "fcntl");
+
+    sched = coro_sched_create(config.stackSize);
+    if (!sched) CHECK_ERR(-1, "coro_sched_create");
+
+    if (coro_spawn(sched, coserver_accept, &listenFD) < 0)
+        CHECK_ERR(-1, "coro_spawn");
+    CHECK_ERR(coro_sched_run(sched), "coro_sched_run");
+}
+
+void coserver_accept(void *listenFD) {
+    int sl = *(int *)listenFD;
+
+    while (1) {
+        // Faute de descripteurs, la connexion en attente garde sl prête :
+        // on attend seulement l'échéance de la pause
+        struct user *u = user_accept(sl);
+        if (!u) {
+            if (user_accept_starved(errno))
+                coro_wait_fd(sl, 0, now_us() + ACCEPT_PAUSE);
+            else
+                coro_wait_fd(sl, CORO_READ, 0);
+            continue;
+        }
+
+        // Les lectures qui bloqueraient rendent la main à l'ordonnanceur
+        int flags = fcntl(u->sock, F_GETFL, 0);
+        if (fcntl(u->sock, F_SETFL, flags | O_NONBLOCK) < 0 ||
+            coro_spawn(sched, coserver_client, u) < 0) {
+            perror("coro_spawn");
+            user_free(u);
+        }
+    }
+}
+
+void coserver_client(void *user) {
+    struct user *u = user;
+
+    // Accueil, jusqu'au pseudo accepté ou à l'échéance
+    handshake_start(&pending, u);
+
+    int hsRes;
+    while ((hsRes = handshake_read(&pending, u)) == 0) {
+        if (coro_wait_fd(u->sock, CORO_READ, u->deadline) < 0) {
+            handshake_remove(&pending, u);
+            stats_add(STAT_HANDSHAKE_EXPIRED, 1);
+            hsRes = -1;
+            break;
+        }
+    }
+
+    if (hsRes < 0) {
+        user_free(u);
+        return;
+    }
+
+    handle_client(u);
+}
@@ -11,6 +11,9 @@ static const char *user_colors[] = {"#FF6B6B", "#4ECDC4", "#45B7D1", "#96CEB4",
                                     "#BB9AF7", "#7AA2F7"};
 static const int num_user_colors = sizeof(user_colors) / sizeof(user_colors[0]);
 
+// Réserve des messages passés du thread de réception au thread principal
+static Slab *message_slab;
+
 // Déclarations de fonctions statiques
 static MessageData *create_message_data(FreescordApp *app,
                                         const char *timestamp,
@@ -20,7 +23,11 @@ static void free_message_data(MessageData *data);
 static gboolean format_received_message_idle(gpointer data);
 static gboolean format_system_message_idle(gpointer data);
 static gboolean on_connection_error(gpointer data);
-static int handle_welcome_sequence(FreescordApp *app);
+static int handle_welcome_sequence(FreescordApp *app, Buffer *socketBuf);
+static int send_frame(FreescordApp *app, enum frame_type type,
+                      const char *text);
+static ssize_t next_frame(Buffer *b, struct frame *f);
+static void format_time(uint64_t time_us, char *ts, size_t size);
 static gboolean append_message_idle(gpointer data);
 
 /**
@@ -38,6 +45,9 @@ int main(int argc, char *argv[]) {
     // Initialisation du mutex
     pthread_mutex_init(&app->mutex, NULL);
 
+    // Sans réserve, les messages sont simplement alloués par malloc
+    message_slab = slab_create("message", MESSAGE_DATA_SIZE);
+
     init_gui(app, argc, argv);
 
     gtk_main();
@@ -45,6 +55,7 @@ int main(int argc, char *argv[]) {
     // Libération du mutex
     pthread_mutex_destroy(&app->mutex);
     free(app);
+    slab_free(message_slab);
 
     return EXIT_SUCCESS;
 }
@@ -524,8 +535,34 @@ int connect_to_server(const char *server, int port) {
 void send_message(FreescordApp *app, const char *message) {
     if (!app->connected) return;
 
-    // Envoyer le message sans newline - le serveur gère ça
-    send(app->socket_fd, message, strlen(message), 0);
+    send_frame(app, FRAME_MSG, message);
+}
+
+/**
+ * @brief Envoie un texte dans une trame du protocole v2
+ */
+static int send_frame(FreescordApp *app, enum frame_type type,
+                      const char *text) {
+    char frame[FRAME_MAX_SIZE];
+    struct frame f = {.type = type, .body = text, .bodyLen = strlen(text)};
+
+    size_t size = frame_encode(&f, frame);
+    if (size == 0) return -1;
+
+    return send(app->socket_fd, frame, size, 0) == (ssize_t)size ? 0 : -1;
+}
+
+/**
+ * @brief Extrait la prochaine trame complète du buffer, sans copie
+ * @return sa taille, 0 si elle est incomplète, -1 si elle est invalide
+ */
+static ssize_t next_frame(Buffer *b, struct frame *f) {
+    char *data;
+    size_t len = buff_peek(b, &data);
+
+    ssize_t size = frame_decode(data, len, f);
+    if (size > 0) buff_consume(b, size);
+    return size;
 }
 
 /**
@@ -533,157 +570,255 @@ void send_message(FreescordApp *app, const char *message) {
  */
 void *receive_messages(void *data) {
     FreescordApp *app = (FreescordApp *)data;
-    char buffer[BUFFER_SIZE];
-    int received;
+    struct frame f;
+    ssize_t nextRes = 0;
+
+    // Une trame entière doit tenir dans le buffer
+    Buffer *socketBuf = buff_create(app->socket_fd, FRAME_MAX_SIZE);
+    if (!socketBuf) {
+        gdk_threads_add_idle((GSourceFunc)on_connection_error, app);
+        return NULL;
+    }
 
     // Gestion de la séquence de bienvenue d'abord
-    if (handle_welcome_sequence(app) < 0) {
+    if (handle_welcome_sequence(app, socketBuf) < 0) {
+        buff_free(socketBuf);
         gdk_threads_add_idle((GSourceFunc)on_connection_error, app);
         return NULL;
     }
 
     while (app->thread_running) {
-        received = recv(app->socket_fd, buffer, BUFFER_SIZE - 1, 0);
-
-        if (received <= 0) {
-            if (app->thread_running) {
-                // Erreur ou déconnexion
-                gdk_threads_add_idle((GSourceFunc)gtk_button_clicked,
-                                     app->connect_button);
-            }
+        // Toutes les trames reçues, lues directement dans le buffer, dont
+        // celles arrivées avec la réponse au pseudo
+        while ((nextRes = next_frame(socketBuf, &f)) > 0)
+            process_incoming_frame(app, &f);
+        if (nextRes < 0) break;
+
+        // Coupure : la session est reprise sur une nouvelle connexion
+        if (buff_read_more(socketBuf) <= 0 &&
+            (!app->thread_running || resume_session(app, &socketBuf) < 0)) {
+            nextRes = -1;
             break;
         }
-
-        buffer[received] = '\0';
-
-        // Analyser et formater le message reçu
-        process_incoming_message(app, buffer);
     }
 
+    // Erreur, trame invalide ou déconnexion
+    if (nextRes < 0 && app->thread_running)
+        gdk_threads_add_idle((GSourceFunc)gtk_button_clicked,
+                             app->connect_button);
+
+    buff_free(socketBuf);
     return NULL;
 }
 
 /**
- * @brief Gère la séquence de bienvenue du serveur
+ * @brief Gère la séquence de bienvenue du serveur : négociation du
+ * protocole v2 et pseudo envoyés ensemble, sans attendre l'accueil
  */
-static int handle_welcome_sequence(FreescordApp *app) {
-    char buffer[BUFFER_SIZE];
-    int received, status;
+static int handle_welcome_sequence(FreescordApp *app, Buffer *socketBuf) {
+    char hello[MAX_USERNAME_LENGTH + TOKEN_SIZE + 48];
+    char *line;
+    struct frame f;
+    ssize_t nextRes;
+    int len;
+
+    char ts[16];
+    format_time(0, ts, sizeof(ts));
+
+    // Le serveur répond PROTO_ACK après son accueil en texte, suivi de la
+    // réponse au pseudo. Après une coupure, le jeton et le dernier numéro
+    // reçu reprennent la session
+    if (app->session_token[0])
+        len = snprintf(hello, sizeof(hello), "%s %s %s %llu\r\n",
+                       PROTO_HELLO, app->username, app->session_token,
+                       (unsigned long long)app->last_seq);
+    else
+        len = snprintf(hello, sizeof(hello), "%s %s\r\n", PROTO_HELLO,
+                       app->username);
+    if (send(app->socket_fd, hello, len, 0) < 0) return -1;
+
+    size_t ackLen = strlen(PROTO_ACK);
+    while (1) {
+        while (buff_next_line(socketBuf, &line) < 0)
+            if (buff_read_more(socketBuf) <= 0) return -1;
+
+        // La demande du pseudo précède PROTO_ACK sur la même ligne
+        size_t len = strlen(line);
+        if (len >= ackLen && strcmp(line + len - ackLen, PROTO_ACK) == 0)
+            break;
 
-    // Recevoir le message de bienvenue
-    received = recv(app->socket_fd, buffer, sizeof(buffer) - 1, 0);
-    if (received <= 0) return -1;
+        // Afficher le message de bienvenue, sauf à une reprise
+        if (app->session_token[0]) continue;
+        MessageData *welcome_data =
+            create_message_data(app, ts, NULL, line, FALSE);
+        gdk_threads_add_idle((GSourceFunc)format_system_message_idle,
+                             welcome_data);
+    }
 
-    buffer[received] = '\0';
+    // Recevoir la réponse : status dans seq, "status | explications"
+    do {
+        while ((nextRes = next_frame(socketBuf, &f)) == 0)
+            if (buff_read_more(socketBuf) <= 0) return -1;
+        if (nextRes < 0) return -1;
+    } while (f.type != FRAME_NICK);
+
+    if (f.seq != 0) {
+        // Afficher l'erreur (extraire le message après "X | "), le pseudo
+        // est à changer avant de se reconnecter
+        const char *error_msg = strchr(f.body, '|');
+        if (error_msg) {
+            MessageData *error_data =
+                create_message_data(app, ts, NULL, error_msg + 2, FALSE);
+            gdk_threads_add_idle((GSourceFunc)format_system_message_idle,
+                                 error_data);
+        }
+        return -1;
+    }
 
-    // Afficher le message de bienvenue
-    time_t now = time(NULL);
-    struct tm *lt = localtime(&now);
-    char ts[6];
-    strftime(ts, sizeof(ts), "%H:%M", lt);
+    return 0;
+}
 
-    MessageData *welcome_data =
-        create_message_data(app, ts, NULL, buffer, FALSE);
-    gdk_threads_add_idle((GSourceFunc)format_system_message_idle, welcome_data);
+/**
+ * @brief Reprend la session après une coupure : quelques tentatives
+ * espacées, avec le jeton et le dernier numéro reçu. *socketBuf est
+ * remplacé par le buffer de la nouvelle socket
+ * @return 0, ou -1 si la session n'a pas pu être reprise
+ */
+int resume_session(FreescordApp *app, Buffer **socketBuf) {
+    char ts[16];
 
-    do {
-        // Recevoir le prompt pour le pseudo
-        received = recv(app->socket_fd, buffer, sizeof(buffer) - 1, 0);
-        if (received <= 0) return -1;
-        buffer[received] = '\0';
-
-        // Envoyer le pseudo
-        send(app->socket_fd, app->username, strlen(app->username), 0);
-
-        // Recevoir la réponse
-        received = recv(app->socket_fd, buffer, sizeof(buffer) - 1, 0);
-        if (received <= 0) return -1;
-        buffer[received] = '\0';
-
-        status = buffer[0] - '0';
-
-        if (status != 0) {
-            // Afficher l'erreur (extraire le message après "X | ")
-            char *error_msg = strchr(buffer, '|');
-            if (error_msg) {
-                error_msg += 2;  // Sauter "| "
-                MessageData *error_data =
-                    create_message_data(app, ts, NULL, error_msg, FALSE);
-                gdk_threads_add_idle((GSourceFunc)format_system_message_idle,
-                                     error_data);
-            }
+    if (!app->session_token[0]) return -1;
+
+    // Le serveur peut ne pas avoir encore vu la coupure : le pseudo est
+    // alors encore pris, la tentative suivante attend un peu plus
+    for (int i = 0; i < RECONNECT_TRIES && app->thread_running; i++) {
+        format_time(0, ts, sizeof(ts));
+        MessageData *data = create_message_data(
+            app, ts, NULL, "Connexion perdue, reconnexion...", FALSE);
+        gdk_threads_add_idle(format_system_message_idle, data);
+        sleep(1 << i);
+
+        int sockfd = connect_to_server(app->server, app->port);
+        if (sockfd < 0) continue;
+
+        // La déconnexion demandée entre-temps ferme la socket courante
+        pthread_mutex_lock(&app->mutex);
+        if (!app->thread_running) {
+            pthread_mutex_unlock(&app->mutex);
+            close(sockfd);
+            return -1;
         }
-    } while (status != 0);
+        if (app->socket_fd >= 0) close(app->socket_fd);
+        app->socket_fd = sockfd;
+        pthread_mutex_unlock(&app->mutex);
+
+        buff_free(*socketBuf);
+        *socketBuf = buff_create(sockfd, FRAME_MAX_SIZE);
+        if (!*socketBuf) return -1;
+        if (handle_welcome_sequence(app, *socketBuf) == 0) return 0;
+    }
 
-    return 0;
+    return -1;
+}
+
+/**
+ * @brief Heure d'envoi time_us (µs depuis le 1er janvier 1970), ou
+ * maintenant si elle vaut 0, avec la date si ce n'est pas aujourd'hui
+ */
+static void format_time(uint64_t time_us, char *ts, size_t size) {
+    time_t now = time(NULL);
+    time_t t = time_us ? (time_t)(time_us / 1000000) : now;
+    struct tm lt, today;
+    localtime_r(&t, &lt);
+    localtime_r(&now, &today);
+
+    if (lt.tm_yday == today.tm_yday && lt.tm_year == today.tm_year)
+        strftime(ts, size, "%H:%M", &lt);
+    else
+        strftime(ts, size, "%d/%m %H:%M", &lt);
+}
+
+/**
+ * @brief Copie text à la suite du message, à partir de *end
+ */
+static char *copy_text(char **end, const char *text) {
+    if (!text) return NULL;
+
+    char *copy = strcpy(*end, text);
+    *end += strlen(text) + 1;
+    return copy;
 }
 
 /**
- * @brief Crée une structure MessageData
+ * @brief Crée une structure MessageData, en un seul bloc avec ses textes
  */
 static MessageData *create_message_data(FreescordApp *app,
                                         const char *timestamp,
                                         const char *username,
                                         const char *message, gboolean is_me) {
-    MessageData *data = malloc(sizeof(MessageData));
+    size_t size = sizeof(MessageData);
+    if (timestamp) size += strlen(timestamp) + 1;
+    if (username) size += strlen(username) + 1;
+    if (message) size += strlen(message) + 1;
+
+    // Les lignes courtes, les plus fréquentes, viennent de la réserve
+    gboolean pooled = message_slab && size <= MESSAGE_DATA_SIZE;
+    MessageData *data = pooled ? slab_alloc(message_slab) : malloc(size);
     if (!data) return NULL;
 
+    char *end = data->text;
     data->app = app;
-    data->timestamp = timestamp ? strdup(timestamp) : NULL;
-    data->username = username ? strdup(username) : NULL;
-    data->message = message ? strdup(message) : NULL;
+    data->timestamp = copy_text(&end, timestamp);
+    data->username = copy_text(&end, username);
+    data->message = copy_text(&end, message);
     data->is_me = is_me;
+    data->pooled = pooled;
 
     return data;
 }
 
 /**
- * @brief Traite un message entrant et l'affiche correctement formaté
+ * @brief Traite une trame entrante et l'affiche correctement formatée
  */
-void process_incoming_message(FreescordApp *app, const char *buffer) {
-    if (!app || !buffer) return;
-
-    // Créer une copie du message pour le traitement
-    char *message_copy = strdup(buffer);
-    if (!message_copy) return;
-
-    // Supprimer les retours à la ligne de fin
-    char *newline = strchr(message_copy, '\n');
-    if (newline) *newline = '\0';
-
-    // Créer le timestamp
-    time_t now = time(NULL);
-    struct tm *lt = localtime(&now);
-    char ts[6];
-    strftime(ts, sizeof(ts), "%H:%M", lt);
-
-    // Analyser le format du message
-    // Format attendu: "Username: message"
-    char *colon_pos = strchr(message_copy, ':');
-    if (colon_pos) {
-        *colon_pos = '\0';  // Séparer le username
-        char *username = message_copy;
-        char *message_content = colon_pos + 1;
+void process_incoming_frame(FreescordApp *app, const struct frame *f) {
+    if (!app || !f) return;
+
+    // Heure d'envoi donnée par le serveur : un message rejoué garde la
+    // sienne
+    char ts[16];
+    format_time(f->time, ts, sizeof(ts));
+
+    // Jeton de la session, et numéro jusqu'auquel tout est reçu
+    if (f->type == FRAME_SESSION) {
+        snprintf(app->session_token, sizeof(app->session_token), "%s",
+                 f->body);
+        app->last_seq = f->seq;
+        return;
+    }
 
-        // Supprimer les espaces au début du message
-        while (*message_content == ' ') message_content++;
+    // L'auteur et le texte sont des champs séparés de la trame
+    if (f->type == FRAME_MSG) {
+        if (f->seq > app->last_seq) app->last_seq = f->seq;
 
         // Vérifier si c'est notre propre message (normalement ne devrait pas
         // arriver)
-        gboolean is_me = (strcmp(username, app->username) == 0);
+        gboolean is_me = (strcmp(f->sender, app->username) == 0);
 
         // Afficher le message formaté
         MessageData *data =
-            create_message_data(app, ts, username, message_content, is_me);
+            create_message_data(app, ts, f->sender, f->body, is_me);
         gdk_threads_add_idle(format_received_message_idle, data);
-    } else {
+    } else if (f->type == FRAME_PRIVATE) {
+        // Message privé : marqué à côté du nom de son auteur
+        char name[BUFFER_SIZE];
+        snprintf(name, sizeof(name), "%s (privé)", f->sender);
+        MessageData *data = create_message_data(app, ts, name, f->body, FALSE);
+        gdk_threads_add_idle(format_received_message_idle, data);
+    } else if (f->type == FRAME_NOTICE) {
         // Message système
-        MessageData *data =
-            create_message_data(app, ts, NULL, message_copy, FALSE);
+        MessageData *data = create_message_data(app, ts, NULL, f->body, FALSE);
         gdk_threads_add_idle(format_system_message_idle, data);
     }
-
-    free(message_copy);
 }
 
 /**
@@ -737,10 +872,10 @@ static gboolean on_connection_error(gpointer data) {
 static void free_message_data(MessageData *data) {
     if (!data) return;
 
-    if (data->timestamp) free(data->timestamp);
-    if (data->username) free(data->username);
-    if (data->message) free(data->message);
-    free(data);
+    if (data->pooled)
+        slab_release(message_slab, data);
+    else
+        free(data);
 }
 
 /**
@@ -752,12 +887,15 @@ void disconnect_from_server(FreescordApp *app) {
     // Arrêter le thread de réception
     app->thread_running = 0;
 
-    // Fermer la socket
+    // Fermer la socket, que le thread de réception peut remplacer en
+    // reprenant la session
+    pthread_mutex_lock(&app->mutex);
     if (app->socket_fd >= 0) {
         shutdown(app->socket_fd, SHUT_RDWR);
         close(app->socket_fd);
         app->socket_fd = -1;
     }
+    pthread_mutex_unlock(&app->mutex);
 
     // Attendre la fin du thread
     if (app->connected) {
@@ -891,6 +1029,12 @@ void on_connect_button_clicked(GtkButton *button, FreescordApp *app) {
         strncpy(app->username, username, MAX_USERNAME_LENGTH - 1);
         app->username[MAX_USERNAME_LENGTH - 1] = '\0';
 
+        // Nouvelle session, reprise sur le même serveur après une coupure
+        snprintf(app->server, sizeof(app->server), "%s", server);
+        app->port = port;
+        app->session_token[0] = '\0';
+        app->last_seq = 0;
+
         // Connexion au serveur
         set_status(app, "Connexion en cours...", "status-connecting");
         app->socket_fd = connect_to_server(server, port);
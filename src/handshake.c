@@ -0,0 +1,151 @@
+#include "../include/handshake.h"
+
+#include <errno.h>
+
+#include "../include/serveur.h"
+#include "../include/session.h"
+
+void handshake_start(struct handshake_queue *q, struct user *u) {
+    u->deadline = now_us() + config.handshakeTimeout * 1000;
+
+    u->hsPrev = q->last;
+    u->hsNext = NULL;
+    if (q->last)
+        q->last->hsNext = u;
+    else
+        q->first = u;
+    q->last = u;
+    q->count++;
+
+    // Message de bienvenue et demande du pseudo
+    send(u->sock, WELCOME_MSG, strlen(WELCOME_MSG), 0);
+    send(u->sock, NICKNAME_PROMPT, strlen(NICKNAME_PROMPT), 0);
+}
+
+void handshake_remove(struct handshake_queue *q, struct user *u) {
+    if (u->hsPrev)
+        u->hsPrev->hsNext = u->hsNext;
+    else
+        q->first = u->hsNext;
+    if (u->hsNext)
+        u->hsNext->hsPrev = u->hsPrev;
+    else
+        q->last = u->hsPrev;
+
+    u->hsPrev = u->hsNext = NULL;
+    q->count--;
+}
+
+/* Sépare de la proposition line le jeton et le numéro d'une reprise de
+ * session ("pseudo jeton numéro"), gardés dans u */
+static void handshake_resume_args(struct user *u, char *line) {
+    char token[USER_TOKEN_SIZE];
+    unsigned long long seq;
+    char *space = strchr(line, ' ');
+
+    u->token[0] = '\0';
+    u->resumeSeq = 0;
+    if (!space || sscanf(space + 1, "%32s %llu", token, &seq) != 2 ||
+        strlen(token) != USER_TOKEN_SIZE - 1)
+        return;
+
+    *space = '\0';
+    strcpy(u->token, token);
+    u->resumeSeq = seq;
+}
+
+/* Salons de u : ceux de sa session reprise, ou le salon par défaut */
+static void handshake_rooms(struct user *u) {
+    struct room **rooms;
+    ssize_t nbRooms =
+        u->token[0] ? session_resume(u->token, u->username, &rooms) : -1;
+
+    if (nbRooms < 0) {
+        u->resumeSeq = 0;
+        room_join(u, room_get(DEFAULT_ROOM, 0));
+        return;
+    }
+
+    for (ssize_t i = 0; i < nbRooms; i++) room_join(u, rooms[i]);
+    free(rooms);
+    stats_add(STAT_SESSIONS_RESUMED, 1);
+}
+
+/* Pseudo accepté : u rejoint les ensembles de diffusion */
+static int handshake_login(struct user *u) {
+    if (buff_grow(u->in, USER_LINE_SIZE) < 0) {
+        perror("malloc");
+        registry_release(u);
+        return -1;
+    }
+
+    u->state = USER_CONNECTED;
+    handshake_rooms(u);
+
+    // Le jeton de la nouvelle session part avant tout message : jusqu'au
+    // numéro annoncé, le client a tout reçu ou le recevra avec l'historique
+    if (session_issue(u) < 0) perror("getrandom");
+    uint64_t upTo = u->resumeSeq ? u->resumeSeq : rooms_last_seq();
+    if (u->token[0] && proto_send_session(u, upTo) < 0) perror("send");
+
+    if (userset_add(&connectUsers, u, 0) < 0) perror("userset_add");
+
+    printf("\n[CONNEXION] Utilisateur connecté : %s\n", u->username);
+    return 1;
+}
+
+int handshake_read(struct handshake_queue *q, struct user *u) {
+    ssize_t readRes = buff_read_more(u->in);
+    stats_add(STAT_RECV_CALLS, 1);
+    if (readRes < 0 && (errno == EAGAIN || errno == EINTR)) return 0;
+
+    // Déconnexion, ou tampon plein sans commande complète
+    if (readRes <= 0) {
+        if (readRes < 0 && errno != ENOBUFS) perror("recv");
+        handshake_remove(q, u);
+        return -1;
+    }
+
+    return handshake_process(q, u);
+}
+
+int handshake_process(struct handshake_queue *q, struct user *u) {
+    // Une proposition de pseudo par commande, éventuellement précédée de la
+    // négociation du protocole ou sur la même ligne. La réponse redemande le
+    // pseudo si besoin
+    char *line;
+    int nextRes;
+    while ((nextRes = proto_next(u, &line)) > 0) {
+        if (proto_hello(u, &line) && !line) continue;
+        handshake_resume_args(u, line);
+        if (answer_nickname(u, line) != 0) continue;
+
+        handshake_remove(q, u);
+        return handshake_login(u);
+    }
+
+    if (nextRes < 0) {
+        fprintf(stderr, "[SERVER ERROR] - trame invalide pendant l'accueil\n");
+        handshake_remove(q, u);
+        return -1;
+    }
+
+    return 0;
+}
+
+struct user *handshake_expired(struct handshake_queue *q) {
+    struct user *u = q->first;
+    if (!u || u->deadline > now_us()) return NULL;
+
+    handshake_remove(q, u);
+    stats_add(STAT_HANDSHAKE_EXPIRED, 1);
+    return u;
+}
+
+long handshake_timeout(struct handshake_queue *q, long timeoutUs) {
+    if (!q->first) return timeoutUs;
+
+    uint64_t now = now_us();
+    long remaining = q->first->deadline > now ? q->first->deadline - now : 0;
+    return timeoutUs < 0 || remaining < timeoutUs ? remaining : timeoutUs;
+}
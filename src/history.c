@@ -0,0 +1,287 @@
+#include "../include/history.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/proto.h"
+#include "../include/stats.h"
+
+/* Décode la trame gardée dans e : 1 s'il s'agit d'un message de room */
+static int room_frame(const struct journal_entry *e, const struct room *room,
+                      struct frame *f) {
+    return frame_decode(e->data, e->len, f) == (ssize_t)e->len &&
+           f->type == FRAME_MSG && f->roomLen == strlen(room->name) &&
+           memcmp(f->room, room->name, f->roomLen) == 0;
+}
+
+/*================== Début de la réponse ==================*/
+/* Numéros des derniers messages du salon, en tableau circulaire */
+struct window {
+    const struct room *room;
+    uint64_t *seqs;
+    size_t n;
+    size_t count;
+    uint64_t firstRead; /* premier message lu dans le journal, 0 : aucun */
+};
+
+static int keep_seq(const struct journal_entry *e, void *arg) {
+    struct window *w = arg;
+    struct frame f;
+
+    if (!w->firstRead) w->firstRead = e->seq;
+    if (room_frame(e, w->room, &f)) w->seqs[w->count++ % w->n] = e->seq;
+    return 0;
+}
+
+/* Numéro du plus ancien des n derniers messages de room, parmi les
+ * HISTORY_SCAN_MAX derniers du journal, 0 s'il n'y en a aucun */
+static uint64_t history_start(Journal *journal, const struct room *room,
+                              size_t n) {
+    struct window w = {room, malloc(n * sizeof(uint64_t)), n, 0, 0};
+    if (!w.seqs) return 0;
+
+    // Fenêtre élargie jusqu'à contenir n messages du salon ou tout ce que
+    // le journal garde : un salon actif ne coûte que ses derniers messages
+    uint64_t lastSeq = journal_last_seq(journal), span = 8 * n;
+    while (1) {
+        if (span > HISTORY_SCAN_MAX) span = HISTORY_SCAN_MAX;
+        uint64_t start = lastSeq > span ? lastSeq - span + 1 : 1;
+        w.count = 0;
+        w.firstRead = 0;
+        journal_read(journal, start, keep_seq, &w);
+        if (w.count >= n || start == 1 || w.firstRead != start ||
+            span == HISTORY_SCAN_MAX)
+            break;
+        span *= 4;
+    }
+
+    uint64_t first = 0;
+    if (w.count > 0) first = w.seqs[w.count >= n ? w.count % n : 0];
+    free(w.seqs);
+    return first;
+}
+
+/*================== Réponse ==================*/
+/* Réponse en cours : lignes de texte et trames des messages retenus */
+struct collect {
+    const struct room *room;
+    size_t max;
+    uint64_t upTo; /* numéro au-delà duquel la lecture s'arrête */
+    size_t count;
+    uint64_t last; /* numéro du dernier message retenu */
+    char *text;
+    size_t textLen, textSize;
+    char *frames;
+    size_t framesLen, framesSize;
+    int failed;
+};
+
+/* Place pour need octets de plus au bout de *buf
+ * retourne leur adresse, ou NULL si l'allocation échoue */
+static char *reserve(char **buf, size_t len, size_t *size, size_t need) {
+    if (len + need > *size) {
+        size_t newSize = *size ? 2 * *size : 4096;
+        while (newSize < len + need) newSize *= 2;
+        char *grown = realloc(*buf, newSize);
+        if (!grown) return NULL;
+        *buf = grown;
+        *size = newSize;
+    }
+    return *buf + len;
+}
+
+/* Ajoute text et frame, les deux formes d'un même message */
+static int collect_append(struct collect *c, const char *text, size_t textLen,
+                          const char *frame, size_t frameLen) {
+    char *t = reserve(&c->text, c->textLen, &c->textSize, textLen);
+    char *f = reserve(&c->frames, c->framesLen, &c->framesSize, frameLen);
+    if (!t || !f) return -1;
+
+    memcpy(t, text, textLen);
+    memcpy(f, frame, frameLen);
+    c->textLen += textLen;
+    c->framesLen += frameLen;
+    return 0;
+}
+
+static int collect_message(const struct journal_entry *e, void *arg) {
+    struct collect *c = arg;
+    struct frame f;
+    if (e->seq > c->upTo) return 1;
+    if (!room_frame(e, c->room, &f)) return 0;
+
+    // Ligne de texte mise en forme comme par proto_message, la trame gardée
+    // est reprise telle quelle
+    size_t size = f.roomLen + f.senderLen + f.bodyLen + 5;
+    char *line = reserve(&c->text, c->textLen, &c->textSize, size);
+    char *frame = reserve(&c->frames, c->framesLen, &c->framesSize, e->len);
+    if (!line || !frame) {
+        c->failed = 1;
+        return 1;
+    }
+
+    int len;
+    if (strcmp(c->room->name, DEFAULT_ROOM) == 0)
+        len = snprintf(line, size, "%.*s: %.*s\n", (int)f.senderLen, f.sender,
+                       (int)f.bodyLen, f.body);
+    else
+        len = snprintf(line, size, "%.*s %.*s: %.*s\n", (int)f.roomLen,
+                       f.room, (int)f.senderLen, f.sender, (int)f.bodyLen,
+                       f.body);
+    memcpy(frame, e->data, e->len);
+    c->textLen += len;
+    c->framesLen += e->len;
+
+    c->last = e->seq;
+    return ++c->count == c->max;
+}
+
+/* Réponse de c terminée par notice s'il n'est pas NULL, sous ses deux
+ * formes */
+static struct payload *collect_finish(struct collect *c,
+                                      struct payload *notice) {
+    struct payload *p = NULL;
+    if (!notice || collect_append(c, notice->data, notice->len,
+                                  notice->frame->data, notice->frame->len) == 0)
+        p = payload_create(c->text, c->textLen);
+    if (p && !(p->frame = payload_create(c->frames, c->framesLen))) {
+        payload_unref(p);
+        p = NULL;
+    }
+
+    payload_unref(notice);
+    free(c->text);
+    free(c->frames);
+    return p;
+}
+
+/*================== Arguments ==================*/
+#define HISTORY_BLANKS " \t\r\n"
+#define HISTORY_USAGE "Usage : /history [n|since numéro]"
+
+/* Copie dans word, de size octets, le mot suivant de *text, qui avance
+ * après lui
+ * retourne 1 si un mot a été lu, 0 s'il n'y en a plus, -1 s'il est trop
+ * long */
+static int next_word(const char **text, char *word, size_t size) {
+    *text += strspn(*text, HISTORY_BLANKS);
+    size_t len = strcspn(*text, HISTORY_BLANKS);
+    if (len == 0) return 0;
+    if (len >= size) return -1;
+
+    memcpy(word, *text, len);
+    word[len] = '\0';
+    *text += len;
+    return 1;
+}
+
+/* Lit dans *n le nombre word, écrit en chiffres seuls
+ * retourne 0, ou -1 si word n'est pas un nombre ou déborde */
+static int parse_number(const char *word, uint64_t *n) {
+    if (!*word || word[strspn(word, "0123456789")]) return -1;
+
+    errno = 0;
+    unsigned long long value = strtoull(word, NULL, 10);
+    if (errno == ERANGE) return -1;
+    *n = value;
+    return 0;
+}
+
+/*================== Commande ==================*/
+struct payload *history_command(Journal *journal, struct user *u,
+                                const char *text) {
+    char word[24]; /* le plus grand numéro a 20 chiffres */
+    uint64_t arg = HISTORY_DEFAULT;
+    int since = 0;
+
+    // "/history", "/history n" ou "/history since seq", chaque argument lu
+    // une seule fois
+    text += strcspn(text, HISTORY_BLANKS);
+    int res = next_word(&text, word, sizeof(word));
+    if (res > 0 && strcmp(word, "since") == 0) {
+        since = 1;
+        res = next_word(&text, word, sizeof(word));
+        if (res == 0) res = -1;
+    }
+    if (res > 0 && (parse_number(word, &arg) < 0 || (!since && arg == 0)))
+        res = -1;
+    if (res < 0 || next_word(&text, word, sizeof(word)) != 0)
+        return proto_notice(HISTORY_USAGE);
+
+    if (!journal)
+        return proto_notice("Historique indisponible : pas de journal");
+    if (!u->room)
+        return proto_notice("Vous n'êtes dans aucun salon, /join #salon");
+
+    size_t max = HISTORY_MAX;
+    if (!since && arg < max) max = arg;
+    uint64_t from = since ? arg + 1 : history_start(journal, u->room, max);
+    if (from == 0)
+        return proto_notice("Aucun message de %s dans le journal",
+                            u->room->name);
+
+    struct collect c = {.room = u->room, .max = max, .upTo = UINT64_MAX};
+    journal_read(journal, from, collect_message, &c);
+    if (c.failed) {
+        free(c.text);
+        free(c.frames);
+        return NULL;
+    }
+    if (c.count == 0) {
+        free(c.text);
+        free(c.frames);
+        return proto_notice("Aucun message de %s après le n° %" PRIu64,
+                            u->room->name, from - 1);
+    }
+    stats_add(STAT_HISTORY_SENT, c.count);
+
+    // Le numéro du dernier message permet de demander la suite
+    if (since && c.count == max)
+        return collect_finish(
+            &c, proto_notice("%zu message(s) de %s, suite : /history since "
+                             "%" PRIu64,
+                             c.count, u->room->name, c.last));
+    return collect_finish(
+        &c, proto_notice("Fin de l'historique de %s : %zu message(s), "
+                         "dernier n° %" PRIu64,
+                         u->room->name, c.count, c.last));
+}
+
+struct payload *history_range(Journal *journal, const struct room *room,
+                              uint64_t after, uint64_t upTo) {
+    if (!journal)
+        return proto_notice("Messages de %s manqués après le n° %" PRIu64
+                            " indisponibles : pas de journal",
+                            room->name, after);
+
+    // Seul ce que l'écrivain a déjà écrit est lu : la remise n'attend jamais
+    // le disque. Les plus récents sont dans l'historique en mémoire ; ceux
+    // qui l'ont quitté avant d'être écrits se demandent ensuite avec since
+    uint64_t written = journal_written_seq(journal);
+    struct collect c = {.room = room,
+                        .max = HISTORY_MAX,
+                        .upTo = upTo < written ? upTo : written};
+    if (c.upTo > after) journal_read(journal, after + 1, collect_message, &c);
+    if (c.failed) {
+        free(c.text);
+        free(c.frames);
+        return NULL;
+    }
+    stats_add(STAT_HISTORY_SENT, c.count);
+
+    uint64_t next = c.count == c.max ? c.last : c.upTo;
+    if (next < upTo)
+        return collect_finish(
+            &c, proto_notice("Messages manqués de %s tronqués, suite : "
+                             "/history since %" PRIu64,
+                             room->name, next > after ? next : after));
+    if (c.count == 0) {
+        free(c.text);
+        free(c.frames);
+        return NULL;
+    }
+    return collect_finish(&c, NULL);
+}
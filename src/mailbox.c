@@ -0,0 +1,463 @@
+#include "../include/mailbox.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/proto.h"
+#include "../include/registry.h"
+#include "../include/stats.h"
+
+/* Boîte d'un pseudo, dans une liste de la table et, tant qu'elle a des
+ * messages en mémoire, dans l'ordre d'utilisation */
+struct mailbox {
+    char nick[USER_NAME_SIZE];
+    char *data;         /* trames en mémoire, NULL si aucune */
+    size_t len, size;
+    size_t count;       /* messages en mémoire */
+    size_t diskCount;   /* messages dans son fichier */
+    struct mailbox *next;          /* même liste de la table */
+    struct mailbox *older, *newer; /* boîtes en mémoire */
+};
+
+/* Messages retirés de la mémoire, en attente d'être ajoutés au fichier de
+ * leur boîte */
+struct spill {
+    char nick[USER_NAME_SIZE];
+    char *data;
+    size_t len, count;
+    struct spill *next;
+};
+
+static struct mailbox *table[MAILBOX_TABLE_SIZE];
+static struct mailbox *oldest, *newest;
+static size_t memBytes, budget;
+static const char *spillDir;
+static struct spill *spillHead, **spillTail = &spillHead;
+static pthread_mutex_t mutexMailbox = PTHREAD_MUTEX_INITIALIZER;
+/* Écritures et lectures de fichiers, à prendre avant mutexMailbox */
+static pthread_mutex_t mutexSpill = PTHREAD_MUTEX_INITIALIZER;
+
+/* FNV-1a */
+static uint32_t hash_nick(const char *nick) {
+    uint32_t h = 2166136261u;
+    for (; *nick; nick++) h = (h ^ (unsigned char)*nick) * 16777619u;
+    return h;
+}
+
+/*================== Fichiers ==================*/
+/* Chemin du fichier de la boîte de nick : un pseudo peut contenir '/' */
+static void box_path(const char *nick, char *path, size_t size) {
+    int len = snprintf(path, size, "%s/", spillDir);
+    for (; *nick && len + 3 < (int)size; nick++)
+        len += snprintf(path + len, size - len, "%02x", (unsigned char)*nick);
+    snprintf(path + len, size - len, ".mbox");
+}
+
+/* Pseudo dont name est le fichier, 0 si name n'en est pas un */
+static int file_nick(const char *name, char *nick) {
+    size_t len = strcspn(name, ".");
+    if (len == 0 || len % 2 || len / 2 >= USER_NAME_SIZE ||
+        strcmp(name + len, ".mbox") != 0)
+        return 0;
+
+    for (size_t i = 0; i < len / 2; i++) {
+        unsigned byte;
+        if (sscanf(name + 2 * i, "%2x", &byte) != 1 || byte == 0) return 0;
+        nick[i] = byte;
+    }
+    nick[len / 2] = '\0';
+    return 1;
+}
+
+/* Contenu du fichier path, alloué, dans *len
+ * retourne NULL s'il ne peut être lu */
+static char *read_file(const char *path, size_t *len) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+
+    // Un fichier raccourci entre-temps est lu jusqu'à sa fin
+    char *data = malloc(st.st_size ? st.st_size : 1);
+    ssize_t readRes = 0;
+    *len = 0;
+    while (data && *len < (size_t)st.st_size) {
+        readRes = read(fd, data + *len, st.st_size - *len);
+        if (readRes < 0 && errno == EINTR) continue;
+        if (readRes <= 0) break;
+        *len += readRes;
+    }
+    close(fd);
+
+    if (data && readRes < 0) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+/* Nombre de trames entières au début des len octets de data */
+static size_t count_frames(const char *data, size_t len) {
+    size_t count = 0;
+    struct frame f;
+    ssize_t size;
+    while ((size = frame_decode(data, len, &f)) > 0) {
+        data += size;
+        len -= size;
+        count++;
+    }
+    return count;
+}
+
+/*================== Table des boîtes ==================*/
+static struct mailbox *box_find(const char *nick, uint32_t hash) {
+    struct mailbox *m = table[hash % MAILBOX_TABLE_SIZE];
+    while (m && strcmp(m->nick, nick) != 0) m = m->next;
+    return m;
+}
+
+static struct mailbox *box_create(const char *nick, uint32_t hash) {
+    struct mailbox *m = calloc(1, sizeof(*m));
+    if (!m) return NULL;
+
+    snprintf(m->nick, sizeof(m->nick), "%s", nick);
+    struct mailbox **head = &table[hash % MAILBOX_TABLE_SIZE];
+    m->next = *head;
+    *head = m;
+    return m;
+}
+
+/* Retire m de l'ordre d'utilisation */
+static void box_unlink(struct mailbox *m) {
+    if (m->older)
+        m->older->newer = m->newer;
+    else if (oldest == m)
+        oldest = m->newer;
+    if (m->newer)
+        m->newer->older = m->older;
+    else if (newest == m)
+        newest = m->older;
+    m->older = m->newer = NULL;
+}
+
+/* Place m en tête de l'ordre d'utilisation */
+static void box_touch(struct mailbox *m) {
+    box_unlink(m);
+    m->older = newest;
+    if (newest)
+        newest->newer = m;
+    else
+        oldest = m;
+    newest = m;
+}
+
+/* Libère les messages en mémoire de m */
+static void box_release(struct mailbox *m) {
+    box_unlink(m);
+    memBytes -= m->size;
+    free(m->data);
+    m->data = NULL;
+    m->len = m->size = m->count = 0;
+}
+
+/* Retire m de la table et la libère */
+static void box_forget(struct mailbox *m, uint32_t hash) {
+    struct mailbox **link = &table[hash % MAILBOX_TABLE_SIZE];
+    while (*link != m) link = &(*link)->next;
+    *link = m->next;
+
+    box_release(m);
+    free(m);
+}
+
+/* Ajoute la trame de len octets aux messages en mémoire de m */
+static int box_append(struct mailbox *m, const char *frame, size_t len) {
+    if (m->len + len > m->size) {
+        size_t newSize = m->size ? 2 * m->size : 1024;
+        while (newSize < m->len + len) newSize *= 2;
+        char *grown = realloc(m->data, newSize);
+        if (!grown) return -1;
+        memBytes += newSize - m->size;
+        m->data = grown;
+        m->size = newSize;
+    }
+
+    memcpy(m->data + m->len, frame, len);
+    m->len += len;
+    m->count++;
+    return 0;
+}
+
+/* Retire les messages en mémoire de m, mis en file pour son fichier
+ * l'écriture est faite par spill_drain, hors de mutexMailbox */
+static void box_spill(struct mailbox *m) {
+    struct spill *s = spillDir ? malloc(sizeof(*s)) : NULL;
+
+    if (s) {
+        memcpy(s->nick, m->nick, sizeof(s->nick));
+        s->data = m->data;
+        s->len = m->len;
+        s->count = m->count;
+        s->next = NULL;
+        *spillTail = s;
+        spillTail = &s->next;
+        m->diskCount += m->count;
+        m->data = NULL;
+    } else {
+        stats_add(STAT_MAIL_DROPPED, m->count);
+    }
+
+    size_t diskCount = m->diskCount;
+    box_release(m);
+    if (diskCount == 0) box_forget(m, hash_nick(m->nick));
+}
+
+/* Ajoute les messages en file s au fichier de leur boîte
+ * retourne 1 s'ils sont écrits, 0 sinon */
+static int spill_write(const struct spill *s) {
+    char path[PATH_MAX];
+    int written = 0;
+
+    box_path(s->nick, path, sizeof(path));
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    if (fd >= 0) {
+        written = write(fd, s->data, s->len) == (ssize_t)s->len;
+        close(fd);
+    }
+    if (!written) perror(path);
+    return written;
+}
+
+/* Écrit toute la file dans l'ordre : mutexSpill est gardé d'un retrait à
+ * la fin de son écriture, mailbox_take trouve donc dans le fichier tout ce
+ * qui n'est plus dans la file */
+static void spill_drain(void) {
+    pthread_mutex_lock(&mutexSpill);
+    for (;;) {
+        pthread_mutex_lock(&mutexMailbox);
+        struct spill *s = spillHead;
+        if (s && !(spillHead = s->next)) spillTail = &spillHead;
+        pthread_mutex_unlock(&mutexMailbox);
+        if (!s) break;
+
+        if (spill_write(s)) {
+            stats_add(STAT_MAIL_EVICTED, s->count);
+        } else {
+            // Ces messages n'ont jamais atteint la boîte
+            stats_add(STAT_MAIL_DROPPED, s->count);
+            uint32_t hash = hash_nick(s->nick);
+            pthread_mutex_lock(&mutexMailbox);
+            struct mailbox *m = box_find(s->nick, hash);
+            if (m) {
+                m->diskCount -= s->count < m->diskCount ? s->count
+                                                        : m->diskCount;
+                if (m->count + m->diskCount == 0) box_forget(m, hash);
+            }
+            pthread_mutex_unlock(&mutexMailbox);
+        }
+        free(s->data);
+        free(s);
+    }
+    pthread_mutex_unlock(&mutexSpill);
+}
+
+/*================== Boîtes ==================*/
+int mailbox_init(size_t maxBytes, const char *dir) {
+    budget = maxBytes;
+    spillDir = dir;
+    if (!dir) return 0;
+
+    if (mkdir(dir, 0700) < 0 && errno != EEXIST) return -1;
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+
+    // Boîtes déchargées avant l'arrêt : seul leur nombre de messages est lu
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        char nick[USER_NAME_SIZE], path[PATH_MAX];
+        if (!file_nick(ent->d_name, nick)) continue;
+
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        size_t len;
+        char *data = read_file(path, &len);
+        size_t count = data ? count_frames(data, len) : 0;
+        free(data);
+
+        struct mailbox *m = NULL;
+        if (count > 0) m = box_create(nick, hash_nick(nick));
+        if (m)
+            m->diskCount = count;
+        else
+            unlink(path);
+    }
+
+    closedir(d);
+    return 0;
+}
+
+struct user *mailbox_recipient(const char *nick) {
+    struct user *u = registry_find_nick(nick);
+    return u && __atomic_load_n(&u->mailOpen, __ATOMIC_ACQUIRE) ? u : NULL;
+}
+
+ssize_t mailbox_put(const char *nick, const struct payload *frame) {
+    uint32_t hash = hash_nick(nick);
+    ssize_t queued = -1;
+
+    pthread_mutex_lock(&mutexMailbox);
+
+    // Boîte relevée depuis : la remise se fait en direct. Elle est relevée
+    // sous ce verrou, un dépôt ne peut donc plus s'y perdre
+    if (mailbox_recipient(nick)) {
+        pthread_mutex_unlock(&mutexMailbox);
+        return 0;
+    }
+
+    struct mailbox *m = box_find(nick, hash);
+    if (!m) m = box_create(nick, hash);
+    if (m && m->count + m->diskCount < MAILBOX_MAX &&
+        box_append(m, frame->data, frame->len) == 0) {
+        box_touch(m);
+        queued = m->count + m->diskCount;
+        stats_add(STAT_MAIL_QUEUED, 1);
+    } else {
+        if (m && m->count + m->diskCount == 0) box_forget(m, hash);
+        stats_add(STAT_MAIL_DROPPED, 1);
+    }
+
+    // Les boîtes les moins récemment servies quittent la mémoire
+    while (memBytes > budget && oldest) box_spill(oldest);
+    int spilled = spillHead != NULL;
+
+    pthread_mutex_unlock(&mutexMailbox);
+
+    if (spilled) spill_drain();
+    return queued;
+}
+
+struct payload *mailbox_take(struct user *u) {
+    const char *nick = u->username;
+    uint32_t hash = hash_nick(nick);
+    char *frames = NULL;
+    size_t len = 0;
+    struct spill *pending = NULL, **pendingTail = &pending;
+
+    pthread_mutex_lock(&mutexMailbox);
+
+    // Les dépôts suivants vont en direct, derrière le contenu de la boîte
+    __atomic_store_n(&u->mailOpen, 1, __ATOMIC_RELEASE);
+    struct mailbox *m = box_find(nick, hash);
+    if (!m) {
+        pthread_mutex_unlock(&mutexMailbox);
+        return NULL;
+    }
+
+    // Messages de la boîte encore en file pour son fichier, dans l'ordre
+    struct spill **link = &spillHead;
+    while (*link) {
+        struct spill *s = *link;
+        if (strcmp(s->nick, nick) == 0) {
+            *link = s->next;
+            s->next = NULL;
+            *pendingTail = s;
+            pendingTail = &s->next;
+        } else {
+            link = &s->next;
+        }
+    }
+    spillTail = link;
+
+    int onDisk = m->diskCount && spillDir;
+    char *mem = m->data;
+    size_t memLen = m->len, memCount = m->count;
+    m->data = NULL;
+    box_forget(m, hash);
+
+    pthread_mutex_unlock(&mutexMailbox);
+
+    // Le fichier d'abord : il tient les messages les plus anciens. Une
+    // écriture en cours s'achève avant sa lecture
+    if (onDisk) {
+        char path[PATH_MAX];
+        box_path(nick, path, sizeof(path));
+        pthread_mutex_lock(&mutexSpill);
+        frames = read_file(path, &len);
+        if (!frames && errno != ENOENT) perror(path);
+        unlink(path);
+        pthread_mutex_unlock(&mutexSpill);
+    }
+
+    // Puis la file, puis la mémoire
+    size_t extraLen = memLen, extraCount = memCount;
+    for (struct spill *s = pending; s; s = s->next) {
+        extraLen += s->len;
+        extraCount += s->count;
+    }
+    char *all = realloc(frames, len + extraLen + 1);
+    if (all) {
+        frames = all;
+        for (struct spill *s = pending; s; s = s->next) {
+            memcpy(frames + len, s->data, s->len);
+            len += s->len;
+        }
+        if (memLen) memcpy(frames + len, mem, memLen);
+        len += memLen;
+    } else {
+        stats_add(STAT_MAIL_DROPPED, extraCount);
+    }
+    while (pending) {
+        struct spill *next = pending->next;
+        free(pending->data);
+        free(pending);
+        pending = next;
+    }
+    free(mem);
+
+    // Lignes de texte mises en forme comme par proto_private, trames
+    // reprises telles quelles jusqu'à la dernière entière
+    size_t count = 0, valid = 0, textLen = 0;
+    struct frame f;
+    ssize_t size;
+    while ((size = frame_decode(frames + valid, len - valid, &f)) > 0) {
+        textLen += f.senderLen + f.bodyLen + strlen("[privé] : \n");
+        valid += size;
+        count++;
+    }
+
+    struct payload *p = NULL, *notice = NULL;
+    if (count)
+        notice = proto_notice(
+            "%zu message(s) privé(s) reçu(s) en votre absence", count);
+    if (notice) p = payload_alloc(notice->len + textLen);
+    if (p && (p->frame = payload_alloc(notice->frame->len + valid))) {
+        // L'avis en tête, sous les deux formes
+        char *line = p->data + notice->len;
+        memcpy(p->data, notice->data, notice->len);
+        memcpy(p->frame->data, notice->frame->data, notice->frame->len);
+        memcpy(p->frame->data + notice->frame->len, frames, valid);
+
+        for (size_t off = 0; off < valid; off += size) {
+            size = frame_decode(frames + off, valid - off, &f);
+            line += sprintf(line, "[privé] %.*s: %.*s\n", (int)f.senderLen,
+                            f.sender, (int)f.bodyLen, f.body);
+        }
+        stats_add(STAT_MAIL_DELIVERED, count);
+    } else if (p) {
+        payload_unref(p);
+        p = NULL;
+    }
+
+    payload_unref(notice);
+    free(frames);
+    return p;
+}
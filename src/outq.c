@@ -0,0 +1,156 @@
+#include "../include/outq.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "../include/stats.h"
+
+void outq_init(struct outq *q) {
+    q->items = NULL;
+    q->size = 0;
+    q->first = 0;
+    q->count = 0;
+    q->offset = 0;
+    q->bytes = 0;
+    q->inflight = 0;
+    q->inflightBytes = 0;
+}
+
+/* Double la taille du tableau en remettant les messages dans l'ordre */
+static int outq_grow(struct outq *q) {
+    size_t newSize = q->size ? q->size * 2 : OUTQ_INITIAL_SIZE;
+    struct payload **items = malloc(newSize * sizeof(*items));
+    if (!items) return -1;
+
+    for (size_t i = 0; i < q->count; i++)
+        items[i] = q->items[(q->first + i) % q->size];
+
+    free(q->items);
+    q->items = items;
+    q->size = newSize;
+    q->first = 0;
+    return 0;
+}
+
+int outq_push(struct outq *q, struct payload *p) {
+    if (q->count == q->size && outq_grow(q) < 0) return -1;
+
+    q->items[(q->first + q->count) % q->size] = payload_ref(p);
+    q->count++;
+    q->bytes += p->len;
+    return 0;
+}
+
+/* Retire et relâche le plus ancien message */
+static void outq_pop(struct outq *q) {
+    q->bytes -= q->items[q->first]->len - q->offset;
+    payload_unref(q->items[q->first]);
+
+    q->first = (q->first + 1) % q->size;
+    q->count--;
+    q->offset = 0;
+}
+
+size_t outq_prepare(struct outq *q, struct iovec *iov, size_t max) {
+    // Un iovec par message, à la suite de ceux déjà décrits, le premier de
+    // la file à partir de ce qui reste à envoyer
+    size_t start = q->inflight;
+    size_t nbIov = q->count - start < max ? q->count - start : max;
+    for (size_t i = 0; i < nbIov; i++) {
+        struct payload *p = q->items[(q->first + start + i) % q->size];
+        size_t skip = start + i == 0 ? q->offset : 0;
+        iov[i].iov_base = p->data + skip;
+        iov[i].iov_len = p->len - skip;
+        q->inflightBytes += iov[i].iov_len;
+    }
+
+    q->inflight += nbIov;
+    return nbIov;
+}
+
+void outq_sent(struct outq *q, size_t sent) {
+    q->inflightBytes -= sent < q->inflightBytes ? sent : q->inflightBytes;
+
+    // Relâcher les messages entièrement envoyés
+    while (q->count > 0 && sent >= q->items[q->first]->len - q->offset) {
+        sent -= q->items[q->first]->len - q->offset;
+        outq_pop(q);
+        if (q->inflight) q->inflight--;
+    }
+
+    // Envoi partiel : le reste du message part la fois suivante
+    q->offset += sent;
+    q->bytes -= sent;
+}
+
+/* Envoi direct terminé : plus aucun message n'est décrit */
+static void outq_settle(struct outq *q) {
+    q->inflight = 0;
+    q->inflightBytes = 0;
+}
+
+int outq_flush(struct outq *q, int fd) {
+    struct iovec iov[OUTQ_IOV_MAX];
+
+    while (q->count > 0) {
+        size_t nbIov = outq_prepare(q, iov, OUTQ_IOV_MAX);
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = nbIov;
+
+        ssize_t sent = sendmsg(fd, &msg, MSG_DONTWAIT);
+        stats_add(STAT_SEND_CALLS, 1);
+        if (sent < 0) {
+            outq_settle(q);
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+
+        // Envoi partiel : la socket est pleine
+        size_t before = q->count;
+        outq_sent(q, sent);
+        outq_settle(q);
+        if (before - q->count < nbIov) return 0;
+    }
+
+    return 1;
+}
+
+size_t outq_drop_pending(struct outq *q) {
+    // Le plus ancien message est gardé s'il est partiellement envoyé, ceux
+    // en cours d'envoi aussi
+    size_t keep = q->offset > 0 ? 1 : 0;
+    if (q->inflight > keep) keep = q->inflight;
+    size_t dropped = q->count > keep ? q->count - keep : 0;
+
+    for (size_t i = keep; i < q->count; i++) {
+        struct payload *p = q->items[(q->first + i) % q->size];
+        q->bytes -= p->len;
+        payload_unref(p);
+    }
+
+    q->count = keep;
+    return dropped;
+}
+
+void outq_clear(struct outq *q) {
+    while (q->count > 0) outq_pop(q);
+    free(q->items);
+    outq_init(q);
+}
+
+size_t outq_waiting(const struct outq *q) {
+    return q->bytes - q->inflightBytes;
+}
+
+struct payload *outq_last(const struct outq *q) {
+    return q->count ? q->items[(q->first + q->count - 1) % q->size] : NULL;
+}
+
+int outq_is_empty(const struct outq *q) { return q->count == 0; }
@@ -0,0 +1,89 @@
+#include "../include/payload.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slab/slab.h"
+
+/* Tailles des réserves de messages : une ligne de discussion tient dans la
+ * première, une trame pleine dans la dernière. Au-delà, malloc */
+static const size_t classSizes[] = {256, 1024, 4096 + 256};
+#define NB_CLASSES (sizeof(classSizes) / sizeof(classSizes[0]))
+
+static const char *classNames[NB_CLASSES] = {"payload_256", "payload_1k",
+                                             "payload_4k"};
+static Slab *classes[NB_CLASSES];
+static pthread_once_t classesOnce = PTHREAD_ONCE_INIT;
+
+static void create_classes(void) {
+    for (size_t i = 0; i < NB_CLASSES; i++)
+        classes[i] = slab_create(classNames[i], classSizes[i]);
+}
+
+/* Réserve des messages de len octets, NULL s'ils sont alloués par malloc */
+static Slab *payload_class(size_t len) {
+    pthread_once(&classesOnce, create_classes);
+
+    size_t size = sizeof(struct payload) + len + 1;
+    for (size_t i = 0; i < NB_CLASSES; i++)
+        if (size <= classSizes[i]) return classes[i];
+    return NULL;
+}
+
+struct payload *payload_alloc(size_t len) {
+    Slab *class = payload_class(len);
+    struct payload *p =
+        class ? slab_alloc(class) : malloc(sizeof(*p) + len + 1);
+    if (!p) return NULL;
+
+    p->refs = 1;
+    p->len = len;
+    p->frame = NULL;
+    p->data[len] = '\0';
+    return p;
+}
+
+struct payload *payload_create(const char *data, size_t len) {
+    struct payload *p = payload_alloc(len);
+    if (p) memcpy(p->data, data, len);
+    return p;
+}
+
+struct payload *payload_printf(const char *fmt, ...) {
+    va_list args;
+
+    // Premier passage pour connaître la longueur exacte
+    va_start(args, fmt);
+    int len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (len < 0) return NULL;
+
+    struct payload *p = payload_alloc(len);
+    if (!p) return NULL;
+
+    va_start(args, fmt);
+    vsnprintf(p->data, len + 1, fmt, args);
+    va_end(args);
+
+    return p;
+}
+
+struct payload *payload_ref(struct payload *p) {
+    __atomic_add_fetch(&p->refs, 1, __ATOMIC_RELAXED);
+    return p;
+}
+
+void payload_unref(struct payload *p) {
+    if (p && __atomic_sub_fetch(&p->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        payload_unref(p->frame);
+
+        Slab *class = payload_class(p->len);
+        if (class)
+            slab_release(class, p);
+        else
+            free(p);
+    }
+}
@@ -0,0 +1,219 @@
+#define _DEFAULT_SOURCE
+#include "../include/pool.h"
+
+#include <errno.h>
+#include <stdint.h>
+
+#include "../include/session.h"
+
+static struct worker workers[MAX_WORKERS];
+
+/*================== Démarrage du pool ==================*/
+void pool_run(int nbWorkers, int listenFD) {
+    if (nbWorkers < 1) nbWorkers = 1;
+    if (nbWorkers > MAX_WORKERS) nbWorkers = MAX_WORKERS;
+
+    // Petite pile : un thread du pool n'a que des tampons de la taille d'une
+    // trame sur la sienne
+    pthread_attr_t attr;
+    thread_attr_init(&attr);
+
+    for (int i = 0; i < nbWorkers; i++) {
+        struct worker *w = &workers[i];
+        w->id = i;
+        w->inbox = ring_create(WORKER_INBOX_SIZE, sizeof(struct user *));
+        if (!w->inbox) CHECK_ERR(-1, "ring_create");
+
+        // Première case : la boîte de réception
+        w->size = 64;
+        w->fds = malloc(w->size * sizeof(struct pollfd));
+        w->users = malloc(w->size * sizeof(struct user *));
+        if (!w->fds || !w->users) CHECK_ERR(-1, "malloc");
+        w->fds[0].fd = ring_fd(w->inbox);
+        w->fds[0].events = POLLIN;
+
+        int threadRes = pthread_create(&w->thread, &attr, worker_run, w);
+        CHECK_ERR(threadRes, "pthread_create");
+    }
+    pthread_attr_destroy(&attr);
+
+    // Acceptation bloquante : chaque client va au thread le moins chargé.
+    // Faute de descripteurs, la connexion en attente ferait échouer chaque
+    // nouvel essai : on attend que des clients partent
+    while (1) {
+        struct user *u = user_accept(listenFD);
+        if (!u && user_accept_starved(errno)) usleep(ACCEPT_PAUSE);
+        if (!u) continue;
+
+        struct worker *best = &workers[0];
+        size_t bestLoad = SIZE_MAX;
+        for (int i = 0; i < nbWorkers; i++) {
+            size_t load = __atomic_load_n(&workers[i].load, __ATOMIC_RELAXED);
+            if (load < bestLoad) {
+                best = &workers[i];
+                bestLoad = load;
+            }
+        }
+
+        u->owner = best->id;
+        __atomic_add_fetch(&best->load, 1, __ATOMIC_RELAXED);
+        ring_push_wait(best->inbox, &u);
+    }
+}
+
+/*================== Boucle d'un thread ==================*/
+void *worker_run(void *worker) {
+    struct worker *w = worker;
+    struct user *u;
+
+    while (1) {
+        while (ring_pop(w->inbox, &u) == 0) worker_add(w, u);
+
+        // Attente d'un nouveau client, de données ou d'une échéance d'accueil
+        if (ring_sleep(w->inbox)) {
+            long timeoutUs = handshake_timeout(&w->pending, -1);
+            int timeoutMs = timeoutUs < 0 ? -1 : (timeoutUs + 999) / 1000;
+
+            int pollRes = poll(w->fds, w->count + 1, timeoutMs);
+            stats_add(STAT_WAIT_CALLS, 1);
+            ring_wake(w->inbox);
+            if (pollRes < 0) {
+                if (errno == EINTR) continue;
+                CHECK_ERR(pollRes, "poll");
+            }
+
+            // En partant de la fin, un retrait ne déplace qu'un client déjà
+            // traité
+            for (size_t i = w->count; pollRes > 0 && i-- > 0;)
+                if (w->fds[i + 1].revents) worker_read(w, i);
+        }
+
+        // Clients restés sans pseudo au-delà du délai
+        while ((u = handshake_expired(&w->pending)) != NULL) {
+            for (size_t i = 0; i < w->count; i++) {
+                if (w->users[i] != u) continue;
+                worker_remove(w, i);
+                break;
+            }
+            user_free(u);
+        }
+    }
+
+    return NULL;
+}
+
+/*================== Clients du thread ==================*/
+void worker_add(struct worker *w, struct user *u) {
+    if (w->count + 1 == w->size) {
+        size_t size = w->size * 2;
+        struct pollfd *fds = realloc(w->fds, size * sizeof(struct pollfd));
+        if (fds) w->fds = fds;
+        struct user **users = realloc(w->users, size * sizeof(struct user *));
+        if (users) w->users = users;
+
+        if (!fds || !users) {
+            perror("realloc");
+            __atomic_sub_fetch(&w->load, 1, __ATOMIC_RELAXED);
+            user_free(u);
+            return;
+        }
+        w->size = size;
+    }
+
+    w->users[w->count] = u;
+    w->fds[w->count + 1].fd = u->sock;
+    w->fds[w->count + 1].events = POLLIN;
+    w->fds[w->count + 1].revents = 0;
+    w->count++;
+
+    handshake_start(&w->pending, u);
+}
+
+void worker_remove(struct worker *w, size_t i) {
+    // Le dernier prend la place du client retiré
+    w->count--;
+    w->users[i] = w->users[w->count];
+    w->fds[i + 1] = w->fds[w->count + 1];
+
+    __atomic_sub_fetch(&w->load, 1, __ATOMIC_RELAXED);
+}
+
+int worker_read(struct worker *w, size_t i) {
+    struct user *u = w->users[i];
+
+    if (u->state == USER_NICKNAME) {
+        // Accueil : les commandes reçues avec le pseudo sont traitées ensuite
+        int hsRes = handshake_read(&w->pending, u);
+        if (hsRes < 0) {
+            worker_remove(w, i);
+            user_free(u);
+            return -1;
+        }
+        if (hsRes == 0) return 0;
+
+        // L'historique des salons rejoints à la connexion passe avant le
+        // direct
+        for (size_t j = 0; j < u->nbRooms; j++) {
+            struct message_info replay;
+            login_replay(u, j, &replay);
+            ring_push_wait(repeaterRing, &replay);
+        }
+        struct message_info mail = {.type = MSG_MAILBOX, .sender = u};
+        ring_push_wait(repeaterRing, &mail);
+    } else {
+        // Une seule lecture par réveil, qui peut apporter plusieurs commandes
+        ssize_t readRes = buff_read_more(u->in);
+        stats_add(STAT_RECV_CALLS, 1);
+        if (readRes < 0 && (errno == EAGAIN || errno == EINTR)) return 0;
+
+        if (readRes <= 0) {
+            if (readRes == 0)
+                printf("[DECONNEXION] Connexion fermée par le client %s\n",
+                       u->username);
+            else
+                perror("recv");
+            worker_close(w, i);
+            return -1;
+        }
+    }
+
+    char *line;
+    int nextRes;
+    while ((nextRes = proto_next(u, &line)) > 0) {
+        // Vérifier si c'est une commande de déconnexion
+        if (is_exit_command(line)) {
+            printf("[DECONNEXION] %s a quitté le chat\n", u->username);
+            worker_close(w, i);
+            return -1;
+        }
+
+        // Dépôt dans la file du répéteur, comme un thread client
+        struct message_info msg;
+        build_message(u, line, &msg);
+        ring_push_wait(repeaterRing, &msg);
+    }
+
+    // Trame invalide : impossible de retrouver le début de la suivante
+    if (nextRes < 0) {
+        fprintf(stderr, "[SERVER ERROR] - trame invalide de %s\n",
+                u->username);
+        worker_close(w, i);
+        return -1;
+    }
+
+    return 0;
+}
+
+void worker_close(struct worker *w, size_t i) {
+    struct user *u = w->users[i];
+    worker_remove(w, i);
+
+    // Comme à la fin d'un thread client
+    session_save(u);
+    room_part_all(u);
+    userset_remove(&connectUsers, u);
+    registry_release(u);
+
+    struct message_info leave = {.type = MSG_LEAVE, .sender = u};
+    ring_push_wait(repeaterRing, &leave);
+}
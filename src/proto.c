@@ -0,0 +1,186 @@
+#include "../include/proto.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#define NOTICE_SIZE 256
+
+// Réponses au pseudo : quelques mots, sur la pile d'une coroutine en mode coro
+#define STATUS_SIZE 512
+
+/* Crée la trame f, dont le texte est coupé s'il ne tient pas dans une trame
+ * (comme une ligne trop longue en v1) */
+static struct payload *frame_payload(struct frame *f) {
+    size_t fixed = FRAME_HEADER_SIZE + (f->time ? FRAME_STAMP_SIZE : 0) +
+                   f->senderLen + f->roomLen + 3;
+    if (fixed + f->bodyLen > FRAME_MAX_SIZE) f->bodyLen = FRAME_MAX_SIZE - fixed;
+
+    struct payload *p = payload_alloc(frame_size(f));
+    if (p) frame_encode(f, p->data);
+    return p;
+}
+
+int proto_hello(struct user *u, char **line) {
+    size_t helloLen = strlen(PROTO_HELLO);
+    char *nick = *line + helloLen;
+
+    if (u->proto != PROTO_V1 || strncmp(*line, PROTO_HELLO, helloLen) != 0 ||
+        (*nick != '\0' && *nick != ' '))
+        return 0;
+
+    u->proto = PROTO_V2;
+    while (*nick == ' ') nick++;
+
+    // Avec un pseudo, l'acquittement attend la réponse pour partir avec elle
+    int flags = *nick ? MSG_MORE : 0;
+    send(u->sock, PROTO_ACK "\r\n", strlen(PROTO_ACK "\r\n"), flags);
+
+    *line = *nick ? nick : NULL;
+    return 1;
+}
+
+int proto_next(struct user *u, char **text) {
+    if (u->proto == PROTO_V1) return buff_next_line(u->in, text) >= 0;
+
+    // En-tête décodé en place, le texte reste dans le tampon
+    uint8_t wanted = u->state == USER_NICKNAME ? FRAME_NICK : FRAME_MSG;
+    char *data;
+    struct frame f;
+    ssize_t size;
+    do {
+        size_t len = buff_peek(u->in, &data);
+        size = frame_decode(data, len, &f);
+        if (size <= 0) return size;
+
+        buff_consume(u->in, size);
+    } while (f.type != wanted);
+
+    *text = (char *)f.body;
+    return 1;
+}
+
+struct payload *proto_message(struct user *u, struct room *room,
+                              const char *text) {
+    // Le salon par défaut garde le format texte historique
+    struct payload *p;
+    if (strcmp(room->name, DEFAULT_ROOM) == 0)
+        p = payload_printf("%s: %s\n", u->username, text);
+    else
+        p = payload_printf("%s %s: %s\n", room->name, u->username, text);
+    if (!p) return NULL;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    struct frame f = {.type = FRAME_MSG,
+                      .time = (uint64_t)now.tv_sec * 1000000 +
+                              now.tv_nsec / 1000,
+                      .sender = u->username,
+                      .senderLen = strlen(u->username),
+                      .room = room->name,
+                      .roomLen = strlen(room->name),
+                      .body = text,
+                      .bodyLen = strlen(text)};
+    p->frame = frame_payload(&f);
+    if (!p->frame) {
+        payload_unref(p);
+        return NULL;
+    }
+
+    return p;
+}
+
+struct payload *proto_private(struct user *u, const char *nick,
+                              const char *text) {
+    struct payload *p = payload_printf("[privé] %s: %s\n", u->username, text);
+    if (!p) return NULL;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    struct frame f = {.type = FRAME_PRIVATE,
+                      .time = (uint64_t)now.tv_sec * 1000000 +
+                              now.tv_nsec / 1000,
+                      .sender = u->username,
+                      .senderLen = strlen(u->username),
+                      .room = nick,
+                      .roomLen = strlen(nick),
+                      .body = text,
+                      .bodyLen = strlen(text)};
+    p->frame = frame_payload(&f);
+    if (!p->frame) {
+        payload_unref(p);
+        return NULL;
+    }
+
+    return p;
+}
+
+struct payload *proto_notice(const char *fmt, ...) {
+    char text[NOTICE_SIZE];
+    va_list args;
+
+    va_start(args, fmt);
+    int len = vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    if (len < 0) return NULL;
+
+    struct payload *p = payload_printf("*** %s ***\n", text);
+    if (!p) return NULL;
+
+    struct frame f = {
+        .type = FRAME_NOTICE, .body = text, .bodyLen = strlen(text)};
+    p->frame = frame_payload(&f);
+    if (!p->frame) {
+        payload_unref(p);
+        return NULL;
+    }
+
+    return p;
+}
+
+ssize_t proto_send_status(struct user *u, int status, const char *text,
+                          const char *prompt) {
+    char buffer[STATUS_SIZE];
+    size_t len;
+
+    if (u->proto == PROTO_V2) {
+        struct frame f = {.type = FRAME_NICK,
+                          .seq = status,
+                          .body = text,
+                          .bodyLen = strlen(text)};
+        len = frame_size(&f) <= sizeof(buffer) ? frame_encode(&f, buffer) : 0;
+    } else {
+        len = snprintf(buffer, sizeof(buffer), "%s\n%s", text, prompt);
+        if (len >= sizeof(buffer)) len = 0;
+    }
+
+    if (len == 0) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    return send(u->sock, buffer, len, 0);
+}
+
+ssize_t proto_send_session(struct user *u, uint64_t seq) {
+    if (u->proto != PROTO_V2) return 0;
+
+    // Horodatée pour porter le numéro sur 64 bits
+    char buffer[FRAME_HEADER_SIZE + FRAME_STAMP_SIZE + USER_TOKEN_SIZE + 2];
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    struct frame f = {.type = FRAME_SESSION,
+                      .seq = seq,
+                      .time = (uint64_t)now.tv_sec * 1000000 +
+                              now.tv_nsec / 1000,
+                      .body = u->token,
+                      .bodyLen = strlen(u->token)};
+    return send(u->sock, buffer, frame_encode(&f, buffer), 0);
+}
+
+struct payload *proto_payload(struct user *u, struct payload *p) {
+    return u->proto == PROTO_V2 ? p->frame : p;
+}
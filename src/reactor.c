@@ -0,0 +1,399 @@
+#define _GNU_SOURCE
+#include "../include/reactor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+
+#include "../include/session.h"
+
+/* Pointeur marquant l'eventfd de la boîte de réception dans epoll */
+#define INBOX_TAG ((void *)1)
+
+static struct reactor reactors[MAX_REACTORS];
+static int nbReactorsRunning;
+
+/*================== Démarrage des réacteurs ==================*/
+void reactors_run(int nbReactors, int listenFD, uint16_t port) {
+    if (nbReactors < 1) nbReactors = 1;
+    if (nbReactors > MAX_REACTORS) nbReactors = MAX_REACTORS;
+    nbReactorsRunning = nbReactors;
+
+    long nbCores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nbCores < 1) nbCores = 1;
+
+    for (int i = 0; i < nbReactors; i++) {
+        struct reactor *r = &reactors[i];
+        r->id = i;
+        r->inbox = list_create();
+        r->drained = list_create();
+        pthread_mutex_init(&r->mutexInbox, NULL);
+        for (int j = 0; j < nbReactors; j++) r->outbox[j] = list_create();
+
+        // Le premier réacteur reprend la socket déjà ouverte
+        r->listenFD = i == 0 ? listenFD : create_listening_sock(port, 1);
+
+        int flags = fcntl(r->listenFD, F_GETFL, 0);
+        int fcntlRes = fcntl(r->listenFD, F_SETFL, flags | O_NONBLOCK);
+        CHECK_ERR(fcntlRes, "fcntl");
+
+        r->epollFD = epoll_create1(0);
+        CHECK_ERR(r->epollFD, "epoll_create1");
+
+        r->inboxFD = eventfd(0, EFD_NONBLOCK);
+        CHECK_ERR(r->inboxFD, "eventfd");
+
+        // La socket d'écoute est repérée par un pointeur NULL
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+        int ctlRes = epoll_ctl(r->epollFD, EPOLL_CTL_ADD, r->listenFD, &ev);
+        CHECK_ERR(ctlRes, "epoll_ctl");
+
+        ev.data.ptr = INBOX_TAG;
+        ctlRes = epoll_ctl(r->epollFD, EPOLL_CTL_ADD, r->inboxFD, &ev);
+        CHECK_ERR(ctlRes, "epoll_ctl");
+    }
+
+    for (int i = 0; i < nbReactors; i++) {
+        int threadRes =
+            pthread_create(&reactors[i].thread, NULL, reactor_run, &reactors[i]);
+        CHECK_ERR(threadRes, "pthread_create");
+
+        // Un réacteur par coeur, dans la limite des coeurs disponibles
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(i % nbCores, &cpus);
+        pthread_setaffinity_np(reactors[i].thread, sizeof(cpus), &cpus);
+    }
+
+    for (int i = 0; i < nbReactors; i++) pthread_join(reactors[i].thread, NULL);
+}
+
+/*================== Boucle principale ==================*/
+void *reactor_run(void *reactor) {
+    struct reactor *r = reactor;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (1) {
+        // Avec une fenêtre, on attend d'autres messages avant d'envoyer le
+        // lot, sans dépasser la prochaine échéance d'accueil ni la reprise
+        // de l'écoute
+        long timeoutUs = accept_resume(
+            r->epollFD, r->listenFD, &r->acceptResume,
+            handshake_timeout(&r->pending, batch_timeout(&r->batch)));
+        int nbEvents = wait_events(r->epollFD, events, MAX_EVENTS, timeoutUs);
+        if (nbEvents < 0) {
+            if (errno == EINTR) continue;
+            CHECK_ERR(nbEvents, "epoll_pwait2");
+        }
+
+        for (int i = 0; i < nbEvents; i++) {
+            struct user *u = events[i].data.ptr;
+
+            if (!u) {
+                reactor_accept(r);
+            } else if (u == INBOX_TAG) {
+                reactor_drain_inbox(r);
+            } else {
+                // Une écriture en échec ferme la connexion
+                if ((events[i].events & EPOLLOUT) && reactor_write(r, u) < 0)
+                    continue;
+                if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                    reactor_read(r, u);
+            }
+        }
+
+        // Clients restés sans pseudo au-delà du délai
+        struct user *u;
+        while ((u = handshake_expired(&r->pending)) != NULL)
+            reactor_close(r, u);
+
+        if (batch_due(&r->batch, nbEvents == 0)) reactor_flush(r);
+    }
+
+    return NULL;
+}
+
+/*================== Nouvelles connexions ==================*/
+void reactor_accept(struct reactor *r) {
+    struct user *u;
+
+    while ((u = user_accept(r->listenFD)) != NULL) {
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = u};
+        if (epoll_ctl(r->epollFD, EPOLL_CTL_ADD, u->sock, &ev) < 0) {
+            perror("epoll_ctl");
+            user_free(u);
+            continue;
+        }
+        u->events = EPOLLIN;
+        u->owner = r->id;
+
+        handshake_start(&r->pending, u);
+    }
+
+    // Faute de descripteurs, la connexion en attente réveillerait la boucle
+    // à chaque tour
+    accept_pause(r->epollFD, r->listenFD, &r->acceptResume);
+}
+
+/*================== Lecture d'un client ==================*/
+void reactor_read(struct reactor *r, struct user *u) {
+    if (u->state == USER_NICKNAME) {
+        // Accueil : les commandes reçues avec le pseudo sont traitées ensuite
+        int hsRes = handshake_read(&r->pending, u);
+        if (hsRes < 0) reactor_close(r, u);
+        if (hsRes <= 0) return;
+
+        // L'historique des salons rejoints à la connexion passe avant le
+        // direct
+        for (size_t i = 0; i < u->nbRooms; i++) {
+            struct message_info replay;
+            login_replay(u, i, &replay);
+            replay_room(u, replay.room, replay.payload, replay.seq, &r->batch);
+            payload_unref(replay.payload);
+        }
+        login_mailbox(u, &r->batch);
+    } else {
+        // Une seule lecture par événement, qui peut apporter plusieurs
+        // commandes
+        ssize_t readRes = buff_read_more(u->in);
+        stats_add(STAT_RECV_CALLS, 1);
+        if (readRes < 0 && errno == EAGAIN) return;
+
+        // Vérifier si le client s'est déconnecté
+        if (readRes <= 0) {
+            if (readRes == 0)
+                printf("[DECONNEXION] Connexion fermée par le client %s\n",
+                       u->username);
+            else
+                perror("recv");
+            reactor_close(r, u);
+            return;
+        }
+    }
+
+    // Traiter toutes les commandes complètes, la fin partielle attend la
+    // suite
+    char *line;
+    int nextRes;
+    while ((nextRes = proto_next(u, &line)) > 0)
+        if (reactor_line(r, u, line) < 0) return;
+
+    // Trame invalide : impossible de retrouver le début de la suivante
+    if (nextRes < 0) {
+        fprintf(stderr, "[SERVER ERROR] - trame invalide de %s\n",
+                u->username);
+        reactor_close(r, u);
+    }
+}
+
+int reactor_line(struct reactor *r, struct user *u, char *line) {
+    // Vérifier si c'est une commande de déconnexion
+    if (is_exit_command(line)) {
+        printf("[DECONNEXION] %s a quitté le chat\n", u->username);
+        reactor_close(r, u);
+        return -1;
+    }
+
+    // Pas de répéteur ici : la diffusion se fait directement depuis la boucle
+    struct message_info msg;
+    build_message(u, line, &msg);
+    if (msg.type == MSG_NOTICE) {
+        batch_begin(&r->batch);
+        if (repeat_message(u, msg.payload) == 0) batch_add(&r->batch, u);
+    } else if (msg.type == MSG_REPLAY) {
+        replay_room(u, msg.room, msg.payload, 0, &r->batch);
+    } else if (msg.type == MSG_PRIVATE) {
+        reactor_private(r, &msg);
+    } else {
+        reactor_broadcast(r, &msg);
+    }
+    payload_unref(msg.payload);
+    return 0;
+}
+
+/*================== Écriture vers un client ==================*/
+int reactor_write(struct reactor *r, struct user *u) {
+    if (u->state != USER_CLOSING && outq_flush(&u->outq, u->sock) < 0) {
+        reactor_close(r, u);
+        return -1;
+    }
+
+    user_update_events(u, r->epollFD, EPOLLIN);
+    return 0;
+}
+
+/*================== Déconnexion ==================*/
+void reactor_close(struct reactor *r, struct user *u) {
+    epoll_ctl(r->epollFD, EPOLL_CTL_DEL, u->sock, NULL);
+    batch_remove(&r->batch, u);
+
+    // Client sans pseudo, déjà sorti de la file d'accueil
+    if (u->state == USER_NICKNAME) {
+        user_free(u);
+        return;
+    }
+
+    // Un autre réacteur peut être en train de comparer son pseudo : u n'est
+    // libéré qu'une fois sorti de toutes les lectures en cours
+    session_save(u);
+    room_part_all(u);
+    registry_release(u);
+    userset_remove(&connectUsers, u);
+    user_shutdown(u);
+    userset_retire(u);
+}
+
+/*================== Diffusion ==================*/
+static void deliver_local(struct reactor *r, struct message_info *msg) {
+    // Seuls les membres du salon sont parcourus ; chaque réacteur ne sert
+    // que ceux dont il gère la socket, reconnus sans toucher aux autres
+    const struct user_set *members = userset_read_begin(&msg->room->members);
+
+    // De la fin vers le début, lignes en cours de réécriture sautées (voir
+    // userset.h)
+    for (size_t i = userset_count(members); i-- > 0;) {
+        unsigned gen = __atomic_load_n(&members->gens[i], __ATOMIC_ACQUIRE);
+        int sock = __atomic_load_n(&members->socks[i], __ATOMIC_RELAXED);
+        int owner = __atomic_load_n(&members->owners[i], __ATOMIC_RELAXED);
+        uint64_t from = __atomic_load_n(&members->from[i], __ATOMIC_RELAXED);
+        struct user *u =
+            __atomic_load_n(&members->users[i], __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (gen & 1 ||
+            gen != __atomic_load_n(&members->gens[i], __ATOMIC_RELAXED) ||
+            owner != r->id || sock == msg->sender_socket || msg->seq < from)
+            continue;
+
+        if (repeat_member(u, msg->payload) == 0) batch_add(&r->batch, u);
+    }
+
+    userset_read_end();
+}
+
+/* Diffusion en cours de numérotation par un réacteur */
+struct broadcast_post {
+    struct reactor *r;
+    struct message_info *copies[MAX_REACTORS]; /* un avis par autre réacteur */
+};
+
+/* Appelé sous le verrou du numéro : les avis arrivent chez les autres dans
+ * l'ordre des numéros, et tout ce que r a reçu avant est repris pour être
+ * servi avant ce message */
+static void post_broadcast(void *arg, uint64_t seq) {
+    struct broadcast_post *post = arg;
+    struct reactor *r = post->r;
+
+    for (int i = 0; i < nbReactorsRunning; i++) {
+        if (!post->copies[i]) continue;
+        post->copies[i]->seq = seq;
+
+        struct reactor *other = &reactors[i];
+        pthread_mutex_lock(&other->mutexInbox);
+        list_add(other->inbox, post->copies[i]);
+        pthread_mutex_unlock(&other->mutexInbox);
+        r->posted[i] = 1;
+    }
+
+    pthread_mutex_lock(&r->mutexInbox);
+    LIST *tmp = r->drained;
+    r->drained = r->inbox;
+    r->inbox = tmp;
+    pthread_mutex_unlock(&r->mutexInbox);
+}
+
+/* Distribue puis libère les messages repris de la boîte de r */
+static void serve_drained(struct reactor *r) {
+    while (!list_is_empty(r->drained)) {
+        struct message_info *msg = list_remove_first(r->drained);
+        if (msg->type == MSG_PRIVATE)
+            reactor_private(r, msg);
+        else
+            deliver_local(r, msg);
+        payload_unref(msg->payload);
+        free(msg);
+    }
+}
+
+void reactor_broadcast(struct reactor *r, struct message_info *msg) {
+    batch_begin(&r->batch);
+
+    // Un avis par réacteur distant, qui le libérera après distribution ; le
+    // contenu est partagé, seule une référence est ajoutée
+    struct broadcast_post post = {.r = r};
+    for (int i = 0; i < nbReactorsRunning; i++) {
+        if (i == r->id) continue;
+
+        struct message_info *copy = malloc(sizeof(*copy));
+        if (!copy) {
+            perror("malloc");
+            continue;
+        }
+        memcpy(copy, msg, sizeof(*copy));
+        payload_ref(copy->payload);
+        post.copies[i] = copy;
+    }
+
+    // Seul, le réacteur numérote sans rien déposer
+    msg->seq = room_publish(msg->room, msg->payload,
+                            nbReactorsRunning > 1 ? post_broadcast : NULL,
+                            &post);
+    serve_drained(r);
+    deliver_local(r, msg);
+}
+
+void reactor_private(struct reactor *r, struct message_info *msg) {
+    int owner = send_private(msg, r->id, &r->batch);
+    if (owner < 0) return;
+
+    // Destinataire servi par un autre réacteur : déposé chez lui comme une
+    // diffusion, sans l'émetteur, qu'il ne peut pas toucher
+    struct message_info *copy = malloc(sizeof(*copy));
+    if (!copy) {
+        perror("malloc");
+        return;
+    }
+    memcpy(copy, msg, sizeof(*copy));
+    copy->sender = NULL;
+    payload_ref(copy->payload);
+
+    r->outbox[owner] = list_add(r->outbox[owner], copy);
+}
+
+void reactor_flush(struct reactor *r) {
+    for (int i = 0; i < nbReactorsRunning; i++) {
+        struct reactor *other = &reactors[i];
+
+        // Un verrou et un réveil par réacteur distant pour tout le tour
+        if (!list_is_empty(r->outbox[i])) {
+            pthread_mutex_lock(&other->mutexInbox);
+            while (!list_is_empty(r->outbox[i]))
+                list_add(other->inbox, list_remove_first(r->outbox[i]));
+            pthread_mutex_unlock(&other->mutexInbox);
+            r->posted[i] = 1;
+        }
+        if (!r->posted[i]) continue;
+        r->posted[i] = 0;
+
+        uint64_t one = 1;
+        if (write(other->inboxFD, &one, sizeof(one)) < 0) perror("write");
+    }
+
+    batch_flush(&r->batch, r->epollFD, EPOLLIN);
+}
+
+void reactor_drain_inbox(struct reactor *r) {
+    uint64_t count;
+    if (read(r->inboxFD, &count, sizeof(count)) < 0) return;
+
+    // On récupère toute la boîte d'un coup pour relâcher le verrou au plus tôt
+    pthread_mutex_lock(&r->mutexInbox);
+    LIST *tmp = r->drained;
+    r->drained = r->inbox;
+    r->inbox = tmp;
+    pthread_mutex_unlock(&r->mutexInbox);
+
+    if (!list_is_empty(r->drained)) batch_begin(&r->batch);
+    serve_drained(r);
+}
@@ -0,0 +1,178 @@
+#include "../include/registry.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "../include/serveur.h"
+
+/* Une case vide a un utilisateur NULL ; le hachage y est gardé pour éviter
+ * de recalculer ou de comparer des pseudos inutilement */
+struct slot {
+    uint32_t hash;
+    struct user *user;
+};
+
+struct table {
+    struct slot *slots;
+    size_t mask;
+    size_t count;
+};
+
+static struct table byNick, byFd;
+static pthread_mutex_t mutexRegistry = PTHREAD_MUTEX_INITIALIZER;
+
+/*================== Hachage ==================*/
+/* FNV-1a */
+static uint32_t hash_nick(const char *nick) {
+    uint32_t h = 2166136261u;
+    for (; *nick; nick++) h = (h ^ (unsigned char)*nick) * 16777619u;
+    return h;
+}
+
+/* Les descripteurs se suivent : on les disperse par multiplication */
+static uint32_t hash_fd(int fd) { return (uint32_t)fd * 2654435761u; }
+
+/*================== Table à adressage ouvert ==================*/
+static int table_init(struct table *t, size_t size) {
+    t->slots = calloc(size, sizeof(struct slot));
+    if (!t->slots) return -1;
+    t->mask = size - 1;
+    t->count = 0;
+    return 0;
+}
+
+/* Place u sans vérifier s'il y est déjà ; la table a de la place */
+static void table_place(struct table *t, uint32_t hash, struct user *u) {
+    size_t i = hash & t->mask;
+    while (t->slots[i].user) i = (i + 1) & t->mask;
+
+    t->slots[i].hash = hash;
+    t->slots[i].user = u;
+    t->count++;
+}
+
+/* Double la table si elle est à moitié pleine */
+static int table_reserve(struct table *t) {
+    if ((t->count + 1) * 2 <= t->mask + 1) return 0;
+
+    struct table bigger;
+    if (table_init(&bigger, (t->mask + 1) * 2) < 0) return -1;
+
+    for (size_t i = 0; i <= t->mask; i++)
+        if (t->slots[i].user)
+            table_place(&bigger, t->slots[i].hash, t->slots[i].user);
+
+    free(t->slots);
+    *t = bigger;
+    return 0;
+}
+
+/* Retire u en recollant la suite de la chaîne de sondage derrière lui */
+static void table_remove(struct table *t, uint32_t hash, struct user *u) {
+    size_t i = hash & t->mask;
+    while (t->slots[i].user && t->slots[i].user != u) i = (i + 1) & t->mask;
+    if (!t->slots[i].user) return;
+
+    size_t hole = i;
+    for (size_t j = (i + 1) & t->mask; t->slots[j].user; j = (j + 1) & t->mask) {
+        // Une case ne peut reculer dans le trou que si sa place idéale
+        // n'est pas entre le trou et elle
+        size_t ideal = t->slots[j].hash & t->mask;
+        if (((j - ideal) & t->mask) >= ((j - hole) & t->mask)) {
+            t->slots[hole] = t->slots[j];
+            hole = j;
+        }
+    }
+
+    t->slots[hole].user = NULL;
+    t->count--;
+}
+
+static struct user *find_nick(const char *nick, uint32_t hash) {
+    for (size_t i = hash & byNick.mask; byNick.slots[i].user;
+         i = (i + 1) & byNick.mask) {
+        struct slot *s = &byNick.slots[i];
+        if (s->hash == hash && strcmp(s->user->username, nick) == 0)
+            return s->user;
+    }
+    return NULL;
+}
+
+/*================== Annuaire ==================*/
+void registry_init(void) {
+    if (table_init(&byNick, REGISTRY_INITIAL_SIZE) < 0 ||
+        table_init(&byFd, REGISTRY_INITIAL_SIZE) < 0) {
+        perror("registry_init");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int registry_reserve(struct user *u, const char *nick) {
+    uint32_t hash = hash_nick(nick);
+
+    pthread_mutex_lock(&mutexRegistry);
+
+    if (find_nick(nick, hash)) {
+        pthread_mutex_unlock(&mutexRegistry);
+        return 1;
+    }
+    if (table_reserve(&byNick) < 0 || table_reserve(&byFd) < 0) {
+        pthread_mutex_unlock(&mutexRegistry);
+        return -1;
+    }
+
+    strncpy(u->username, nick, NICKNAME_SIZE - 1);
+    u->username[NICKNAME_SIZE - 1] = '\0';
+    u->registered = 1;
+    table_place(&byNick, hash, u);
+    table_place(&byFd, hash_fd(u->sock), u);
+
+    pthread_mutex_unlock(&mutexRegistry);
+    return 0;
+}
+
+void registry_release(struct user *u) {
+    pthread_mutex_lock(&mutexRegistry);
+
+    if (u->registered) {
+        table_remove(&byNick, hash_nick(u->username), u);
+        table_remove(&byFd, hash_fd(u->sock), u);
+        u->registered = 0;
+    }
+
+    pthread_mutex_unlock(&mutexRegistry);
+}
+
+struct user *registry_find_nick(const char *nick) {
+    uint32_t hash = hash_nick(nick);
+
+    pthread_mutex_lock(&mutexRegistry);
+    struct user *u = find_nick(nick, hash);
+    pthread_mutex_unlock(&mutexRegistry);
+
+    return u;
+}
+
+struct user *registry_find_fd(int fd) {
+    uint32_t hash = hash_fd(fd);
+    struct user *u = NULL;
+
+    pthread_mutex_lock(&mutexRegistry);
+    for (size_t i = hash & byFd.mask; byFd.slots[i].user;
+         i = (i + 1) & byFd.mask) {
+        if (byFd.slots[i].user->sock == fd) {
+            u = byFd.slots[i].user;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mutexRegistry);
+
+    return u;
+}
+
+size_t registry_count(void) {
+    pthread_mutex_lock(&mutexRegistry);
+    size_t count = byNick.count;
+    pthread_mutex_unlock(&mutexRegistry);
+    return count;
+}
@@ -0,0 +1,191 @@
+#include "../include/room.h"
+
+#include <stdint.h>
+
+#include "../include/proto.h"
+
+/* Table à adressage ouvert des salons, deux fois plus grande que le nombre
+ * maximal de salons ; sans suppression */
+#define ROOM_TABLE_SIZE (2 * MAX_ROOMS)
+
+static struct room *rooms[ROOM_TABLE_SIZE];
+static int nbRooms;
+static pthread_mutex_t mutexRooms = PTHREAD_MUTEX_INITIALIZER;
+
+// Budget de l'historique de chaque salon
+static size_t maxMessages, maxBytes;
+
+// Journal des messages, NULL sans persistance
+static Journal *messageJournal;
+
+// Numérotation de tous les messages diffusés
+static uint64_t lastSeq;
+static pthread_mutex_t mutexSeq = PTHREAD_MUTEX_INITIALIZER;
+
+/* FNV-1a */
+static uint32_t hash_name(const char *name) {
+    uint32_t h = 2166136261u;
+    for (; *name; name++) h = (h ^ (unsigned char)*name) * 16777619u;
+    return h;
+}
+
+void rooms_init(size_t historyMessages, size_t historyBytes,
+                Journal *journal) {
+    maxMessages = historyMessages;
+    maxBytes = historyBytes;
+    messageJournal = journal;
+    lastSeq = journal ? journal_last_seq(journal) : 0;
+
+    if (!room_get(DEFAULT_ROOM, 1)) {
+        perror("rooms_init");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int room_check_name(const char *name) {
+    size_t len = strlen(name);
+    if (name[0] != '#' || len < 2 || len >= ROOM_NAME_SIZE) return -1;
+
+    for (size_t i = 1; i < len; i++)
+        if (name[i] == ' ' || name[i] == ':' || name[i] == '#') return -1;
+
+    return 0;
+}
+
+struct room *room_get(const char *name, int create) {
+    if (room_check_name(name) < 0) return NULL;
+
+    pthread_mutex_lock(&mutexRooms);
+
+    size_t i = hash_name(name) % ROOM_TABLE_SIZE;
+    while (rooms[i] && strcmp(rooms[i]->name, name) != 0)
+        i = (i + 1) % ROOM_TABLE_SIZE;
+
+    struct room *room = rooms[i];
+    if (!room && create && nbRooms < MAX_ROOMS) {
+        room = malloc(sizeof(struct room));
+        // Ce qui précède sa création n'est que dans le journal
+        if (room && scrollback_init(&room->history, maxMessages, maxBytes,
+                                    rooms_last_seq()) < 0) {
+            free(room);
+            room = NULL;
+        }
+        if (room) {
+            strcpy(room->name, name);
+            userset_init(&room->members);
+            pthread_mutex_init(&room->mutexHistory, NULL);
+            room->seq = 0;
+            rooms[i] = room;
+            nbRooms++;
+        }
+    }
+
+    pthread_mutex_unlock(&mutexRooms);
+    return room;
+}
+
+/* Position de room dans les salons de u, ou -1 */
+static int find_membership(struct user *u, struct room *room) {
+    for (size_t i = 0; i < u->nbRooms; i++)
+        if (u->rooms[i] == room) return i;
+    return -1;
+}
+
+int room_join(struct user *u, struct room *room) {
+    int pos = find_membership(u, room);
+
+    // Déjà membre : le salon redevient le plus récent
+    if (pos >= 0) {
+        memmove(u->rooms + pos, u->rooms + pos + 1,
+                (u->nbRooms - pos - 1) * sizeof(struct room *));
+        u->rooms[u->nbRooms - 1] = room;
+        u->room = room;
+        return 0;
+    }
+
+    struct room **joined =
+        realloc(u->rooms, (u->nbRooms + 1) * sizeof(struct room *));
+    if (!joined) return -1;
+    u->rooms = joined;
+
+    // Rien en direct avant que son historique ne soit dans sa file
+    if (userset_add(&room->members, u, USERSET_PENDING) < 0) return -1;
+
+    u->rooms[u->nbRooms++] = room;
+    u->room = room;
+    return 1;
+}
+
+int room_part(struct user *u, struct room *room) {
+    int pos = find_membership(u, room);
+    if (pos < 0) return -1;
+
+    userset_remove(&room->members, u);
+
+    memmove(u->rooms + pos, u->rooms + pos + 1,
+            (u->nbRooms - pos - 1) * sizeof(struct room *));
+    u->nbRooms--;
+    u->room = u->nbRooms ? u->rooms[u->nbRooms - 1] : NULL;
+    return 0;
+}
+
+void room_part_all(struct user *u) {
+    // Chaque salon est quitté par son index : sans recherche dans u->rooms
+    while (u->nbRooms) userset_remove(&u->rooms[--u->nbRooms]->members, u);
+    u->room = NULL;
+}
+
+uint64_t rooms_last_seq(void) {
+    pthread_mutex_lock(&mutexSeq);
+    uint64_t seq = lastSeq;
+    pthread_mutex_unlock(&mutexSeq);
+    return seq;
+}
+
+uint64_t room_publish(struct room *room, struct payload *p,
+                      void (*post)(void *arg, uint64_t seq), void *arg) {
+    // Gardé sous le verrou du salon : l'historique suit l'ordre des numéros.
+    // Le numéro, l'ajout au journal et le dépôt vers les destinataires vont
+    // ensemble : tous les reçoivent dans l'ordre
+    pthread_mutex_lock(&room->mutexHistory);
+    pthread_mutex_lock(&mutexSeq);
+    uint64_t seq = ++lastSeq;
+    frame_set_seq(p->frame->data, seq);
+    // Refusé si l'écrivain a trop de retard, compté par le journal
+    if (messageJournal)
+        journal_append(messageJournal, seq, p->frame->data, p->frame->len);
+    if (post) post(arg, seq);
+    pthread_mutex_unlock(&mutexSeq);
+
+    room->seq = seq;
+    scrollback_push(&room->history, p, seq);
+    pthread_mutex_unlock(&room->mutexHistory);
+
+    return seq;
+}
+
+ssize_t room_history(struct room *room, struct user *u, uint64_t after,
+                     struct payload ***history, uint64_t *missing) {
+    *history = NULL;
+    if (room->history.size > 0 &&
+        !(*history = malloc(room->history.size * sizeof(**history))))
+        perror("malloc");
+
+    // Les messages gardés sont rejoués, les suivants arrivent en direct ;
+    // sans tableau, rien n'est rejoué mais la suite arrive quand même
+    pthread_mutex_lock(&room->mutexHistory);
+    size_t count =
+        *history ? scrollback_copy(&room->history, after, *history) : 0;
+    uint64_t last = room->seq;
+    uint64_t evicted = room->history.evicted;
+    pthread_mutex_unlock(&room->mutexHistory);
+    *missing = after && evicted > after ? evicted : 0;
+
+    if (userset_set_from(&room->members, u, last + 1) == 0) return count;
+
+    // Déjà servi, ou parti entre-temps
+    for (size_t i = 0; i < count; i++) payload_unref((*history)[i]);
+    free(*history);
+    *history = NULL;
+    return -1;
+}
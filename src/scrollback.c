@@ -0,0 +1,72 @@
+#include "../include/scrollback.h"
+
+#include <stdlib.h>
+
+/* Octets d'un message sous toutes ses formes */
+static size_t payload_bytes(const struct payload *p) {
+    return p->len + (p->frame ? p->frame->len : 0);
+}
+
+int scrollback_init(struct scrollback *sb, size_t size, size_t maxBytes,
+                    uint64_t start) {
+    sb->items = NULL;
+    sb->seqs = NULL;
+    if (size > 0 && (!(sb->items = malloc(size * sizeof(*sb->items))) ||
+                     !(sb->seqs = malloc(size * sizeof(*sb->seqs))))) {
+        free(sb->items);
+        return -1;
+    }
+
+    sb->evicted = start;
+    sb->size = size;
+    sb->first = 0;
+    sb->count = 0;
+    sb->bytes = 0;
+    sb->maxBytes = maxBytes;
+    return 0;
+}
+
+/* Relâche le plus ancien message */
+static void scrollback_pop(struct scrollback *sb) {
+    struct payload *p = sb->items[sb->first];
+    sb->bytes -= payload_bytes(p);
+    sb->evicted = sb->seqs[sb->first];
+    payload_unref(p);
+
+    sb->first = (sb->first + 1) % sb->size;
+    sb->count--;
+}
+
+void scrollback_push(struct scrollback *sb, struct payload *p, uint64_t seq) {
+    if (sb->size == 0) {
+        sb->evicted = seq;
+        return;
+    }
+
+    size_t len = payload_bytes(p);
+    while (sb->count > 0 &&
+           (sb->count == sb->size || sb->bytes + len > sb->maxBytes))
+        scrollback_pop(sb);
+    if (len > sb->maxBytes) {
+        sb->evicted = seq;
+        return;
+    }
+
+    uint32_t last = (sb->first + sb->count) % sb->size;
+    sb->items[last] = payload_ref(p);
+    sb->seqs[last] = seq;
+    sb->count++;
+    sb->bytes += len;
+}
+
+size_t scrollback_copy(const struct scrollback *sb, uint64_t after,
+                       struct payload **out) {
+    // Les numéros croissent : seuls les plus récents sont à reprendre
+    size_t skip = 0;
+    while (skip < sb->count && sb->seqs[(sb->first + skip) % sb->size] <= after)
+        skip++;
+
+    for (size_t i = skip; i < sb->count; i++)
+        out[i - skip] = payload_ref(sb->items[(sb->first + i) % sb->size]);
+    return sb->count - skip;
+}
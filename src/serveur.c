@@ -1,172 +1,902 @@
+#define _GNU_SOURCE
 #include "../include/serveur.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "../include/coserver.h"
+#include "../include/history.h"
+#include "../include/mailbox.h"
+#include "../include/pool.h"
+#include "../include/session.h"
+#include "../include/reactor.h"
+#include "../include/uring.h"
+
 /*================== Variables globales ==================*/
+struct userset connectUsers;
+struct server_config config = {MODE_THREAD,         PORT_FREESCORD,
+                               1,                   DEFAULT_HIGH_WATER,
+                               LAG_COALESCE,        DEFAULT_BATCH_WINDOW,
+                               DEFAULT_BATCH_CAP,   DEFAULT_HANDSHAKE_TIMEOUT,
+                               DEFAULT_POOL_WORKERS, DEFAULT_STACK_SIZE,
+                               DEFAULT_HISTORY_MESSAGES,
+                               DEFAULT_HISTORY_BYTES,
+                               NULL,                DEFAULT_JOURNAL_SYNC,
+                               0,                   0,
+                               DEFAULT_MAILBOX_BYTES, NULL};
 int socketFD;
-int myTube[2];
-LIST *connectUsers;
+Ring *repeaterRing;
 pthread_t threadRepeater;
-pthread_mutex_t mutexUser = PTHREAD_MUTEX_INITIALIZER;
+int repeaterEpoll;
+Journal *messageJournal;
 
 /*================== Fonction principale ==================*/
 int main(int argc, char *argv[]) {
-    uint16_t port = argc == 2 ? atoi(argv[1]) : PORT_FREESCORD;
-
-    // Gestion de la fermeture du serveur
-    signal(SIGINT, on_exit);
-
-    // Création du pipe
-    int pipeRes = pipe(myTube);
-    CHECK_ERR(pipeRes, "pipe");
+    parse_options(argc, argv, &config);
+
+    // Arrêt et compteurs traités par un thread dédié, hors de tout
+    // gestionnaire : les autres threads, créés ensuite, bloquent ces signaux
+    static sigset_t handled;
+    sigemptyset(&handled);
+    sigaddset(&handled, SIGINT);
+    sigaddset(&handled, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &handled, NULL);
+    pthread_t threadSignals;
+    int sigThreadRes =
+        pthread_create(&threadSignals, NULL, signal_thread, &handled);
+    CHECK_ERR(sigThreadRes, "pthread_create");
+
+    // Un client parti ne doit pas tuer le serveur lors d'un send
+    signal(SIGPIPE, SIG_IGN);
+
+    // Autoriser autant de sockets que la limite dure le permet
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
 
-    connectUsers = list_create();
+    // File entre les threads clients et le répéteur
+    repeaterRing = ring_create(REPEATER_RING_SIZE, sizeof(struct message_info));
+    if (!repeaterRing) CHECK_ERR(-1, "ring_create");
+
+    userset_setup();
+    userset_init(&connectUsers);
+    registry_init();
+
+    // Journal des messages : son écrivain démarre avant le premier message
+    if (config.journalDir) {
+        struct journal_options opts = {
+            .syncInterval = config.journalSync < 0 ? -1
+                                                   : config.journalSync * 1000,
+            .maxBytes = config.journalMaxBytes,
+            .maxAge = config.journalMaxAge};
+        messageJournal = journal_open(config.journalDir, &opts);
+        if (!messageJournal) CHECK_ERR(-1, "journal_open");
+    }
+    rooms_init(config.historyMessages, config.historyBytes, messageJournal);
+    if (mailbox_init(config.mailboxBytes, config.mailboxDir) < 0)
+        CHECK_ERR(-1, "mailbox_init");
 
     // Création de la socket d'écoute
-    socketFD = create_listening_sock(port);
-    printf("Listening on port %d\n", port);
+    int reusePort = (config.mode == MODE_EPOLL || config.mode == MODE_URING) &&
+                    config.nbReactors > 1;
+    socketFD = create_listening_sock(config.port, reusePort);
+    printf("Listening on port %d\n", config.port);
+
+    // Mode uring : repli sur epoll si le noyau ne le permet pas
+    if (config.mode == MODE_URING) {
+        uring_run(socketFD);
+        perror("io_uring indisponible, repli sur epoll");
+        config.mode = MODE_EPOLL;
+    }
+
+    // Mode epoll : les boucles d'événements gèrent tous les clients
+    if (config.mode == MODE_EPOLL) {
+        reactors_run(config.nbReactors, socketFD, config.port);
+        return EXIT_SUCCESS;
+    }
 
     // Lancement du thread répéteur
     int repThreadRes = pthread_create(&threadRepeater, NULL, read_tupe, NULL);
     CHECK_ERR(repThreadRes, "pthread_create");
 
     // Boucle d'acceptation des clients
-    while (1) {
-        struct user *u = user_accept(socketFD);
-        pthread_mutex_lock(&mutexUser);
-        connectUsers = list_add(connectUsers, u);
-        pthread_mutex_unlock(&mutexUser);
+    if (config.mode == MODE_POOL)
+        pool_run(config.nbWorkers, socketFD);
+    else if (config.mode == MODE_CORO)
+        coserver_run(socketFD);
+    else
+        accept_clients(socketFD);
 
-        pthread_t threadUser;
-        int threadRes = pthread_create(&threadUser, NULL, handle_client, u);
-        CHECK_ERR(threadRes, "pthread_create");
+    return EXIT_SUCCESS;
+}
 
-        int detachRes = pthread_detach(threadUser);
-        CHECK_ERR(detachRes, "pthread_detach");
+/*================== Options de la ligne de commande ==================*/
+void parse_options(int argc, char *argv[], struct server_config *cfg) {
+    int opt;
+
+    while ((opt = getopt(argc, argv,
+                         "m:r:t:s:w:l:b:B:H:k:K:d:f:R:A:M:D:")) != -1) {
+        switch (opt) {
+            case 'm':
+                if (strcmp(optarg, "thread") == 0)
+                    cfg->mode = MODE_THREAD;
+                else if (strcmp(optarg, "epoll") == 0)
+                    cfg->mode = MODE_EPOLL;
+                else if (strcmp(optarg, "pool") == 0)
+                    cfg->mode = MODE_POOL;
+                else if (strcmp(optarg, "coro") == 0)
+                    cfg->mode = MODE_CORO;
+                else if (strcmp(optarg, "uring") == 0)
+                    cfg->mode = MODE_URING;
+                else {
+                    fprintf(stderr, "Mode inconnu : %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'r':
+                cfg->nbReactors = atoi(optarg);
+                break;
+            case 't':
+                cfg->nbWorkers = atoi(optarg);
+                break;
+            case 's':
+                cfg->stackSize = strtoul(optarg, NULL, 10) * 1024;
+                break;
+            case 'w':
+                cfg->highWater = strtoul(optarg, NULL, 10);
+                break;
+            case 'l':
+                if (strcmp(optarg, "drop") == 0)
+                    cfg->lagPolicy = LAG_DROP;
+                else if (strcmp(optarg, "coalesce") == 0)
+                    cfg->lagPolicy = LAG_COALESCE;
+                else if (strcmp(optarg, "disconnect") == 0)
+                    cfg->lagPolicy = LAG_DISCONNECT;
+                else {
+                    fprintf(stderr, "Politique inconnue : %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'b':
+                cfg->batchWindow = atol(optarg);
+                break;
+            case 'B':
+                cfg->batchCap = atol(optarg);
+                break;
+            case 'H':
+                cfg->handshakeTimeout = atol(optarg);
+                break;
+            case 'k':
+                cfg->historyMessages = strtoul(optarg, NULL, 10);
+                break;
+            case 'K':
+                cfg->historyBytes = strtoul(optarg, NULL, 10);
+                break;
+            case 'd':
+                cfg->journalDir = optarg;
+                break;
+            case 'f':
+                cfg->journalSync = atol(optarg);
+                break;
+            case 'R':
+                cfg->journalMaxBytes = strtoull(optarg, NULL, 10);
+                break;
+            case 'A':
+                cfg->journalMaxAge = atol(optarg);
+                break;
+            case 'M':
+                cfg->mailboxBytes = strtoul(optarg, NULL, 10);
+                break;
+            case 'D':
+                cfg->mailboxDir = optarg;
+                break;
+            default:
+                fprintf(stderr,
+                        "Usage : %s [-m thread|epoll|pool|coro|uring] "
+                        "[-r réacteurs] "
+                        "[-t threads] [-s pile_ko] [-w seuil] "
+                        "[-l drop|coalesce|disconnect] [-b fenêtre_us] "
+                        "[-B plafond_us] [-H délai_ms] [-k messages] "
+                        "[-K octets] [-d dossier] [-f fsync_ms] "
+                        "[-R octets] [-A secondes] [-M octets] "
+                        "[-D dossier] [port]\n",
+                        argv[0]);
+                exit(EXIT_FAILURE);
+        }
     }
 
-    return EXIT_SUCCESS;
+    if (optind < argc) cfg->port = atoi(argv[optind]);
+    if (cfg->batchWindow < 0) cfg->batchWindow = 0;
+    if (cfg->batchCap < cfg->batchWindow) cfg->batchCap = cfg->batchWindow;
+    if (cfg->handshakeTimeout < 1) cfg->handshakeTimeout = 1;
 }
 
 /*================== Création de la socket d'écoute ==================*/
-int create_listening_sock(uint16_t port) {
-    int sockFD = socket(AF_INET, SOCK_STREAM, 0);
+int create_listening_sock(uint16_t port, int reusePort) {
+    // IPv6 et IPv4 sur la même socket, IPv4 seul si IPv6 est absent
+    int family = AF_INET6;
+    int sockFD = socket(AF_INET6, SOCK_STREAM, 0);
+    if (sockFD < 0 && errno == EAFNOSUPPORT) {
+        family = AF_INET;
+        sockFD = socket(AF_INET, SOCK_STREAM, 0);
+    }
     CHECK_ERR(sockFD, "socket");
 
     // Option pour réutiliser l'adresse
     int opt = 1;
     setsockopt(sockFD, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 
-    struct sockaddr_in socketAdresse;
-    socketAdresse.sin_family = AF_INET;
-    socketAdresse.sin_port = htons(port);
-    socketAdresse.sin_addr.s_addr = INADDR_ANY;
+    // Plusieurs sockets d'écoute sur le même port, réparties par le noyau
+    if (reusePort) {
+        int reuseRes =
+            setsockopt(sockFD, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+        CHECK_ERR(reuseRes, "setsockopt SO_REUSEPORT");
+    }
 
-    int bindRes =
-        bind(sockFD, (struct sockaddr *)&socketAdresse, sizeof(socketAdresse));
+    struct sockaddr_storage socketAdresse;
+    socklen_t adresseLen;
+    memset(&socketAdresse, 0, sizeof(socketAdresse));
+    if (family == AF_INET6) {
+        // Les clients IPv4 arrivent en adresses IPv4 mappées (::ffff:a.b.c.d)
+        int v6only = 0;
+        int v6Res = setsockopt(sockFD, IPPROTO_IPV6, IPV6_V6ONLY, &v6only,
+                               sizeof(v6only));
+        CHECK_ERR(v6Res, "setsockopt IPV6_V6ONLY");
+
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&socketAdresse;
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons(port);
+        sin6->sin6_addr = in6addr_any;
+        adresseLen = sizeof(*sin6);
+    } else {
+        struct sockaddr_in *sin = (struct sockaddr_in *)&socketAdresse;
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(port);
+        sin->sin_addr.s_addr = INADDR_ANY;
+        adresseLen = sizeof(*sin);
+    }
+
+    int bindRes = bind(sockFD, (struct sockaddr *)&socketAdresse, adresseLen);
     CHECK_ERR(bindRes, "bind");
 
-    int listenRes = listen(sockFD, MAX_CLIENTS);
+    int listenRes = listen(sockFD, LISTEN_BACKLOG);
     CHECK_ERR(listenRes, "listen");
 
     return sockFD;
 }
 
-/*================== Gestion d'un client ==================*/
-void *handle_client(void *user) {
-    struct user *u = (struct user *)user;
+/*================== Accueil des clients ==================*/
+void accept_clients(int listenFD) {
+    struct handshake_queue pending = {NULL, NULL, 0};
+    struct epoll_event events[64];
+
+    // Les clients en attente de pseudo ne bloquent aucun thread
+    int flags = fcntl(listenFD, F_GETFL, 0);
+    int fcntlRes = fcntl(listenFD, F_SETFL, flags | O_NONBLOCK);
+    CHECK_ERR(fcntlRes, "fcntl");
 
-    // Message de bienvenue
-    const char *welcome = "Bienvenue sur Freescord !\r\n";
-    int sent = send(u->sock, welcome, strlen(welcome), 0);
-    CHECK_ERR(sent, "send");
+    int epollFD = epoll_create1(0);
+    CHECK_ERR(epollFD, "epoll_create1");
 
-    // Demande du pseudo
-    ask_username(u->sock, u->username, 16);
+    // La socket d'écoute est repérée par un pointeur NULL
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    int ctlRes = epoll_ctl(epollFD, EPOLL_CTL_ADD, listenFD, &ev);
+    CHECK_ERR(ctlRes, "epoll_ctl");
 
-    printf("\n[CONNEXION] Utilisateur connecté : %s\n", u->username);
+    // Threads clients détachés, avec une petite pile
+    pthread_attr_t attr;
+    thread_attr_init(&attr);
+    if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) != 0)
+        CHECK_ERR(-1, "pthread_attr_setdetachstate");
 
-    char BUFFER[BUFFER_SIZE];
-    int recvRes;
+    // Écoute suspendue tant que les descripteurs manquent
+    uint64_t acceptResume = 0;
 
     while (1) {
-        // Réception du message
-        recvRes = recv(u->sock, BUFFER, sizeof(BUFFER) - 1, 0);
+        long timeoutUs = accept_resume(epollFD, listenFD, &acceptResume,
+                                       handshake_timeout(&pending, -1));
+        int nbEvents = wait_events(epollFD, events, 64, timeoutUs);
+        if (nbEvents < 0) {
+            if (errno == EINTR) continue;
+            CHECK_ERR(nbEvents, "epoll_pwait2");
+        }
 
-        // Vérifier si le client s'est déconnecté
-        if (recvRes <= 0) {
-            if (recvRes == 0)
-                printf("[DECONNEXION] Connexion fermée par le client %s\n",
-                       u->username);
-            else
-                perror("recv");
-            break;
+        for (int i = 0; i < nbEvents; i++) {
+            struct user *u = events[i].data.ptr;
+
+            if (!u) {
+                while ((u = user_accept(listenFD)) != NULL) {
+                    ev.data.ptr = u;
+                    if (epoll_ctl(epollFD, EPOLL_CTL_ADD, u->sock, &ev) < 0) {
+                        perror("epoll_ctl");
+                        user_free(u);
+                        continue;
+                    }
+                    handshake_start(&pending, u);
+                }
+                accept_pause(epollFD, listenFD, &acceptResume);
+                continue;
+            }
+
+            int hsRes = handshake_read(&pending, u);
+            if (hsRes == 0) continue;
+
+            epoll_ctl(epollFD, EPOLL_CTL_DEL, u->sock, NULL);
+            if (hsRes < 0) {
+                user_free(u);
+                continue;
+            }
+
+            // Pseudo accepté : un thread pour la suite
+            pthread_t threadUser;
+            int threadRes =
+                pthread_create(&threadUser, &attr, handle_client, u);
+            CHECK_ERR(threadRes, "pthread_create");
+        }
+
+        // Clients restés sans pseudo au-delà du délai
+        struct user *u;
+        while ((u = handshake_expired(&pending)) != NULL) {
+            epoll_ctl(epollFD, EPOLL_CTL_DEL, u->sock, NULL);
+            user_free(u);
         }
+    }
+}
 
-        BUFFER[recvRes] = '\0';
+void thread_attr_init(pthread_attr_t *attr) {
+    pthread_attr_init(attr);
 
+    size_t stackSize = config.stackSize;
+    if (stackSize < PTHREAD_STACK_MIN) stackSize = PTHREAD_STACK_MIN;
+    if (pthread_attr_setstacksize(attr, stackSize) != 0)
+        CHECK_ERR(-1, "pthread_attr_setstacksize");
+}
+
+/*================== Gestion d'un client ==================*/
+void *handle_client(void *user) {
+    struct user *u = (struct user *)user;
+
+    // L'historique des salons rejoints à la connexion passe avant le direct
+    for (size_t i = 0; i < u->nbRooms; i++) {
+        struct message_info replay;
+        login_replay(u, i, &replay);
+        ring_push_wait(repeaterRing, &replay);
+    }
+    struct message_info mail = {.type = MSG_MAILBOX, .sender = u};
+    ring_push_wait(repeaterRing, &mail);
+
+    // Plusieurs lignes peuvent arriver d'un coup, une ligne en plusieurs
+    // fois ; celles reçues avec le pseudo sont déjà dans le tampon
+    char *line;
+    while ((line = next_input(u)) != NULL) {
         // Vérifier si c'est une commande de déconnexion
-        if (is_exit_command(BUFFER)) {
+        if (is_exit_command(line)) {
             printf("[DECONNEXION] %s a quitté le chat\n", u->username);
             break;
         }
 
-        // Ajouter le pseudo devant le message
+        // Ajouter le pseudo devant le message, ou répondre à une commande
         struct message_info msg;
-        msg.sender_socket = u->sock;
-        snprintf(msg.content, sizeof(msg.content), "%s: %s\n", u->username,
-                 BUFFER);
+        build_message(u, line, &msg);
+
+        // Dépôt dans la file du répéteur
+        ring_push_wait(repeaterRing, &msg);
+    }
+
+    // Garder sa session, puis le supprimer de ses salons, de l'ensemble des
+    // connectés et de l'annuaire
+    session_save(u);
+    room_part_all(u);
+    userset_remove(&connectUsers, u);
+    registry_release(u);
+
+    // Le répéteur peut encore écrire sur sa socket : c'est lui qui libère u
+    struct message_info leave = {.type = MSG_LEAVE, .sender = u};
+    ring_push_wait(repeaterRing, &leave);
+
+    return NULL;
+}
+
+/*================== Construction d'un message ==================*/
+void build_message(struct user *u, char *text, struct message_info *msg) {
+    msg->sender = u;
+    msg->sender_socket = u->sock;
+    msg->room = u->room;
+    msg->seq = 0;
+
+    // Remis par celui qui remplit les files, ou gardé pour un absent
+    if (private_command(u, text, msg) == 0) return;
+
+    // Réponse du serveur à l'émetteur seul, précédée de l'historique du
+    // salon rejoint, même sans réponse : il n'aurait sinon rien en direct
+    struct room *joined;
+    struct payload *reply = room_command(u, text, &joined);
+    if (joined) {
+        msg->type = MSG_REPLAY;
+        msg->room = joined;
+        msg->payload = reply;
+        return;
+    }
+    if (!reply && !u->room)
+        reply = proto_notice("Vous n'êtes dans aucun salon, /join #salon");
+    if (reply) {
+        msg->type = MSG_NOTICE;
+        msg->payload = reply;
+        return;
+    }
 
-        printf("[MESSAGE] %s", msg.content);
+    // Mis en forme une fois pour chaque protocole, numéroté par celui qui
+    // remplit les files (voir room_publish)
+    msg->type = MSG_BROADCAST;
+    msg->payload = proto_message(u, u->room, text);
+    CHECK_ERR(msg->payload ? 0 : -1, "proto_message");
+    stats_add(STAT_MESSAGES, 1);
 
-        // Écriture dans le tube
-        int writeRes = write(myTube[1], &msg, sizeof(msg));
-        CHECK_ERR(writeRes, "write");
+    printf("[MESSAGE] %s", msg->payload->data);
+}
+
+/*================== Messages privés ==================*/
+int private_command(struct user *u, char *text, struct message_info *msg) {
+    char nick[NICKNAME_SIZE + 1];
+    int offset = 0;
+
+    if (strncmp(text, "/msg", 4) != 0 || (text[4] != ' ' && text[4] != '\0'))
+        return -1;
+
+    // Le texte garde ses espaces, seul le pseudo est découpé
+    msg->type = MSG_NOTICE;
+    if (sscanf(text, "/msg %16s %n", nick, &offset) < 1 || !offset ||
+        !text[offset])
+        msg->payload = proto_notice("Usage : /msg pseudo texte");
+    else if (check_nickname(nick, NICKNAME_SIZE) != 0)
+        msg->payload = proto_notice("Pseudo invalide : %s", nick);
+    else {
+        msg->type = MSG_PRIVATE;
+        msg->payload = proto_private(u, nick, text + offset);
+        CHECK_ERR(msg->payload ? 0 : -1, "proto_private");
+    }
+    return 0;
+}
+
+/*================== Commandes de salon ==================*/
+struct payload *room_command(struct user *u, char *text,
+                             struct room **joined) {
+    char command[16], name[64];
+    name[0] = '\0';
+    *joined = NULL;
+
+    if (text[0] != '/' || sscanf(text, "%15s %63s", command, name) < 1)
+        return NULL;
+
+    if (strcmp(command, "/join") == 0) {
+        struct room *room = room_get(name, 1);
+        if (!room)
+            return proto_notice("Salon invalide : %s", name);
+        int joinRes = room_join(u, room);
+        if (joinRes < 0)
+            return proto_notice("Impossible de rejoindre %s", name);
+        if (joinRes > 0) *joined = room;
+        return proto_notice("Vous êtes dans %s", room->name);
     }
 
-    // Supprimer l'utilisateur de la liste des connectés
-    pthread_mutex_lock(&mutexUser);
-    list_remove_element(connectUsers, u);
-    pthread_mutex_unlock(&mutexUser);
+    if (strcmp(command, "/part") == 0) {
+        // Sans nom, le salon courant
+        struct room *room = name[0] ? room_get(name, 0) : u->room;
+        if (!room || room_part(u, room) < 0)
+            return proto_notice("Vous n'êtes pas dans ce salon");
+        if (u->room)
+            return proto_notice("Vous avez quitté %s, retour dans %s",
+                                room->name, u->room->name);
+        return proto_notice("Vous avez quitté %s", room->name);
+    }
 
-    // Libérer la structure utilisateur
-    user_free(u);
+    // Lu dans le journal par ce thread, envoyé comme une réponse
+    if (strcmp(command, "/history") == 0)
+        return history_command(messageJournal, u, text);
 
     return NULL;
 }
 
-/*================== Lecture du pipe et envoie à tous  ==================*/
+/*================== Lecture de la file et envoie à tous  ==================*/
 void *read_tupe(void *arg) {
     struct message_info msg;
+    struct epoll_event events[64];
+    struct flush_batch batch = {NULL, 0, 0, 0};
+    int idle = 0;
+
+    // Le répéteur surveille sa file et les sockets ayant des données en file
+    repeaterEpoll = epoll_create1(0);
+    CHECK_ERR(repeaterEpoll, "epoll_create1");
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    int ctlRes =
+        epoll_ctl(repeaterEpoll, EPOLL_CTL_ADD, ring_fd(repeaterRing), &ev);
+    CHECK_ERR(ctlRes, "epoll_ctl");
 
     while (1) {
-        int readRes = read(myTube[0], &msg, sizeof(msg));
-        if (readRes <= 0) {
-            if (readRes < 0) perror("read");
-            continue;
+        // Tout ce qui a été déposé est mis en file, sans appel système
+        int received = 0;
+        while (ring_pop(repeaterRing, &msg) == 0) {
+            if (msg.type == MSG_NOTICE) {
+                if (repeat_message(msg.sender, msg.payload) == 0) {
+                    batch_begin(&batch);
+                    batch_add(&batch, msg.sender);
+                }
+                payload_unref(msg.payload);
+            } else if (msg.type == MSG_REPLAY) {
+                replay_room(msg.sender, msg.room, msg.payload, msg.seq,
+                            &batch);
+                payload_unref(msg.payload);
+            } else if (msg.type == MSG_PRIVATE) {
+                send_private(&msg, -1, &batch);
+                payload_unref(msg.payload);
+            } else if (msg.type == MSG_MAILBOX) {
+                login_mailbox(msg.sender, &batch);
+            } else if (msg.type == MSG_LEAVE) {
+                // Aucun événement ne peut plus désigner ce client, qui n'est
+                // libéré qu'une fois sorti de toutes les lectures en cours
+                user_shutdown(msg.sender);
+                user_update_events(msg.sender, repeaterEpoll, 0);
+                batch_remove(&batch, msg.sender);
+                userset_retire(msg.sender);
+            } else {
+                // Numéroté ici, dans l'ordre où les files sont remplies.
+                // Version courante lue sans verrou : une arrivée ou un
+                // départ ne retarde pas la diffusion
+                msg.seq = room_publish(msg.room, msg.payload, NULL, NULL);
+                batch_begin(&batch);
+                send_messageAll(userset_read_begin(&msg.room->members),
+                                msg.payload, msg.seq, msg.sender_socket,
+                                &batch);
+                userset_read_end();
+                payload_unref(msg.payload);
+                received++;
+            }
         }
 
-        send_messageAll(connectUsers, msg.content, msg.sender_socket);
+        // Un seul envoi par destinataire pour tout le lot
+        if (batch_due(&batch, idle && !received))
+            batch_flush(&batch, repeaterEpoll, 0);
+
+        // File vide : attente d'un dépôt, d'une socket disponible ou de la
+        // fin de la fenêtre du lot
+        idle = 0;
+        if (!ring_sleep(repeaterRing)) continue;
+
+        int nbEvents =
+            wait_events(repeaterEpoll, events, 64, batch_timeout(&batch));
+        ring_wake(repeaterRing);
+        if (nbEvents < 0) {
+            if (errno == EINTR) continue;
+            CHECK_ERR(nbEvents, "epoll_pwait2");
+        }
+        idle = nbEvents == 0;
+
+        // Sockets de nouveau disponibles en écriture
+        for (int i = 0; i < nbEvents; i++) {
+            struct user *u = events[i].data.ptr;
+            if (!u) continue;
+
+            flush_user(u);
+            user_update_events(u, repeaterEpoll, 0);
+        }
     }
 
     return NULL;
 }
 
 /*================== Envoi aux utilisateur ==================*/
-void repeat_message(struct user *u, char *message) {
-    int sent = send(u->sock, message, strlen(message), 0);
-    CHECK_ERR(sent, "send");
+int repeat_message(struct user *u, struct payload *message) {
+    if (u->state == USER_CLOSING) return -1;
+
+    // Texte ou trame selon le protocole du destinataire
+    message = proto_payload(u, message);
+
+    // File au-dessus du seuil : le client ne suit pas le rythme. Seul compte
+    // ce que le dernier envoi a laissé, pas le lot en cours de constitution
+    // ni un envoi io_uring en cours
+    size_t waiting = outq_waiting(&u->outq);
+    if (!u->inBatch && waiting > 0 &&
+        waiting + message->len > config.highWater) {
+        switch (config.lagPolicy) {
+            case LAG_DROP:
+                stats_add(STAT_LAG_DROPPED, 1);
+                return -1;
+
+            case LAG_COALESCE: {
+                size_t skipped = outq_drop_pending(&u->outq);
+                struct payload *notice = proto_notice(
+                    "%zu message(s) omis, connexion trop lente", skipped);
+                if (notice) {
+                    outq_push(&u->outq, proto_payload(u, notice));
+                    payload_unref(notice);
+                }
+                stats_add(STAT_LAG_COALESCED, 1);
+                stats_add(STAT_LAG_SKIPPED, skipped);
+                break;
+            }
+
+            case LAG_DISCONNECT:
+                disconnect_lagging(u);
+                return -1;
+        }
+    }
+
+    if (outq_push(&u->outq, message) < 0) {
+        perror("malloc");
+        return -1;
+    }
+
+    return 0;
+}
+
+int repeat_member(struct user *u, struct payload *message) {
+    // Rien d'autre n'entre dans sa file pendant un parcours : le message y
+    // est encore le dernier s'il l'a déjà reçu
+    if (outq_last(&u->outq) == proto_payload(u, message)) return -1;
+    return repeat_message(u, message);
+}
+
+int flush_user(struct user *u) {
+    if (u->state == USER_CLOSING) return -1;
+
+    // Le destinataire a pu partir entre-temps : sa déconnexion sera traitée
+    // par celui qui lit sa socket
+    int flushRes = outq_flush(&u->outq, u->sock);
+    if (flushRes < 0) {
+        user_shutdown(u);
+        return -1;
+    }
+
+    return flushRes == 0;
 }
 
-void send_messageAll(LIST *users, char *message, int sender_socket) {
-    if (!users) return;
+void send_messageAll(const struct user_set *users, struct payload *message,
+                     uint64_t seq, int sender_socket,
+                     struct flush_batch *batch) {
+    // Les sockets sont lues à la suite, de la fin vers le début ; seul un
+    // destinataire est touché. Une ligne en cours de réécriture est sautée
+    for (size_t i = userset_count(users); i-- > 0;) {
+        unsigned gen = __atomic_load_n(&users->gens[i], __ATOMIC_ACQUIRE);
+        int sock = __atomic_load_n(&users->socks[i], __ATOMIC_RELAXED);
+        uint64_t from = __atomic_load_n(&users->from[i], __ATOMIC_RELAXED);
+        struct user *u = __atomic_load_n(&users->users[i], __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (gen & 1 ||
+            gen != __atomic_load_n(&users->gens[i], __ATOMIC_RELAXED) ||
+            sock == sender_socket || seq < from)
+            continue;
 
-    pthread_mutex_lock(&mutexUser);
+        if (repeat_member(u, message) == 0) batch_add(batch, u);
+    }
+}
 
-    for (NODE *curr = users->first; curr; curr = curr->next) {
-        struct user *u = curr->elt;
-        if (u->sock != sender_socket) repeat_message(u, message);
+void replay_room(struct user *u, struct room *room, struct payload *notice,
+                 uint64_t after, struct flush_batch *batch) {
+    struct payload **history;
+    uint64_t missing;
+    ssize_t count = room_history(room, u, after, &history, &missing);
+    if (count < 0) count = 0;
+
+    // Des références déjà mises en forme, en une fois dans le lot : le seuil
+    // de retard ne s'applique pas à l'historique. Ce qui a quitté la mémoire
+    // passe d'abord, relu dans le journal
+    batch_begin(batch);
+    batch_add(batch, u);
+    struct payload *old =
+        missing ? history_range(messageJournal, room, after, missing) : NULL;
+    if (old) {
+        repeat_message(u, old);
+        payload_unref(old);
+    }
+    for (ssize_t i = 0; i < count; i++) {
+        repeat_message(u, history[i]);
+        payload_unref(history[i]);
     }
+    free(history);
+    stats_add(STAT_REPLAYED, count);
+
+    if (notice) repeat_message(u, notice);
+}
+
+void login_replay(struct user *u, size_t i, struct message_info *msg) {
+    *msg = (struct message_info){.type = MSG_REPLAY,
+                                 .sender = u,
+                                 .room = u->rooms[i],
+                                 .seq = u->resumeSeq};
+
+    if (u->resumeSeq && i == u->nbRooms - 1)
+        msg->payload = proto_notice("Session reprise : %zu salon(s), messages "
+                                    "manqués après le n° %" PRIu64,
+                                    u->nbRooms, u->resumeSeq);
+}
+
+int send_private(struct message_info *msg, int owner,
+                 struct flush_batch *batch) {
+    // Le destinataire est nommé dans la trame, qui vit avec le message
+    struct payload *frame = msg->payload->frame;
+    struct frame f;
+    if (frame_decode(frame->data, frame->len, &f) <= 0) return -1;
+    const char *nick = f.room;
+
+    // Un utilisateur de l'annuaire reste valable dans la section de lecture.
+    // Absent ou pas encore servi de sa boîte, le message y va, sauf s'il
+    // vient de la relever
+    userset_read_begin(&connectUsers);
+    struct user *target;
+    ssize_t queued = 0;
+    while (!(target = mailbox_recipient(nick)) &&
+           (queued = mailbox_put(nick, frame)) == 0)
+        continue;
+
+    int remote = -1;
+    batch_begin(batch);
+    if (target && owner >= 0 && target->owner != owner)
+        remote = target->owner;
+    else if (target && repeat_message(target, msg->payload) == 0)
+        batch_add(batch, target);
+    userset_read_end();
+
+    struct payload *notice = NULL;
+    if (!target && msg->sender && queued > 0)
+        notice = proto_notice("%s est absent, message gardé (%zd/%d)", nick,
+                              queued, MAILBOX_MAX);
+    else if (!target && msg->sender)
+        notice = proto_notice("Boîte de %s pleine, message perdu", nick);
+    if (notice) {
+        if (repeat_message(msg->sender, notice) == 0)
+            batch_add(batch, msg->sender);
+        payload_unref(notice);
+    }
+
+    return remote;
+}
+
+void login_mailbox(struct user *u, struct flush_batch *batch) {
+    struct payload *mail = mailbox_take(u);
+    if (!mail) return;
+
+    batch_begin(batch);
+    if (repeat_message(u, mail) == 0) batch_add(batch, u);
+    payload_unref(mail);
+}
 
-    pthread_mutex_unlock(&mutexUser);
+/*================== Lot d'envoi ==================*/
+uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void batch_begin(struct flush_batch *batch) {
+    if (!batch->start) batch->start = now_us();
+}
+
+void batch_add(struct flush_batch *batch, struct user *u) {
+    if (u->inBatch) return;
+
+    if (batch->count == batch->size) {
+        size_t newSize = batch->size ? batch->size * 2 : 64;
+        struct user **users = realloc(batch->users, newSize * sizeof(*users));
+        if (!users) {
+            // Faute de place, u est envoyé tout de suite
+            perror("realloc");
+            flush_user(u);
+            return;
+        }
+        batch->users = users;
+        batch->size = newSize;
+    }
+
+    batch->users[batch->count++] = u;
+    u->inBatch = 1;
+}
+
+void batch_remove(struct flush_batch *batch, struct user *u) {
+    if (!u->inBatch) return;
+
+    // L'ordre des destinataires n'importe pas : le dernier prend sa place
+    for (size_t i = 0; i < batch->count; i++) {
+        if (batch->users[i] != u) continue;
+        batch->users[i] = batch->users[--batch->count];
+        break;
+    }
+    u->inBatch = 0;
+}
+
+int batch_due(struct flush_batch *batch, int idle) {
+    if (!batch->start) return 0;
+    if (config.batchWindow == 0 || idle) return 1;
+
+    return (long)(now_us() - batch->start) >= config.batchCap;
+}
+
+long batch_timeout(struct flush_batch *batch) {
+    if (!batch->start) return -1;
+
+    long remaining = config.batchCap - (long)(now_us() - batch->start);
+    if (remaining <= 0) return 0;
+    return remaining < config.batchWindow ? remaining : config.batchWindow;
+}
+
+void batch_flush(struct flush_batch *batch, int epollFD, uint32_t baseEvents) {
+    for (size_t i = 0; i < batch->count; i++) {
+        struct user *u = batch->users[i];
+        u->inBatch = 0;
+
+        flush_user(u);
+        user_update_events(u, epollFD, baseEvents);
+    }
+
+    if (batch->count) stats_add(STAT_BATCHES, 1);
+    batch->count = 0;
+    batch->start = 0;
+}
+
+int wait_events(int epollFD, struct epoll_event *events, int maxEvents,
+                long timeoutUs) {
+    stats_add(STAT_WAIT_CALLS, 1);
+    if (timeoutUs < 0)
+        return epoll_pwait2(epollFD, events, maxEvents, NULL, NULL);
+
+    struct timespec timeout = {timeoutUs / 1000000, timeoutUs % 1000000 * 1000};
+    return epoll_pwait2(epollFD, events, maxEvents, &timeout, NULL);
+}
+
+void accept_pause(int epollFD, int listenFD, uint64_t *resume) {
+    if (!user_accept_starved(errno)) return;
+
+    if (epoll_ctl(epollFD, EPOLL_CTL_DEL, listenFD, NULL) < 0)
+        perror("epoll_ctl");
+    *resume = now_us() + ACCEPT_PAUSE;
+}
+
+long accept_resume(int epollFD, int listenFD, uint64_t *resume,
+                   long timeoutUs) {
+    if (!*resume) return timeoutUs;
+
+    uint64_t now = now_us();
+    if (now < *resume) {
+        long remaining = *resume - now;
+        return timeoutUs < 0 || remaining < timeoutUs ? remaining : timeoutUs;
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    if (epoll_ctl(epollFD, EPOLL_CTL_ADD, listenFD, &ev) < 0)
+        perror("epoll_ctl");
+    *resume = 0;
+    return timeoutUs;
+}
+
+void user_update_events(struct user *u, int epollFD, uint32_t baseEvents) {
+    uint32_t wanted = baseEvents;
+    if (!outq_is_empty(&u->outq)) wanted |= EPOLLOUT;
+    if (wanted == u->events) return;
+
+    struct epoll_event ev = {.events = wanted, .data.ptr = u};
+    int op = EPOLL_CTL_MOD;
+    if (u->events == 0)
+        op = EPOLL_CTL_ADD;
+    else if (wanted == 0)
+        op = EPOLL_CTL_DEL;
+
+    if (epoll_ctl(epollFD, op, u->sock, &ev) < 0)
+        perror("epoll_ctl");
+    else
+        u->events = wanted;
+}
+
+void disconnect_lagging(struct user *u) {
+    if (u->state == USER_CLOSING) return;
+
+    user_shutdown(u);
+    stats_add(STAT_LAG_DISCONNECTED, 1);
 }
 
 int is_exit_command(char *buffer) {
@@ -174,46 +904,71 @@ int is_exit_command(char *buffer) {
     return (strcmp(buffer, "/exit") == 0);
 }
 
-void on_exit(int sig) {
-    close(myTube[0]);
-    close(myTube[1]);
-    close(socketFD);
+void *signal_thread(void *handled) {
+    int sig;
 
-    pthread_mutex_destroy(&mutexUser);
+    while (sigwait(handled, &sig) == 0) {
+        // Les messages déjà diffusés sont sur disque avant la sortie ; les
+        // connexions sont fermées par exit
+        if (sig == SIGINT) {
+            if (messageJournal) journal_sync(messageJournal);
+            printf("\n[ARRET] Serveur arrêté\n");
+        }
 
-    if (connectUsers) {
-        list_free(connectUsers, (void *)user_free);
+        stats_print(stdout);
+        if (messageJournal) journal_print(messageJournal, stdout);
+        fflush(stdout);
+        if (sig == SIGINT) exit(EXIT_SUCCESS);
     }
 
-    printf("\n[ARRET] Serveur arrêté\n");
-
-    exit(EXIT_SUCCESS);
+    perror("sigwait");
+    return NULL;
 }
 
-// Demande au client de saisir un username et le stocke dans username
-void ask_username(int client, char *username, size_t size) {
-    char buffer[64];
-    int status, received, sent;
-    const char *prompt = "Entrez votre pseudo : ";
+int answer_nickname(struct user *u, char *nick) {
+    // Vérification et réservation en une fois : pas de course entre clients
+    int status = check_nickname(nick, NICKNAME_SIZE);
+    if (status == 0) {
+        int reserveRes = registry_reserve(u, nick);
+        status = reserveRes < 0 ? 3 : reserveRes;
+    }
+    send_error_nickname(u, status);
 
-    do {
-        sent = send(client, prompt, strlen(prompt), 0);
-        CHECK_ERR(sent, "send prompt");
+    return status;
+}
 
-        received = recv(client, buffer, sizeof(buffer) - 1, 0);
-        CHECK_ERR(received, "recv");
+char *next_input(struct user *u) {
+    char *line;
+    int nextRes;
 
-        // Remplace le CRLF par un NUL
-        buffer[received] = '\0';
-        buffer[strcspn(buffer, "\r\n")] = '\0';
+    while ((nextRes = proto_next(u, &line)) == 0) {
+        ssize_t readRes = buff_read_more(u->in);
+        stats_add(STAT_RECV_CALLS, 1);
+        if (readRes < 0 && errno == EINTR) continue;
 
-        status = check_nickname(buffer, size);
-        send_error_nickname(client, status);
+        // Socket non bloquante d'une coroutine : les autres tournent pendant
+        // l'attente
+        if (readRes < 0 && errno == EAGAIN &&
+            coro_wait_fd(u->sock, CORO_READ, 0) == 0)
+            continue;
+        if (readRes <= 0) {
+            if (readRes == 0)
+                printf("[DECONNEXION] Connexion fermée par le client %s\n",
+                       u->username);
+            else if (readRes < 0)
+                perror("recv");
+            return NULL;
+        }
+    }
 
-    } while (status != 0);
+    // Trame invalide : impossible de retrouver le début de la suivante
+    if (nextRes < 0) {
+        fprintf(stderr, "[SERVER ERROR] - trame invalide de %s\n",
+                u->username);
+        return NULL;
+    }
 
-    strncpy(username, buffer, size - 1);
-    username[size - 1] = '\0';
+    return line;
 }
 
 int check_nickname(char *buffer, size_t size) {
@@ -226,29 +981,19 @@ int check_nickname(char *buffer, size_t size) {
     for (size_t i = 0; i < len; i++)
         if (buffer[i] == ' ' || buffer[i] == ':') return 2;
 
-    // 1. Vérifie si le nickname est déjà pris
-    pthread_mutex_lock(&mutexUser);
-    for (NODE *curr = connectUsers->first; curr; curr = curr->next) {
-        struct user *u = curr->elt;
-        if (strcmp(u->username, buffer) == 0) {
-            pthread_mutex_unlock(&mutexUser);
-            return 1;
-        }
-    }
-    pthread_mutex_unlock(&mutexUser);
-
     // 0. Le nickname est valide
     return 0;
 }
 
-void send_error_nickname(int client, int status) {
+void send_error_nickname(struct user *u, int status) {
     const char *responses[] = {
-        "0 | Pseudo accepté.\n",
-        "1 | Ce pseudo est déjà pris.\nEntrez votre pseudo : ",
+        "0 | Pseudo accepté.",
+        "1 | Ce pseudo est déjà pris.",
         "2 | Pseudo invalide.\nRègles :\n- Pas d'espaces ni de ':'\n- Taille "
-        "entre 1 et 15 caractères\nEntrez votre pseudo : ",
-        "3 | Erreur inconnue.\nEntrez votre pseudo : "};
+        "entre 1 et 15 caractères",
+        "3 | Erreur inconnue."};
 
+    // Nouvelle demande du pseudo après un refus
     int idx = (status >= 0 && status <= 2) ? status : 3;
-    send(client, responses[idx], strlen(responses[idx]), 0);
+    proto_send_status(u, idx, responses[idx], idx ? NICKNAME_PROMPT : "");
 }
\ No newline at end of file
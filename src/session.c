@@ -0,0 +1,134 @@
+#include "../include/session.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <time.h>
+
+/* Session gardée après un départ, dans une liste de la table des jetons et
+ * dans la liste des départs, du plus ancien au plus récent */
+struct session {
+    char token[USER_TOKEN_SIZE];
+    char nick[USER_NAME_SIZE];
+    struct room **rooms;
+    size_t nbRooms;
+    time_t expiry;
+    struct session *next;          /* même liste de la table */
+    struct session *older, *newer; /* ordre des départs */
+};
+
+static struct session *table[SESSION_TABLE_SIZE];
+static struct session *oldest, *newest;
+static size_t nbSessions;
+static pthread_mutex_t mutexSessions = PTHREAD_MUTEX_INITIALIZER;
+
+/* FNV-1a */
+static uint32_t hash_token(const char *token) {
+    uint32_t h = 2166136261u;
+    for (; *token; token++) h = (h ^ (unsigned char)*token) * 16777619u;
+    return h;
+}
+
+/* Retire s de la table et des départs et la libère, verrou pris */
+static void session_forget(struct session *s) {
+    struct session **link = &table[hash_token(s->token) % SESSION_TABLE_SIZE];
+    while (*link != s) link = &(*link)->next;
+    *link = s->next;
+
+    if (s->older)
+        s->older->newer = s->newer;
+    else
+        oldest = s->newer;
+    if (s->newer)
+        s->newer->older = s->older;
+    else
+        newest = s->older;
+
+    nbSessions--;
+    free(s->rooms);
+    free(s);
+}
+
+/* Oublie les sessions échues, et les plus anciennes au-delà de
+ * SESSION_MAX, verrou pris */
+static void session_expire(time_t now) {
+    while (oldest && (oldest->expiry <= now || nbSessions > SESSION_MAX))
+        session_forget(oldest);
+}
+
+int session_issue(struct user *u) {
+    unsigned char bytes[(USER_TOKEN_SIZE - 1) / 2];
+    if (getrandom(bytes, sizeof(bytes), 0) != (ssize_t)sizeof(bytes)) {
+        u->token[0] = '\0';
+        return -1;
+    }
+
+    for (size_t i = 0; i < sizeof(bytes); i++)
+        sprintf(u->token + 2 * i, "%02x", bytes[i]);
+    return 0;
+}
+
+void session_save(struct user *u) {
+    if (!u->token[0] || !u->registered) return;
+
+    struct session *s = malloc(sizeof(*s));
+    struct room **rooms =
+        malloc((u->nbRooms ? u->nbRooms : 1) * sizeof(*rooms));
+    if (!s || !rooms) {
+        perror("malloc");
+        free(s);
+        free(rooms);
+        return;
+    }
+
+    // Les salons ne sont jamais libérés : les pointeurs restent valables
+    strcpy(s->token, u->token);
+    strcpy(s->nick, u->username);
+    memcpy(rooms, u->rooms, u->nbRooms * sizeof(*rooms));
+    s->rooms = rooms;
+    s->nbRooms = u->nbRooms;
+    time_t now = time(NULL);
+    s->expiry = now + SESSION_TTL;
+
+    pthread_mutex_lock(&mutexSessions);
+
+    struct session **head = &table[hash_token(s->token) % SESSION_TABLE_SIZE];
+    s->next = *head;
+    *head = s;
+    s->older = newest;
+    s->newer = NULL;
+    if (newest)
+        newest->newer = s;
+    else
+        oldest = s;
+    newest = s;
+    nbSessions++;
+    session_expire(now);
+
+    pthread_mutex_unlock(&mutexSessions);
+}
+
+ssize_t session_resume(const char *token, const char *nick,
+                       struct room ***rooms) {
+    ssize_t nbRooms = -1;
+    *rooms = NULL;
+
+    pthread_mutex_lock(&mutexSessions);
+    session_expire(time(NULL));
+
+    struct session *s = table[hash_token(token) % SESSION_TABLE_SIZE];
+    while (s && strcmp(s->token, token) != 0) s = s->next;
+
+    // Un jeton présenté avec un autre pseudo reste valable pour le sien
+    if (s && strcmp(s->nick, nick) == 0) {
+        *rooms = s->rooms;
+        nbRooms = s->nbRooms;
+        s->rooms = NULL;
+        session_forget(s);
+    }
+
+    pthread_mutex_unlock(&mutexSessions);
+    return nbRooms;
+}
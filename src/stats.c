@@ -0,0 +1,42 @@
+#include "../include/stats.h"
+
+#include "slab/slab.h"
+
+static long counters[STAT_COUNT];
+
+static const char *names[STAT_COUNT] = {
+    [STAT_LAG_DROPPED] = "lag_dropped",
+    [STAT_LAG_COALESCED] = "lag_coalesced",
+    [STAT_LAG_SKIPPED] = "lag_skipped",
+    [STAT_LAG_DISCONNECTED] = "lag_disconnected",
+    [STAT_MESSAGES] = "messages",
+    [STAT_SEND_CALLS] = "send_calls",
+    [STAT_RECV_CALLS] = "recv_calls",
+    [STAT_WAIT_CALLS] = "wait_calls",
+    [STAT_RING_OPS] = "ring_ops",
+    [STAT_BATCHES] = "batches",
+    [STAT_HANDSHAKE_EXPIRED] = "handshake_expired",
+    [STAT_REPLAYED] = "replayed",
+    [STAT_HISTORY_SENT] = "history_sent",
+    [STAT_SESSIONS_RESUMED] = "sessions_resumed",
+    [STAT_MAIL_QUEUED] = "mail_queued",
+    [STAT_MAIL_DELIVERED] = "mail_delivered",
+    [STAT_MAIL_EVICTED] = "mail_evicted",
+    [STAT_MAIL_DROPPED] = "mail_dropped",
+};
+
+void stats_add(enum stat_id id, long n) {
+    __atomic_add_fetch(&counters[id], n, __ATOMIC_RELAXED);
+}
+
+long stats_get(enum stat_id id) {
+    return __atomic_load_n(&counters[id], __ATOMIC_RELAXED);
+}
+
+void stats_print(FILE *out) {
+    for (int i = 0; i < STAT_COUNT; i++)
+        fprintf(out, "%s %ld\n", names[i], stats_get(i));
+
+    // Objets vivants et maximums des réserves (utilisateurs, messages, ...)
+    slab_print(out);
+}
@@ -0,0 +1,510 @@
+#define _GNU_SOURCE
+#include "../include/uring.h"
+
+#include <errno.h>
+
+#include "../include/session.h"
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/* Opération désignée par une complétion : le pointeur (user ou envoi) et sa
+ * nature dans les bits de poids faible, toujours nuls pour une allocation */
+#define TAG_ACCEPT 1
+#define TAG_RECV 2
+#define TAG_SEND 3
+#define TAG_ACCEPT_PAUSE 4
+#define TAG_MASK 7
+
+/* Un sendmsg en cours : le noyau lit msg et iov jusqu'à sa complétion */
+struct uring_send {
+    struct msghdr msg;
+    struct iovec iov[URING_SEND_IOV];
+    size_t bytes; /* octets décrits, tous envoyés sauf erreur (MSG_WAITALL) */
+    struct user *u;
+    struct uring_send *next;
+};
+
+static struct uring_loop loop;
+
+/*================== Anneaux ==================*/
+static int ring_enter(int fd, unsigned toSubmit, unsigned minComplete,
+                      unsigned flags, void *arg, size_t argSize) {
+    return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg,
+                   argSize);
+}
+
+/* Publie les entrées préparées et retourne le nombre d'entrées que le
+ * noyau n'a pas encore prises */
+static unsigned sq_publish(struct uring_loop *l) {
+    __atomic_store_n(l->sqTail, l->sqLocalTail, __ATOMIC_RELEASE);
+    return l->sqLocalTail - __atomic_load_n(l->sqHead, __ATOMIC_ACQUIRE);
+}
+
+/* Soumet tout de suite les entrées en attente s'il reste moins de n places
+ * dans la file */
+static void sq_reserve(struct uring_loop *l, unsigned n) {
+    unsigned head = __atomic_load_n(l->sqHead, __ATOMIC_ACQUIRE);
+    if (l->sqLocalTail - head + n <= *l->sqMask + 1) return;
+
+    int enterRes = ring_enter(l->ringFD, sq_publish(l), 0, 0, NULL, 0);
+    stats_add(STAT_WAIT_CALLS, 1);
+    CHECK_ERR(enterRes, "io_uring_enter");
+}
+
+/* Retourne une entrée de soumission vierge */
+static struct io_uring_sqe *sq_get(struct uring_loop *l) {
+    sq_reserve(l, 1);
+
+    struct io_uring_sqe *sqe = &l->sqes[l->sqLocalTail & *l->sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    l->sqLocalTail++;
+    stats_add(STAT_RING_OPS, 1);
+    return sqe;
+}
+
+/* Rend un tampon de réception au noyau */
+static void buf_recycle(struct uring_loop *l, unsigned short bid) {
+    struct io_uring_buf *b =
+        &l->bufRing->bufs[l->bufTail & (URING_NB_BUFS - 1)];
+    b->addr = (uint64_t)(uintptr_t)(l->bufs + (size_t)bid * URING_BUF_SIZE);
+    b->len = URING_BUF_SIZE;
+    b->bid = bid;
+
+    l->bufTail++;
+    __atomic_store_n(&l->bufRing->tail, l->bufTail, __ATOMIC_RELEASE);
+}
+
+/* Vérifie que le noyau connaît toutes les opérations utilisées */
+static int probe_ops(int ringFD) {
+    const int needed[] = {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG,
+                          IORING_OP_SEND_ZC};
+    size_t size = sizeof(struct io_uring_probe) +
+                  IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (!probe) return -1;
+
+    int res = syscall(__NR_io_uring_register, ringFD, IORING_REGISTER_PROBE,
+                      probe, IORING_OP_LAST);
+    for (size_t i = 0; res == 0 && i < sizeof(needed) / sizeof(*needed); i++)
+        if (needed[i] > probe->last_op ||
+            !(probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED))
+            res = -1;
+
+    free(probe);
+    return res < 0 ? -1 : 0;
+}
+
+int uring_setup(struct uring_loop *l, int listenFD) {
+    memset(l, 0, sizeof(*l));
+    l->listenFD = listenFD;
+
+    // Un seul thread soumet : le noyau traite les complétions lors de
+    // l'attente plutôt qu'en interrompant la boucle (à défaut, réglages par
+    // défaut)
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    l->ringFD = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if (l->ringFD < 0 && errno == EINVAL) {
+        memset(&p, 0, sizeof(p));
+        l->ringFD = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    }
+    if (l->ringFD < 0) return -1;
+
+    // Anneaux projetés d'un seul tenant, attente avec délai, aucune
+    // complétion perdue. L'envoi sans copie est arrivé avec la réception
+    // multishot (6.0) : sa présence tient lieu de test
+    unsigned features =
+        IORING_FEAT_SINGLE_MMAP | IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP;
+    if ((p.features & features) != features || probe_ops(l->ringFD) < 0) {
+        close(l->ringFD);
+        errno = ENOSYS;
+        return -1;
+    }
+
+    size_t sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    char *rings = mmap(NULL, sqSize > cqSize ? sqSize : cqSize,
+                       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       l->ringFD, IORING_OFF_SQ_RING);
+    if (rings == MAP_FAILED) CHECK_ERR(-1, "mmap");
+    l->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   l->ringFD, IORING_OFF_SQES);
+    if (l->sqes == MAP_FAILED) CHECK_ERR(-1, "mmap");
+
+    l->sqHead = (unsigned *)(rings + p.sq_off.head);
+    l->sqTail = (unsigned *)(rings + p.sq_off.tail);
+    l->sqMask = (unsigned *)(rings + p.sq_off.ring_mask);
+    l->sqLocalTail = *l->sqTail;
+    l->cqHead = (unsigned *)(rings + p.cq_off.head);
+    l->cqTail = (unsigned *)(rings + p.cq_off.tail);
+    l->cqMask = (unsigned *)(rings + p.cq_off.ring_mask);
+    l->cqes = (struct io_uring_cqe *)(rings + p.cq_off.cqes);
+
+    // Chaque case de la file désigne l'entrée de même rang, une fois pour
+    // toutes
+    unsigned *array = (unsigned *)(rings + p.sq_off.array);
+    for (unsigned i = 0; i < p.sq_entries; i++) array[i] = i;
+
+    // Tampons de réception : le noyau en choisit un libre pour chaque
+    // réception, le serveur le lui rend une fois les octets copiés
+    l->bufRing = mmap(NULL, URING_NB_BUFS * sizeof(struct io_uring_buf),
+                      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+                      0);
+    if (l->bufRing == MAP_FAILED) CHECK_ERR(-1, "mmap");
+    l->bufs = malloc((size_t)URING_NB_BUFS * URING_BUF_SIZE);
+    if (!l->bufs) CHECK_ERR(-1, "malloc");
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)l->bufRing;
+    reg.ring_entries = URING_NB_BUFS;
+    reg.bgid = URING_BUF_GROUP;
+    if (syscall(__NR_io_uring_register, l->ringFD, IORING_REGISTER_PBUF_RING,
+                &reg, 1) < 0) {
+        close(l->ringFD);
+        return -1;
+    }
+    for (unsigned short i = 0; i < URING_NB_BUFS; i++) buf_recycle(l, i);
+
+    return 0;
+}
+
+/*================== Opérations ==================*/
+static void arm_accept(struct uring_loop *l) {
+    struct io_uring_sqe *sqe = sq_get(l);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = l->listenFD;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = TAG_ACCEPT;
+}
+
+/* Relance l'acceptation après ACCEPT_PAUSE µs, à la fin de cette attente */
+static void arm_accept_pause(struct uring_loop *l) {
+    static struct __kernel_timespec pause = {0, ACCEPT_PAUSE * 1000};
+    struct io_uring_sqe *sqe = sq_get(l);
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)&pause;
+    sqe->len = 1;
+    sqe->user_data = TAG_ACCEPT_PAUSE;
+}
+
+static void arm_recv(struct uring_loop *l, struct user *u) {
+    struct io_uring_sqe *sqe = sq_get(l);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = u->sock;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->user_data = (uint64_t)(uintptr_t)u | TAG_RECV;
+    u->ioOps++;
+}
+
+/* Libère u s'il est fermé et que plus aucune opération ne le désigne */
+static void release(struct user *u) {
+    if (u->state == USER_CLOSING && u->ioOps == 0) userset_retire(u);
+}
+
+/*================== Boucle principale ==================*/
+int uring_run(int listenFD) {
+    struct uring_loop *l = &loop;
+    if (uring_setup(l, listenFD) < 0) return -1;
+
+    arm_accept(l);
+
+    while (1) {
+        // Soumission du tour et attente en un seul appel, sans dépasser la
+        // fenêtre du lot ni la prochaine échéance d'accueil
+        long timeoutUs =
+            handshake_timeout(&l->pending, batch_timeout(&l->batch));
+        struct __kernel_timespec ts = {timeoutUs / 1000000,
+                                       timeoutUs % 1000000 * 1000};
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        if (timeoutUs >= 0) arg.ts = (uint64_t)(uintptr_t)&ts;
+
+        int enterRes =
+            ring_enter(l->ringFD, sq_publish(l), 1,
+                       IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+                       sizeof(arg));
+        stats_add(STAT_WAIT_CALLS, 1);
+        if (enterRes < 0 && errno != ETIME && errno != EINTR)
+            CHECK_ERR(enterRes, "io_uring_enter");
+
+        // Toutes les complétions disponibles, rendues d'un coup
+        unsigned head = *l->cqHead;
+        unsigned tail = __atomic_load_n(l->cqTail, __ATOMIC_ACQUIRE);
+        int nbEvents = tail - head;
+
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &l->cqes[head & *l->cqMask];
+            uint64_t data = cqe->user_data;
+            void *ptr = (void *)(uintptr_t)(data & ~(uint64_t)TAG_MASK);
+
+            switch (data & TAG_MASK) {
+                case TAG_ACCEPT:
+                    uring_accept(l, cqe->res, cqe->flags);
+                    break;
+                case TAG_ACCEPT_PAUSE:
+                    arm_accept(l);
+                    break;
+                case TAG_RECV:
+                    uring_recv(l, ptr, cqe->res, cqe->flags);
+                    break;
+                case TAG_SEND: {
+                    struct uring_send *s = ptr;
+                    struct user *u = s->u;
+                    s->next = l->freeSends;
+                    l->freeSends = s;
+
+                    // Un envoi incomplet est un échec, qui annule la suite de
+                    // la chaîne et ferme la connexion : sa réception le verra
+                    u->ioOps--;
+                    outq_sent(&u->outq, cqe->res > 0 ? cqe->res : 0);
+                    if ((size_t)cqe->res != s->bytes) user_shutdown(u);
+                    if (u->state == USER_CLOSING)
+                        release(u);
+                    else if (!u->outq.inflight)
+                        uring_send(l, u);
+                    break;
+                }
+            }
+        }
+        __atomic_store_n(l->cqHead, head, __ATOMIC_RELEASE);
+
+        // Clients restés sans pseudo au-delà du délai
+        struct user *u;
+        while ((u = handshake_expired(&l->pending)) != NULL)
+            uring_close(l, u);
+
+        if (batch_due(&l->batch, nbEvents == 0)) uring_flush(l);
+    }
+
+    return 0;
+}
+
+/*================== Nouvelles connexions ==================*/
+void uring_accept(struct uring_loop *l, int res, unsigned flags) {
+    // Acceptation multishot arrêtée par le noyau : on la relance, après une
+    // pause si les descripteurs manquent, sans quoi la connexion en attente
+    // la ferait échouer aussitôt
+    if (!(flags & IORING_CQE_F_MORE) && res < 0 && user_accept_starved(-res))
+        arm_accept_pause(l);
+    else if (!(flags & IORING_CQE_F_MORE))
+        arm_accept(l);
+
+    if (res < 0) {
+        fprintf(stderr, "accept: %s\n", strerror(-res));
+        return;
+    }
+
+    struct user *u = user_create(res);
+    handshake_start(&l->pending, u);
+    arm_recv(l, u);
+}
+
+/*================== Lecture d'un client ==================*/
+void uring_recv(struct uring_loop *l, struct user *u, int res,
+                unsigned flags) {
+    // Octets copiés dans le tampon de u, le tampon partagé est rendu aussitôt
+    if (flags & IORING_CQE_F_BUFFER) {
+        unsigned short bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        if (res > 0 && u->state != USER_CLOSING)
+            uring_input(l, u, l->bufs + (size_t)bid * URING_BUF_SIZE, res);
+        buf_recycle(l, bid);
+    }
+
+    // La réception continue
+    if (flags & IORING_CQE_F_MORE) return;
+    u->ioOps--;
+
+    // Fermé pendant la lecture ou par un envoi : dernière complétion
+    if (u->state == USER_CLOSING) {
+        uring_close(l, u);
+        return;
+    }
+
+    // Réception arrêtée sans fin de connexion (plus de tampon libre, ...)
+    if (res > 0 || res == -ENOBUFS) {
+        arm_recv(l, u);
+        return;
+    }
+
+    if (res == 0)
+        printf("[DECONNEXION] Connexion fermée par le client %s\n",
+               u->username);
+    else
+        fprintf(stderr, "recv: %s\n", strerror(-res));
+    if (u->state == USER_NICKNAME) handshake_remove(&l->pending, u);
+    uring_close(l, u);
+}
+
+void uring_input(struct uring_loop *l, struct user *u, const char *data,
+                 size_t len) {
+    while (len > 0) {
+        // Tampon plein sans commande complète : pseudo trop long
+        ssize_t appended = buff_append(u->in, data, len);
+        if (appended < 0) {
+            fprintf(stderr, "[SERVER ERROR] - commande trop longue\n");
+            if (u->state == USER_NICKNAME) handshake_remove(&l->pending, u);
+            uring_close(l, u);
+            return;
+        }
+        data += appended;
+        len -= appended;
+
+        // Accueil : les commandes reçues avec le pseudo sont traitées ensuite
+        if (u->state == USER_NICKNAME) {
+            int hsRes = handshake_process(&l->pending, u);
+            if (hsRes < 0) uring_close(l, u);
+            if (hsRes < 0) return;
+            if (hsRes == 0) continue;
+
+            // L'historique des salons rejoints à la connexion passe avant
+            // le direct
+            for (size_t i = 0; i < u->nbRooms; i++) {
+                struct message_info replay;
+                login_replay(u, i, &replay);
+                replay_room(u, replay.room, replay.payload, replay.seq,
+                            &l->batch);
+                payload_unref(replay.payload);
+            }
+            login_mailbox(u, &l->batch);
+        }
+
+        char *line;
+        int nextRes;
+        while ((nextRes = proto_next(u, &line)) > 0)
+            if (uring_line(l, u, line) < 0) return;
+
+        // Trame invalide : impossible de retrouver le début de la suivante
+        if (nextRes < 0) {
+            fprintf(stderr, "[SERVER ERROR] - trame invalide de %s\n",
+                    u->username);
+            uring_close(l, u);
+            return;
+        }
+    }
+}
+
+int uring_line(struct uring_loop *l, struct user *u, char *line) {
+    // Vérifier si c'est une commande de déconnexion
+    if (is_exit_command(line)) {
+        printf("[DECONNEXION] %s a quitté le chat\n", u->username);
+        uring_close(l, u);
+        return -1;
+    }
+
+    // Diffusion directe depuis la boucle, comme un réacteur seul
+    struct message_info msg;
+    build_message(u, line, &msg);
+    batch_begin(&l->batch);
+    if (msg.type == MSG_NOTICE) {
+        if (repeat_message(u, msg.payload) == 0) batch_add(&l->batch, u);
+    } else if (msg.type == MSG_REPLAY) {
+        replay_room(u, msg.room, msg.payload, 0, &l->batch);
+    } else if (msg.type == MSG_PRIVATE) {
+        send_private(&msg, -1, &l->batch);
+    } else {
+        msg.seq = room_publish(msg.room, msg.payload, NULL, NULL);
+        send_messageAll(userset_read_begin(&msg.room->members), msg.payload,
+                        msg.seq, msg.sender_socket, &l->batch);
+        userset_read_end();
+    }
+    payload_unref(msg.payload);
+    return 0;
+}
+
+/*================== Écriture vers un client ==================*/
+void uring_send(struct uring_loop *l, struct user *u) {
+    if (u->state == USER_CLOSING || u->outq.inflight ||
+        outq_is_empty(&u->outq))
+        return;
+
+    // Une file plus longue qu'un sendmsg part en une chaîne de sendmsg liés,
+    // exécutés dans l'ordre ; chacun envoie tout ce qu'il décrit ou échoue
+    size_t nbSends = (u->outq.count + URING_SEND_IOV - 1) / URING_SEND_IOV;
+    if (nbSends > URING_SEND_CHAIN) nbSends = URING_SEND_CHAIN;
+
+    // Toute la chaîne est prête avant d'être déposée, dans une seule
+    // soumission
+    struct uring_send *chain[URING_SEND_CHAIN];
+    size_t n = 0;
+    while (n < nbSends) {
+        struct uring_send *s = l->freeSends;
+        if (s)
+            l->freeSends = s->next;
+        else if (!(s = malloc(sizeof(*s))))
+            break;
+        chain[n++] = s;
+    }
+    if (n == 0) {
+        perror("malloc");
+        return;
+    }
+    sq_reserve(l, n);
+
+    for (size_t i = 0; i < n; i++) {
+        struct uring_send *s = chain[i];
+
+        // Les messages décrits restent en file jusqu'à la complétion
+        size_t before = u->outq.inflightBytes;
+        memset(&s->msg, 0, sizeof(s->msg));
+        s->msg.msg_iov = s->iov;
+        s->msg.msg_iovlen = outq_prepare(&u->outq, s->iov, URING_SEND_IOV);
+        s->bytes = u->outq.inflightBytes - before;
+        s->u = u;
+
+        struct io_uring_sqe *sqe = sq_get(l);
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = u->sock;
+        sqe->addr = (uint64_t)(uintptr_t)&s->msg;
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        if (i + 1 < n) sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = (uint64_t)(uintptr_t)s | TAG_SEND;
+        u->ioOps++;
+    }
+}
+
+void uring_flush(struct uring_loop *l) {
+    // Un sendmsg par destinataire, tous soumis avec l'attente suivante
+    for (size_t i = 0; i < l->batch.count; i++) {
+        struct user *u = l->batch.users[i];
+        u->inBatch = 0;
+        uring_send(l, u);
+    }
+
+    if (l->batch.count) stats_add(STAT_BATCHES, 1);
+    l->batch.count = 0;
+    l->batch.start = 0;
+}
+
+/*================== Déconnexion ==================*/
+void uring_close(struct uring_loop *l, struct user *u) {
+    batch_remove(&l->batch, u);
+
+    // Sans effet pour un client sans pseudo ou déjà retiré
+    session_save(u);
+    room_part_all(u);
+    registry_release(u);
+    userset_remove(&connectUsers, u);
+
+    // La réception et l'envoi en cours se terminent avec la connexion
+    user_shutdown(u);
+    release(u);
+}
+
+#else
+
+int uring_run(int listenFD) {
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
@@ -1,33 +1,78 @@
 #include "../include/user.h"
 
-struct user *user_accept(int sl) {
-    struct user *u = malloc(sizeof(struct user));
-    if (!u) {
-        perror("malloc");
+#include <errno.h>
+#include <pthread.h>
+
+#include "slab/slab.h"
+
+/* Réserve des utilisateurs, créée au premier accueil : les connexions
+ * successives réutilisent les mêmes emplacements, alignés sur une ligne de
+ * cache */
+static Slab *users;
+static pthread_once_t usersOnce = PTHREAD_ONCE_INIT;
+
+static void create_users(void) {
+    users = slab_create("user", sizeof(struct user));
+    if (!users) {
+        perror("slab_create");
         exit(EXIT_FAILURE);
     }
+}
 
-    u->address = malloc(sizeof(struct sockaddr));
-    if (!u->address) {
-        perror("malloc");
-        free(u);
-        exit(EXIT_FAILURE);
+struct user *user_accept(int sl) {
+    struct sockaddr_storage address;
+    socklen_t addrLen = sizeof(address);
+    int sock = accept(sl, (struct sockaddr *)&address, &addrLen);
+    if (sock < 0) {
+        // Une socket d'écoute non bloquante n'a simplement plus rien à offrir.
+        // errno reste celle de accept pour l'appelant
+        int err = errno;
+        if (err != EAGAIN && err != EWOULDBLOCK) perror("accept");
+        errno = err;
+        return NULL;
     }
 
-    u->addr_len = sizeof(struct sockaddr);
-    u->sock = accept(sl, u->address, &u->addr_len);
-    if (u->sock < 0) {
-        perror("accept");
-        free(u->address);
-        free(u);
+    struct user *u = user_create(sock);
+    memcpy(&u->address, &address, addrLen);
+    u->addr_len = addrLen;
+    return u;
+}
+
+int user_accept_starved(int err) {
+    return err == EMFILE || err == ENFILE || err == ENOBUFS || err == ENOMEM;
+}
+
+struct user *user_create(int sock) {
+    pthread_once(&usersOnce, create_users);
+    struct user *u = slab_alloc(users);
+    if (!u) {
+        perror("malloc");
         exit(EXIT_FAILURE);
     }
 
-    u->username = malloc(32 * sizeof(char));
-    if (!u->username) {
+    u->addr_len = 0;
+    u->sock = sock;
+    u->state = USER_NICKNAME;
+    u->proto = PROTO_V1;
+    u->events = 0;
+    u->inBatch = 0;
+    u->registered = 0;
+    u->mailOpen = 0;
+    u->owner = 0;
+    u->ioOps = 0;
+    u->hsPrev = u->hsNext = NULL;
+    u->deadline = 0;
+    u->room = NULL;
+    u->rooms = NULL;
+    u->nbRooms = 0;
+    outq_init(&u->outq);
+    u->username[0] = '\0';
+    u->token[0] = '\0';
+    u->resumeSeq = 0;
+
+    u->in = buff_create(u->sock, HANDSHAKE_BUFFER_SIZE);
+    if (!u->in) {
         perror("malloc");
-        free(u->address);
-        free(u);
         exit(EXIT_FAILURE);
     }
 
@@ -36,9 +81,24 @@ struct user *user_accept(int sl) {
 
 void user_free(struct user *user) {
     if (user) {
-        if (user->address) free(user->address);
-        if (user->username) free(user->username);
+        free(user->rooms);
+        buff_free(user->in);
         if (user->sock >= 0) close(user->sock);
-        free(user);
+        outq_clear(&user->outq);
+        slab_release(users, user);
     }
 }
+
+void user_shutdown(struct user *user) {
+    if (user->state == USER_CLOSING) return;
+
+    // Le lecteur de la socket verra la fin de connexion et fera le ménage
+    // Des messages confiés au noyau (mode uring) restent jusqu'à la fin de
+    // leur envoi
+    user->state = USER_CLOSING;
+    if (user->outq.inflight)
+        outq_drop_pending(&user->outq);
+    else
+        outq_clear(&user->outq);
+    shutdown(user->sock, SHUT_RDWR);
+}
@@ -0,0 +1,230 @@
+#include "../include/userset.h"
+
+#include "epoch/epoch.h"
+
+static Epoch *domain;
+
+void userset_setup(void) {
+    domain = epoch_create();
+    if (!domain) {
+        perror("userset_setup");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*================== Index des lignes ==================*/
+/* Les utilisateurs sont alignés sur une ligne de cache et souvent voisins :
+ * on les disperse par multiplication */
+static size_t hash_user(const struct user *u) {
+    return (uint32_t)((uintptr_t)u / USER_CACHE_LINE) * 2654435761u;
+}
+
+/* Case de u dans l'index, ou la case vide où il irait */
+static struct userset_slot *index_find(const struct userset *s,
+                                       const struct user *u) {
+    size_t i = hash_user(u) & s->indexMask;
+    while (s->index[i].user && s->index[i].user != u)
+        i = (i + 1) & s->indexMask;
+    return &s->index[i];
+}
+
+/* Index vide de size cases, où sont replacés les membres de cur */
+static int index_build(struct userset *s, const struct user_set *cur,
+                       size_t size) {
+    struct userset_slot *index = calloc(size, sizeof(*index));
+    if (!index) return -1;
+
+    free(s->index);
+    s->index = index;
+    s->indexMask = size - 1;
+    for (size_t row = 0; row < cur->count; row++)
+        *index_find(s, cur->users[row]) =
+            (struct userset_slot){cur->users[row], row};
+    return 0;
+}
+
+/* Retire la case slot en recollant la suite de la chaîne de sondage */
+static void index_remove(struct userset *s, struct userset_slot *slot) {
+    size_t hole = slot - s->index;
+    for (size_t j = (hole + 1) & s->indexMask; s->index[j].user;
+         j = (j + 1) & s->indexMask) {
+        // Une case ne peut reculer dans le trou que si sa place idéale
+        // n'est pas entre le trou et elle
+        size_t ideal = hash_user(s->index[j].user) & s->indexMask;
+        if (((j - ideal) & s->indexMask) >= ((j - hole) & s->indexMask)) {
+            s->index[hole] = s->index[j];
+            hole = j;
+        }
+    }
+    s->index[hole].user = NULL;
+}
+
+/*================== Table ==================*/
+/* Table vide de size lignes, en un seul bloc */
+static struct user_set *set_alloc(size_t size) {
+    struct user_set *set =
+        malloc(sizeof(*set) + size * (sizeof(struct user *) +
+                                      sizeof(uint64_t) + 3 * sizeof(int)));
+    if (!set) return NULL;
+
+    set->count = 0;
+    set->size = size;
+    // Colonnes rangées de la plus alignée à la moins alignée
+    set->users = (struct user **)(set + 1);
+    set->from = (uint64_t *)(set->users + size);
+    set->gens = (unsigned *)(set->from + size);
+    set->socks = (int *)(set->gens + size);
+    set->owners = set->socks + size;
+    memset(set->gens, 0, size * sizeof(*set->gens));
+    return set;
+}
+
+/* Nouvelle table de size lignes avec les membres de cur, dans le même ordre
+ * et aux mêmes lignes. size doit être au moins cur->count */
+static struct user_set *set_copy(const struct user_set *cur, size_t size) {
+    struct user_set *next = set_alloc(size);
+    if (!next) return NULL;
+
+    size_t count = cur->count;
+    memcpy(next->users, cur->users, count * sizeof(*cur->users));
+    memcpy(next->from, cur->from, count * sizeof(*cur->from));
+    memcpy(next->socks, cur->socks, count * sizeof(*cur->socks));
+    memcpy(next->owners, cur->owners, count * sizeof(*cur->owners));
+    next->count = count;
+    return next;
+}
+
+/* Réécrit la ligne row de set : un lecteur qui la lit pendant ce temps voit
+ * sa génération changer et l'ignore */
+static void row_write(struct user_set *set, size_t row, struct user *u,
+                      int sock, int owner, uint64_t from) {
+    unsigned gen = set->gens[row];
+    __atomic_store_n(&set->gens[row], gen + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    __atomic_store_n(&set->users[row], u, __ATOMIC_RELAXED);
+    __atomic_store_n(&set->socks[row], sock, __ATOMIC_RELAXED);
+    __atomic_store_n(&set->owners[row], owner, __ATOMIC_RELAXED);
+    __atomic_store_n(&set->from[row], from, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&set->gens[row], gen + 2, __ATOMIC_RELEASE);
+}
+
+void userset_init(struct userset *s) {
+    s->current = set_alloc(USERSET_MIN_SIZE);
+    s->index = NULL;
+    if (!s->current || index_build(s, s->current, 2 * USERSET_MIN_SIZE) < 0) {
+        perror("userset_init");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&s->mutexWriters, NULL);
+}
+
+const struct user_set *userset_read_begin(struct userset *s) {
+    epoch_enter(domain);
+    return __atomic_load_n(&s->current, __ATOMIC_ACQUIRE);
+}
+
+void userset_read_end(void) { epoch_exit(domain); }
+
+size_t userset_count(const struct user_set *set) {
+    return __atomic_load_n(&set->count, __ATOMIC_ACQUIRE);
+}
+
+/* Remplace la version courante par next et reconstruit l'index pour sa
+ * taille ; l'ancienne version attend les lecteurs
+ * retourne 0, ou -1 si l'allocation échoue (rien n'est changé) */
+static int publish(struct userset *s, struct user_set *next) {
+    if (index_build(s, next, 2 * next->size) < 0) {
+        free(next);
+        return -1;
+    }
+
+    struct user_set *old = s->current;
+    __atomic_store_n(&s->current, next, __ATOMIC_RELEASE);
+
+    epoch_retire(domain, old, free);
+    epoch_reclaim(domain);
+    return 0;
+}
+
+int userset_add(struct userset *s, struct user *u, uint64_t from) {
+    pthread_mutex_lock(&s->mutexWriters);
+
+    struct user_set *cur = s->current;
+    if (index_find(s, u)->user) {
+        pthread_mutex_unlock(&s->mutexWriters);
+        return 0;
+    }
+
+    // Table pleine : une version deux fois plus grande
+    if (cur->count == cur->size) {
+        struct user_set *next = set_copy(cur, 2 * cur->size);
+        if (!next || publish(s, next) < 0) {
+            pthread_mutex_unlock(&s->mutexWriters);
+            return -1;
+        }
+        cur = next;
+    }
+
+    // La ligne est remplie avant d'être rendue visible aux lecteurs
+    size_t row = cur->count;
+    row_write(cur, row, u, u->sock, u->owner, from);
+    *index_find(s, u) = (struct userset_slot){u, row};
+    __atomic_store_n(&cur->count, row + 1, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&s->mutexWriters);
+    return 0;
+}
+
+int userset_set_from(struct userset *s, struct user *u, uint64_t from) {
+    pthread_mutex_lock(&s->mutexWriters);
+
+    // Sous le verrou : un déplacement ne peut pas recopier l'ancienne valeur
+    struct user_set *cur = s->current;
+    struct userset_slot *slot = index_find(s, u);
+    int res = -1;
+    if (slot->user && cur->from[slot->row] == USERSET_PENDING) {
+        __atomic_store_n(&cur->from[slot->row], from, __ATOMIC_RELAXED);
+        res = 0;
+    }
+
+    pthread_mutex_unlock(&s->mutexWriters);
+    return res;
+}
+
+void userset_remove(struct userset *s, struct user *u) {
+    pthread_mutex_lock(&s->mutexWriters);
+
+    struct user_set *cur = s->current;
+    struct userset_slot *slot = index_find(s, u);
+    if (!slot->user) {
+        pthread_mutex_unlock(&s->mutexWriters);
+        return;
+    }
+
+    // Le dernier membre prend la ligne libérée, puis la table raccourcit :
+    // il reste visible à son ancienne ligne tant qu'un lecteur peut y être
+    size_t row = slot->row, last = cur->count - 1;
+    index_remove(s, slot);
+    if (row != last) {
+        struct user *moved = cur->users[last];
+        row_write(cur, row, moved, cur->socks[last], cur->owners[last],
+                  cur->from[last]);
+        index_find(s, moved)->row = row;
+    }
+    __atomic_store_n(&cur->count, last, __ATOMIC_RELEASE);
+
+    // Table presque vide : une version plus petite, avec de la place
+    if (last * 4 < cur->size && cur->size > USERSET_MIN_SIZE) {
+        struct user_set *next = set_copy(cur, cur->size / 2);
+        if (next) publish(s, next);
+    }
+
+    pthread_mutex_unlock(&s->mutexWriters);
+}
+
+void userset_retire(struct user *u) {
+    epoch_retire(domain, u, (void *)user_free);
+    epoch_reclaim(domain);
+}